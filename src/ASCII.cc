@@ -128,6 +128,17 @@ std::string ASCII::execute(Utils::CommandParser &parser) {
     }  else if (const auto res = parser.find("self-play", 0)) {
         lambda_syntax_not_understood(parser, 1);
         out << m_ascii_engine->selfplay();
+    } else if (const auto res = parser.find("selfplay-games", 0)) {
+        lambda_syntax_not_understood(parser, 3);
+        const auto cnt = parser.get_count();
+        if (cnt == 2) {
+            const auto games = parser.get_command(1)->get<int>();
+            out << m_ascii_engine->selfplay_games(games);
+        } else if (cnt >= 3) {
+            const auto games = parser.get_command(1)->get<int>();
+            const auto filename = parser.get_command(2)->str;
+            out << m_ascii_engine->selfplay_games(games, filename);
+        }
     } else if (const auto res = parser.find("position", 0)) {
         auto pos = parser.get_commands(1)->str;
         out << m_ascii_engine->position(pos);
@@ -147,13 +158,33 @@ std::string ASCII::execute(Utils::CommandParser &parser) {
             const auto filename = parser.get_command(1)->str;
             out << m_ascii_engine->load_pgn(filename);
         }
+    } else if (const auto res = parser.find("perft", 0)) {
+        lambda_syntax_not_understood(parser, 2);
+        const auto cnt = parser.get_count();
+        if (cnt >= 2) {
+            const auto depth = parser.get_command(1)->get<int>();
+            out << m_ascii_engine->perft(depth);
+        }
+    } else if (const auto res = parser.find("perft-bench", 0)) {
+        lambda_syntax_not_understood(parser, 2);
+        const auto cnt = parser.get_count();
+        const auto depth = cnt >= 2 ? parser.get_command(1)->get<int>() : 4;
+        out << m_ascii_engine->perft_bench(depth);
+    } else if (const auto res = parser.find("convert-weights", 0)) {
+        lambda_syntax_not_understood(parser, 3);
+        const auto cnt = parser.get_count();
+        if (cnt >= 3) {
+            const auto filename = parser.get_command(1)->str;
+            const auto outname = parser.get_command(2)->str;
+            out << m_ascii_engine->convert_weights(filename, outname) << std::endl;
+        }
     } else if (const auto res = parser.find("supervised", 0)) {
         lambda_syntax_not_understood(parser, 3);
         const auto cnt = parser.get_count();
         if (cnt >= 3) {
             const auto filename = parser.get_command(1)->str;
-            const auto outname = parser.get_command(1)->str;
-            out << m_ascii_engine->supervised(filename, outname);
+            const auto outname = parser.get_command(2)->str;
+            out << m_ascii_engine->supervised(filename, outname) << std::endl;
         }
     } else {
         auto commands = parser.get_commands();
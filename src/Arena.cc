@@ -0,0 +1,85 @@
+/*
+    This file is part of ElephantArt.
+    Copyright (C) 2021 Hung-Zhe Lin
+
+    ElephantArt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ElephantArt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Arena.h"
+
+#include <algorithm>
+#include <cassert>
+
+constexpr size_t Arena::SLAB_SIZE;
+constexpr size_t Arena::ALIGNMENT;
+
+void *Arena::allocate(size_t size) {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    assert(size <= SLAB_SIZE);
+
+    while (true) {
+        auto slab = m_current.load(std::memory_order_acquire);
+        if (slab) {
+            const auto offset = slab->used.fetch_add(size, std::memory_order_relaxed);
+            if (offset + size <= SLAB_SIZE) {
+                return slab->buffer.get() + offset;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Other thread may already have pushed a new slab.
+        if (m_current.load(std::memory_order_relaxed) == slab) {
+            auto new_slab = std::make_unique<Slab>();
+            new_slab->buffer = std::make_unique<char[]>(SLAB_SIZE);
+            m_current.store(new_slab.get(), std::memory_order_release);
+            m_slabs.emplace_back(std::move(new_slab));
+        }
+    }
+}
+
+void Arena::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_slabs.empty()) {
+        return;
+    }
+
+    // Keep the first slab, the next tree will need it immediately.
+    m_slabs.resize(1);
+    m_slabs[0]->used.store(0);
+    m_current.store(m_slabs[0].get());
+}
+
+size_t Arena::get_memory_used() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_slabs.size() * SLAB_SIZE;
+}
+
+size_t Arena::get_memory_allocated() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto allocated = size_t{0};
+    for (const auto &slab : m_slabs) {
+        allocated += std::min(slab->used.load(), SLAB_SIZE);
+    }
+    return allocated;
+}
+
+std::vector<std::pair<const char *, const char *>> Arena::get_slab_ranges() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto ranges = std::vector<std::pair<const char *, const char *>>{};
+    for (const auto &slab : m_slabs) {
+        ranges.emplace_back(slab->buffer.get(), slab->buffer.get() + SLAB_SIZE);
+    }
+    return ranges;
+}
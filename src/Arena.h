@@ -0,0 +1,96 @@
+/*
+    This file is part of ElephantArt.
+    Copyright (C) 2021 Hung-Zhe Lin
+
+    ElephantArt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ElephantArt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ARENA_H_INCLUDE
+#define ARENA_H_INCLUDE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/*
+ * A bump pointer allocator. Memory is carved out of large slabs and
+ * never given back one by one, the whole arena is dropped by reset().
+ * Objects placed in the arena must be trivially destructible, because
+ * no destructor is ever called on them.
+ *
+ * allocate() is thread-safe. The fast path is one atomic fetch_add,
+ * a mutex is only taken when the current slab is full.
+ */
+class Arena {
+public:
+    static constexpr size_t SLAB_SIZE = 4 * 1024 * 1024;
+    static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena& operator=(const Arena &) = delete;
+
+    void *allocate(size_t size);
+
+    // Release all slabs except the first one. It takes the lock, but
+    // every pointer returned by allocate() is invalid after it, so no
+    // one may use the arena while resetting it.
+    void reset();
+
+    // The total size of the slabs we are holding.
+    size_t get_memory_used() const;
+
+    // The number of bytes handed out by allocate().
+    size_t get_memory_allocated() const;
+
+    // The address range [begin, end) of each slab.
+    std::vector<std::pair<const char *, const char *>> get_slab_ranges() const;
+
+private:
+    struct Slab {
+        std::atomic<size_t> used{0};
+        std::unique_ptr<char[]> buffer;
+    };
+
+    mutable std::mutex m_mutex;
+    std::atomic<Slab *> m_current{nullptr};
+    std::vector<std::unique_ptr<Slab>> m_slabs;
+};
+
+// A view of the contiguous objects in the arena. It is what we use
+// instead of std::vector for the arrays we never resize.
+template<typename T>
+class ArenaArray {
+public:
+    ArenaArray() = default;
+    ArenaArray(T *data, size_t size) : m_data(data), m_size(size) {}
+
+    T *begin() const { return m_data; }
+    T *end() const { return m_data + m_size; }
+
+    T &operator[](size_t idx) const { return m_data[idx]; }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    T *m_data{nullptr};
+    size_t m_size{0};
+};
+
+#endif
@@ -29,6 +29,10 @@
 #include <cassert>
 #include <string>
 
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
 typedef Uint128_t BitBoard;
 
 static constexpr int BITBOARD_WIDTH = MARCRO_WIDTH;
@@ -37,95 +41,106 @@ static constexpr int BITBOARD_SHIFT = MARCRO_SHIFT;
 static constexpr int BITBOARD_NUM_VERTICES = BITBOARD_SHIFT * MARCRO_HEIGHT;
 static constexpr int BITBOARD_INTERSECTIONS = MARCRO_WIDTH * MARCRO_HEIGHT;
 
-const BitBoard FirstPosition(0ULL, 1ULL);
-
-const BitBoard onBoard(0x7fdff7fdf, 0xf7fdff7fdff7fdff);
-
-const BitBoard FileABB(0x4010040, 0x1004010040100401);
-const BitBoard FileBBB = FileABB << 1;
-const BitBoard FileCBB = FileABB << 2;
-const BitBoard FileDBB = FileABB << 3;
-const BitBoard FileEBB = FileABB << 4;
-const BitBoard FileFBB = FileABB << 5;
-const BitBoard FileGBB = FileABB << 6;
-const BitBoard FileHBB = FileABB << 7;
-const BitBoard FileIBB = FileABB << 8;
-const BitBoard FileJBB = FileABB << 9; // invalid
-
-const BitBoard Rank0BB(0x0, 0x1ff);
-const BitBoard Rank1BB = Rank0BB << (BITBOARD_SHIFT * 1);
-const BitBoard Rank2BB = Rank0BB << (BITBOARD_SHIFT * 2);
-const BitBoard Rank3BB = Rank0BB << (BITBOARD_SHIFT * 3);
-const BitBoard Rank4BB = Rank0BB << (BITBOARD_SHIFT * 4);
-const BitBoard Rank5BB = Rank0BB << (BITBOARD_SHIFT * 5);
-const BitBoard Rank6BB = Rank0BB << (BITBOARD_SHIFT * 6);
-const BitBoard Rank7BB = Rank0BB << (BITBOARD_SHIFT * 7);
-const BitBoard Rank8BB = Rank0BB << (BITBOARD_SHIFT * 8);
-const BitBoard Rank9BB = Rank0BB << (BITBOARD_SHIFT * 9);
-
-const BitBoard Square = onBoard | FileJBB;
-const BitBoard RedSide = Rank0BB | Rank1BB | Rank2BB | Rank3BB | Rank4BB;
-const BitBoard BlackSide = Rank5BB | Rank6BB | Rank7BB | Rank8BB | Rank9BB;
-const BitBoard KingArea = (Rank0BB | Rank1BB | Rank2BB | Rank7BB | Rank8BB | Rank9BB) & (FileDBB | FileEBB | FileFBB);
+constexpr BitBoard FirstPosition(0ULL, 1ULL);
+
+constexpr BitBoard onBoard(0x7fdff7fdf, 0xf7fdff7fdff7fdff);
+
+constexpr BitBoard FileABB(0x4010040, 0x1004010040100401);
+constexpr BitBoard FileBBB = FileABB << 1;
+constexpr BitBoard FileCBB = FileABB << 2;
+constexpr BitBoard FileDBB = FileABB << 3;
+constexpr BitBoard FileEBB = FileABB << 4;
+constexpr BitBoard FileFBB = FileABB << 5;
+constexpr BitBoard FileGBB = FileABB << 6;
+constexpr BitBoard FileHBB = FileABB << 7;
+constexpr BitBoard FileIBB = FileABB << 8;
+constexpr BitBoard FileJBB = FileABB << 9; // invalid
+
+constexpr BitBoard Rank0BB(0x0, 0x1ff);
+constexpr BitBoard Rank1BB = Rank0BB << (BITBOARD_SHIFT * 1);
+constexpr BitBoard Rank2BB = Rank0BB << (BITBOARD_SHIFT * 2);
+constexpr BitBoard Rank3BB = Rank0BB << (BITBOARD_SHIFT * 3);
+constexpr BitBoard Rank4BB = Rank0BB << (BITBOARD_SHIFT * 4);
+constexpr BitBoard Rank5BB = Rank0BB << (BITBOARD_SHIFT * 5);
+constexpr BitBoard Rank6BB = Rank0BB << (BITBOARD_SHIFT * 6);
+constexpr BitBoard Rank7BB = Rank0BB << (BITBOARD_SHIFT * 7);
+constexpr BitBoard Rank8BB = Rank0BB << (BITBOARD_SHIFT * 8);
+constexpr BitBoard Rank9BB = Rank0BB << (BITBOARD_SHIFT * 9);
+
+constexpr BitBoard Square = onBoard | FileJBB;
+constexpr BitBoard RedSide = Rank0BB | Rank1BB | Rank2BB | Rank3BB | Rank4BB;
+constexpr BitBoard BlackSide = Rank5BB | Rank6BB | Rank7BB | Rank8BB | Rank9BB;
+constexpr BitBoard KingArea = (Rank0BB | Rank1BB | Rank2BB | Rank7BB | Rank8BB | Rank9BB) & (FileDBB | FileEBB | FileFBB);
 
 namespace Utils {
 
-inline static bool on_board(const BitBoard bitboard) {
+inline static constexpr bool on_board(const BitBoard bitboard) {
     return onBoard & bitboard;
 }
 
-inline static bool on_board(const Types::Vertices v) {
+inline static constexpr bool on_board(const Types::Vertices v) {
     return onBoard & (FirstPosition << v);
 }
 
-inline static bool on_board(const int v) {
+inline static constexpr bool on_board(const int v) {
     return onBoard & (FirstPosition << v);
 }
 
-inline static bool on_area(const BitBoard bitboard, const BitBoard area_board) {
+inline static constexpr bool on_area(const BitBoard bitboard, const BitBoard area_board) {
     return area_board & bitboard;
 }
 
-inline static bool on_area(const Types::Vertices v, const BitBoard area_board) {
+inline static constexpr bool on_area(const Types::Vertices v, const BitBoard area_board) {
     return area_board & (FirstPosition << v);
 }
 
-inline static bool on_area(const int v, const BitBoard area_board) {
+inline static constexpr bool on_area(const int v, const BitBoard area_board) {
     return area_board & (FirstPosition << v);
 }
 
-inline static BitBoard shift(Types::Direction d, BitBoard bitboard) {
+inline static constexpr BitBoard shift(Types::Direction d, BitBoard bitboard) {
     if (d > 0) {
         return (bitboard << d) & onBoard;
     }
     return (bitboard >> (-d)) & onBoard;
 }
 
-inline static BitBoard file2bitboard(const Types::File f) {
+inline static constexpr BitBoard file2bitboard(const Types::File f) {
     return FileABB << f; 
 }
 
-inline static BitBoard rank2bitboard(const Types::Rank r) {
+inline static constexpr BitBoard rank2bitboard(const Types::Rank r) {
     return Rank0BB << (BITBOARD_SHIFT * r);
 }
 
-inline static BitBoard vertex2bitboard(const Types::Vertices v) {
+inline static constexpr BitBoard vertex2bitboard(const Types::Vertices v) {
     return FirstPosition << v;
 }
 
-inline static BitBoard vertex2bitboard(const int v) {
+inline static constexpr BitBoard vertex2bitboard(const int v) {
     return FirstPosition << v;
 }
 
-inline static BitBoard ls1b(BitBoard b) {
+inline static constexpr BitBoard ls1b(BitBoard b) {
     return b & -b;
 }
 
-inline static BitBoard reset_ls1b(BitBoard b) {
+inline static constexpr BitBoard reset_ls1b(BitBoard b) {
     return b & (b-1);
 }
 
 inline static Types::Vertices lsb(BitBoard b) {
+#if defined(__GNUC__) || defined(__clang__)
+    const auto lower = b.get_lower();
+    const auto upper = b.get_upper();
+    if (lower) {
+        return static_cast<Types::Vertices>(__builtin_ctzll(lower));
+    }
+    if (upper) {
+        return static_cast<Types::Vertices>(64 + __builtin_ctzll(upper));
+    }
+    return Types::NO_VERTEX;
+#else
     /*
      * bitScanForward
      * @author Martin Läuter (1997)
@@ -167,31 +182,34 @@ inline static Types::Vertices lsb(BitBoard b) {
     res += bitScanForward(bit);
 
     return static_cast<Types::Vertices>(res);
+#endif
 }
-   
-// Counts the number of set bits in the BitBoard.
-inline static int count(BitBoard b) {
 
-    std::uint64_t x_1 = b.get_upper();
-    std::uint64_t x_2 = b.get_lower();
-
-    const auto lambda_uint64_count = [](std::uint64_t x) -> int {
-        x -= (x >> 1) & 0x5555555555555555;
-        x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
-        x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0F;
-        return (x * 0x0101010101010101) >> 56;
-    };
+inline static int count64(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    x -= (x >> 1) & 0x5555555555555555;
+    x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0F;
+    return (x * 0x0101010101010101) >> 56;
+#endif
+}
 
-    return lambda_uint64_count(x_1) + lambda_uint64_count(x_2);
+// Counts the number of set bits in the BitBoard.
+inline static int count(BitBoard b) {
+    return count64(b.get_upper()) + count64(b.get_lower());
 }
 
 /*
  * Like count(BitBoard b) but using algorithm faster on a very sparse BitBoard.
- * May be slower for more than 4 set bits, but still correct.
- * Useful when counting bits in a Q, R, N or B BitBoard.
+ * May be slower for more than 4 set bits, but still correct. With the
+ * popcnt instruction, it is the same as count(BitBoard b).
  */
 inline static int count_few(BitBoard b) {
-
+#if defined(__GNUC__) || defined(__clang__)
+    return count(b);
+#else
     std::uint64_t x_1 = b.get_upper();
     std::uint64_t x_2 = b.get_lower();
     const auto lambda_uint64_count_few = [](std::uint64_t x) -> int {
@@ -203,6 +221,41 @@ inline static int count_few(BitBoard b) {
     };
 
     return lambda_uint64_count_few(x_1) + lambda_uint64_count_few(x_2);
+#endif
+}
+
+/*
+ * Gather the bits of b under the mask into the low bits of the result,
+ * in the order of the mask. The mask must have at most 64 bits. It is
+ * the pext instruction if BMI2 exists.
+ */
+inline static std::uint64_t pext(BitBoard b, BitBoard mask) {
+    const auto lower_mask = mask.get_lower();
+    const auto upper_mask = mask.get_upper();
+
+    // Shifting by 64 is undefined. With 64 lower bits the mask has no
+    // upper ones, so only the lower bits are left.
+    const auto lower_bits = count64(lower_mask);
+    const auto shift_upper = [lower_bits](std::uint64_t x) -> std::uint64_t {
+        return lower_bits >= 64 ? 0 : x << lower_bits;
+    };
+#ifdef __BMI2__
+    return _pext_u64(b.get_lower(), lower_mask) |
+               shift_upper(_pext_u64(b.get_upper(), upper_mask));
+#else
+    const auto lambda_pext64 = [](std::uint64_t x, std::uint64_t m) -> std::uint64_t {
+        auto res = std::uint64_t{0};
+        for (auto bit = std::uint64_t{1}; m; bit <<= 1) {
+            if (x & m & -m) {
+                res |= bit;
+            }
+            m &= m - 1;
+        }
+        return res;
+    };
+    return lambda_pext64(b.get_lower(), lower_mask) |
+               shift_upper(lambda_pext64(b.get_upper(), upper_mask));
+#endif
 }
 
 inline static bool exist(BitBoard b, Types::Vertices v) {
@@ -18,6 +18,12 @@
 
 #include "Blas.h"
 #include <cmath>
+#include <cstring>
+
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+#define USE_INT8_VNNI
+#include <immintrin.h>
+#endif
 
 #ifdef USE_EIGEN
 // Eigen helpers
@@ -276,11 +282,203 @@ void Blas::dense(const int input_size,
 #endif
 }
 
-void FullyConnect::Forward(const int input_size,
+constexpr int Int8::GEMM_ALIGNMENT;
+constexpr int Int8::DENSE_ALIGNMENT;
+constexpr int Int8::GEMM_COLUMNS;
+
+Int8Weights Int8::quantize_weights(const int outputs,
+                                   const int inputs,
+                                   const int alignment,
+                                   const FloatWeights &weights) {
+    assert(weights.size() == (size_t)outputs * inputs);
+
+    auto result = Int8Weights{};
+    result.outputs = outputs;
+    result.inputs = inputs;
+    result.padded_inputs = (inputs + alignment - 1) / alignment * alignment;
+    result.weights.assign(outputs * result.padded_inputs, 0);
+    result.scales.resize(outputs);
+    result.sums.resize(outputs);
+
+    for (int o = 0; o < outputs; ++o) {
+        const float *w = weights.data() + o * inputs;
+        auto max_abs = 0.0f;
+        for (int i = 0; i < inputs; ++i) {
+            max_abs = std::max(max_abs, std::abs(w[i]));
+        }
+
+        // The -128 is not used, so the range is symmetric.
+        const auto scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+        auto sum = std::int32_t{0};
+        for (int i = 0; i < inputs; ++i) {
+            const auto q = static_cast<std::int32_t>(std::round(w[i] / scale));
+            const auto clamped = std::min(127, std::max(-127, q));
+            result.weights[o * result.padded_inputs + i] = static_cast<std::int8_t>(clamped);
+            sum += clamped;
+        }
+        result.scales[o] = scale;
+        result.sums[o] = sum;
+    }
+    return result;
+}
+
+void Int8::get_input_range(const float *input, const size_t size,
+                           float &scale, std::int32_t &zero_point) {
+    // The range always includes the zero, so the zero is exact. It is
+    // important for the padding of the convolution.
+    auto lo = 0.0f;
+    auto hi = 0.0f;
+    for (auto i = size_t{0}; i < size; ++i) {
+        lo = std::min(lo, input[i]);
+        hi = std::max(hi, input[i]);
+    }
+
+    const auto range = hi - lo;
+    scale = range > 0.0f ? range / 255.0f : 1.0f;
+    zero_point = static_cast<std::int32_t>(std::round(-lo / scale));
+    zero_point = std::min(255, std::max(0, zero_point));
+}
+
+#ifdef USE_INT8_VNNI
+// Compute MR rows and NV * 16 columns. The B is [K/4][N][4], so the
+// 4 inputs of one column are in the same 32 bits lane.
+template <int MR, int NV>
+static void int8_gemm_tile(const int N, const int K,
+                           const std::int8_t *A,
+                           const std::uint8_t *B,
+                           std::int32_t *C) {
+    __m512i acc[MR][NV];
+    for (int i = 0; i < MR; ++i) {
+        for (int j = 0; j < NV; ++j) {
+            acc[i][j] = _mm512_setzero_si512();
+        }
+    }
+
+    for (int k = 0; k < K; k += 4) {
+        __m512i b[NV];
+        for (int j = 0; j < NV; ++j) {
+            b[j] = _mm512_loadu_si512(B + k * N + j * 64);
+        }
+        for (int i = 0; i < MR; ++i) {
+            auto w = std::int32_t{0};
+            std::memcpy(&w, A + i * K + k, sizeof(w));
+            const auto a = _mm512_set1_epi32(w);
+            for (int j = 0; j < NV; ++j) {
+                acc[i][j] = _mm512_dpbusd_epi32(acc[i][j], b[j], a);
+            }
+        }
+    }
+
+    for (int i = 0; i < MR; ++i) {
+        for (int j = 0; j < NV; ++j) {
+            _mm512_storeu_si512(C + i * N + j * 16, acc[i][j]);
+        }
+    }
+}
+
+template <int NV>
+static void int8_gemm_columns(const int M, const int N, const int K,
+                              const std::int8_t *A,
+                              const std::uint8_t *B,
+                              std::int32_t *C) {
+    constexpr int MR = 4;
+    auto m = 0;
+    for (; m + MR <= M; m += MR) {
+        int8_gemm_tile<MR, NV>(N, K, A + m * K, B, C + m * N);
+    }
+    for (; m < M; ++m) {
+        int8_gemm_tile<1, NV>(N, K, A + m * K, B, C + m * N);
+    }
+}
+#endif
+
+void Int8::gemm(const int M, const int N, const int K,
+                const std::int8_t *A,
+                const std::uint8_t *B,
+                std::int32_t *C) {
+    assert(N % GEMM_COLUMNS == 0);
+    assert(K % GEMM_ALIGNMENT == 0);
+
+#ifdef USE_INT8_VNNI
+    // The 64 columns block of the B is reused by all rows.
+    constexpr int NV = 4;
+    auto n = 0;
+    for (; n + NV * 16 <= N; n += NV * 16) {
+        int8_gemm_columns<NV>(M, N, K, A, B + n * 4, C + n);
+    }
+    for (; n < N; n += 16) {
+        int8_gemm_columns<1>(M, N, K, A, B + n * 4, C + n);
+    }
+#else
+    for (int m = 0; m < M; ++m) {
+        std::int32_t *c = C + m * N;
+        std::fill(c, c + N, 0);
+        for (int k = 0; k < K; k += 4) {
+            const std::int32_t w0 = A[m * K + k + 0];
+            const std::int32_t w1 = A[m * K + k + 1];
+            const std::int32_t w2 = A[m * K + k + 2];
+            const std::int32_t w3 = A[m * K + k + 3];
+            const std::uint8_t *b = B + k * N;
+            for (int n = 0; n < N; ++n) {
+                c[n] += b[4*n+0] * w0 + b[4*n+1] * w1 +
+                            b[4*n+2] * w2 + b[4*n+3] * w3;
+            }
+        }
+    }
+#endif
+}
+
+void Int8::dense(const int M, const int batch_size, const int K,
+                 const std::int8_t *A,
+                 const std::uint8_t *B,
+                 std::int32_t *C) {
+    assert(K % DENSE_ALIGNMENT == 0);
+
+    for (int b = 0; b < batch_size; ++b) {
+        const std::uint8_t *input = B + b * K;
+        for (int m = 0; m < M; ++m) {
+            const std::int8_t *w = A + m * K;
+#ifdef USE_INT8_VNNI
+            auto acc = _mm512_setzero_si512();
+            for (int k = 0; k < K; k += 64) {
+                acc = _mm512_dpbusd_epi32(acc,
+                                          _mm512_loadu_si512(input + k),
+                                          _mm512_loadu_si512(w + k));
+            }
+            // The _mm512_reduce_add_epi32() makes the false warning
+            // of GCC 12, we add the lanes by ourself.
+            alignas(64) std::int32_t lanes[16];
+            _mm512_store_si512(lanes, acc);
+            auto sum = std::int32_t{0};
+            for (int i = 0; i < 16; ++i) {
+                sum += lanes[i];
+            }
+            C[b * M + m] = sum;
+#else
+            auto acc = std::int32_t{0};
+            for (int k = 0; k < K; ++k) {
+                acc += std::int32_t{input[k]} * std::int32_t{w[k]};
+            }
+            C[b * M + m] = acc;
+#endif
+        }
+    }
+}
+
+const char *Int8::get_kernel_name() {
+#ifdef USE_INT8_VNNI
+    return "AVX512-VNNI";
+#else
+    return "built-in";
+#endif
+}
+
+void FullyConnect::Forward(const int batch_size,
+                           const int input_size,
                            const int output_size,
                            const std::vector<float> &input,
-                           const std::vector<float> &weights,
-                           const std::vector<float> &biases,
+                           const FloatWeights &weights,
+                           const FloatWeights &biases,
                            std::vector<float> &output,
                            const bool ReLU) {
 
@@ -288,21 +486,71 @@ void FullyConnect::Forward(const int input_size,
         return (val > 0.0f) ? val : 0.0f;
     };
 
-    static constexpr int batch = 1;
     Blas::dense(input_size,
                 output_size,
-                batch,
+                batch_size,
                 input.data(),
                 weights.data(),
                 output.data());
 
-    if (ReLU) {
-        for (auto o = int{0}; o < output_size; ++o) {
-            output[o] = lambda_ReLU(biases[o] + output[o]);
+    for (int b = 0; b < batch_size; ++b) {
+        float *output_ptr = output.data() + b * output_size;
+        if (ReLU) {
+            for (auto o = int{0}; o < output_size; ++o) {
+                output_ptr[o] = lambda_ReLU(biases[o] + output_ptr[o]);
+            }
+        } else {
+            for (auto o = int{0}; o < output_size; ++o) {
+                output_ptr[o] = biases[o] + output_ptr[o];
+            }
         }
-    } else {
+    }
+}
+
+void FullyConnect::Forward(const int batch_size,
+                           const int input_size,
+                           const int output_size,
+                           const std::vector<float> &input,
+                           const Int8Weights &weights,
+                           const FloatWeights &biases,
+                           std::vector<float> &output,
+                           const bool ReLU) {
+
+    const auto lambda_ReLU = [](const auto val) -> float {
+        return (val > 0.0f) ? val : 0.0f;
+    };
+
+    assert(weights.inputs == input_size);
+    assert(weights.outputs == output_size);
+
+    const auto padded_size = weights.padded_inputs;
+    auto quantized = std::vector<std::uint8_t>(batch_size * padded_size, 0);
+    auto acc = std::vector<std::int32_t>(batch_size * output_size);
+    auto scales = std::vector<float>(batch_size);
+    auto zero_points = std::vector<std::int32_t>(batch_size);
+
+    for (int b = 0; b < batch_size; ++b) {
+        const float *input_ptr = input.data() + b * input_size;
+        Int8::get_input_range(input_ptr, input_size, scales[b], zero_points[b]);
+
+        const auto inv_scale = 1.0f / scales[b];
+        for (auto i = int{0}; i < input_size; ++i) {
+            quantized[b * padded_size + i] = Int8::quantize_input(input_ptr[i], inv_scale, zero_points[b]);
+        }
+    }
+
+    Int8::dense(output_size, batch_size, padded_size,
+                weights.weights.data(),
+                quantized.data(),
+                acc.data());
+
+    for (int b = 0; b < batch_size; ++b) {
+        float *output_ptr = output.data() + b * output_size;
+        const std::int32_t *acc_ptr = acc.data() + b * output_size;
         for (auto o = int{0}; o < output_size; ++o) {
-            output[o] = biases[o] + output[o];
+            const auto val = scales[b] * weights.scales[o] *
+                                 static_cast<float>(acc_ptr[o] - zero_points[b] * weights.sums[o]);
+            output_ptr[o] = ReLU ? lambda_ReLU(biases[o] + val) : biases[o] + val;
         }
     }
 }
@@ -310,8 +558,8 @@ void FullyConnect::Forward(const int input_size,
 std::vector<float> FullyConnect::innerproduct(const int input_size,
                                               const int output_size,
                                               const std::vector<float> &input,
-                                              const std::vector<float> &weights,
-                                              const std::vector<float> &biases,
+                                              const FloatWeights &weights,
+                                              const FloatWeights &biases,
                                               const bool ReLU) {
 
     auto output = std::vector<float>(output_size);
@@ -341,44 +589,62 @@ std::vector<float> FullyConnect::innerproduct(const int input_size,
 }
 
 
-void Convolve1::Forward(const size_t input_channels,
+void Convolve1::Forward(const int batch_size,
+                        const size_t input_channels,
                         const size_t output_channels,
                         const std::vector<float> &input,
-                        const std::vector<float> &weights,
-                        std::vector<float> &output) {
+                        const FloatWeights &weights,
+                        const FloatWeights &biases,
+                        std::vector<float> &output,
+                        const float *const eltwise,
+                        const bool ReLU) {
 
-     Blas::fixed_gemm((int)output_channels,
-                      spatial_size,
-                      (int)input_channels,
-                      1.0f,
-                      weights.data(),
-                      (int)input_channels,
-                      input.data(),
-                      spatial_size,
-                      0.0f,
-                      output.data(),
-                      spatial_size);
+    for (int b = 0; b < batch_size; ++b) {
+        float *output_ptr = output.data() + b * output_channels * spatial_size;
+        Blas::fixed_gemm((int)output_channels,
+                         spatial_size,
+                         (int)input_channels,
+                         1.0f,
+                         weights.data(),
+                         (int)input_channels,
+                         input.data() + b * input_channels * spatial_size,
+                         spatial_size,
+                         0.0f,
+                         output_ptr,
+                         spatial_size);
+
+        for (auto o = size_t{0}; o < output_channels; ++o) {
+            const auto offset = (b * output_channels + o) * spatial_size;
+            ConvEpilogue::Forward(output.data() + offset, output.data() + offset,
+                                  spatial_size, biases[o],
+                                  eltwise ? eltwise + offset : nullptr, ReLU);
+        }
+    }
 }
 
 
-void AddSpatialBias::Forward(const size_t channels,
+void AddSpatialBias::Forward(const int batch_size,
+                             const size_t channels,
                              std::vector<float> &input,
-                             const std::vector<float> &biases) {
+                             const FloatWeights &biases) {
     
     float *input_ptr = input.data();
-    for (auto c = size_t{0}; c < channels; ++c) {
-        for (auto b = size_t{0}; b < spatial_size; b++) {
-            *input_ptr += biases[c];
-            input_ptr++;
+    for (int n = 0; n < batch_size; ++n) {
+        for (auto c = size_t{0}; c < channels; ++c) {
+            for (auto b = size_t{0}; b < spatial_size; b++) {
+                *input_ptr += biases[c];
+                input_ptr++;
+            }
         }
     }
 }
 
 
-void Batchnorm::Forward(const size_t channels,
+void Batchnorm::Forward(const int batch_size,
+                        const size_t channels,
                         std::vector<float> &input,
-                        const std::vector<float> &means,
-                        const std::vector<float> &stddevs,
+                        const FloatWeights &means,
+                        const FloatWeights &stddevs,
                         const float *const eltwise,
                         const bool ReLU) {
 
@@ -389,72 +655,109 @@ void Batchnorm::Forward(const size_t channels,
     float *input_ptr = input.data();
     if (eltwise) {
         const float *res = eltwise;
-        for (auto c = size_t{0}; c < channels; ++c) {
-            const auto mean = means[c];
-            const auto scale_stddev = stddevs[c];
-
-            for (auto b = size_t{0}; b < spatial_size; b++) {
-                float value = *input_ptr;
-                value = scale_stddev * (value - mean) + *res;
-                *input_ptr = lambda_ReLU(value);
-
-                input_ptr++;
-                res++;
+        for (int n = 0; n < batch_size; ++n) {
+            for (auto c = size_t{0}; c < channels; ++c) {
+                const auto mean = means[c];
+                const auto scale_stddev = stddevs[c];
+
+                for (auto b = size_t{0}; b < spatial_size; b++) {
+                    float value = *input_ptr;
+                    value = scale_stddev * (value - mean) + *res;
+                    *input_ptr = lambda_ReLU(value);
+
+                    input_ptr++;
+                    res++;
+                }
             }
         }
     } else {
-        for (auto c = size_t{0}; c < channels; ++c) {
-            const auto mean = means[c];
-            const auto scale_stddev = stddevs[c];
-
-            for (auto b = size_t{0}; b < spatial_size; b++) {
-                float value = *input_ptr;
-                value = scale_stddev * (value - mean);
-                *input_ptr = lambda_ReLU(value);
-                input_ptr++;
+        for (int n = 0; n < batch_size; ++n) {
+            for (auto c = size_t{0}; c < channels; ++c) {
+                const auto mean = means[c];
+                const auto scale_stddev = stddevs[c];
+
+                for (auto b = size_t{0}; b < spatial_size; b++) {
+                    float value = *input_ptr;
+                    value = scale_stddev * (value - mean);
+                    *input_ptr = lambda_ReLU(value);
+                    input_ptr++;
+                }
             }
         }
     }
 }
 
-void GlobalAvgPool::Forward(const size_t channels,
+void GlobalAvgPool::Forward(const int batch_size,
+                            const size_t channels,
                             const std::vector<float> &input,
                             std::vector<float> &output) {
 
     const float *input_ptr = input.data();
 
-    for (auto c = size_t{0}; c < channels; ++c) {
-        float Sum = 0.0f;
-        for (auto b = size_t{0}; b < spatial_size; ++b) {
-            Sum += *input_ptr;
-            input_ptr++;
-        }
+    for (int n = 0; n < batch_size; ++n) {
+        for (auto c = size_t{0}; c < channels; ++c) {
+            float Sum = 0.0f;
+            for (auto b = size_t{0}; b < spatial_size; ++b) {
+                Sum += *input_ptr;
+                input_ptr++;
+            }
 
-        const float Mean = Sum / (float)spatial_size;
-        output[c] = Mean;
+            const float Mean = Sum / (float)spatial_size;
+            output[n * channels + c] = Mean;
+        }
     }
 }
 
-void SEUnit::Forward(const size_t channels,
+void SEUnit::Forward(const int batch_size,
+                     const size_t channels,
                      const size_t se_size,
                      std::vector<float> &input,
                      const std::vector<float> &residual,
-                     const std::vector<float> &weights_w1,
-                     const std::vector<float> &weights_b1,
-                     const std::vector<float> &weights_w2,
-                     const std::vector<float> &weights_b2) {
-
-    auto pool = std::vector<float>(2 * channels);
-    auto fc_out = std::vector<float>(se_size);
-
-    GlobalAvgPool::Forward(channels, input, pool);
-    FullyConnect::Forward(channels, se_size, pool, weights_w1, weights_b1, fc_out, true);
-    FullyConnect::Forward(se_size, 2*channels, fc_out, weights_w2, weights_b2, pool, false);
+                     const FloatWeights &weights_w1,
+                     const FloatWeights &weights_b1,
+                     const FloatWeights &weights_w2,
+                     const FloatWeights &weights_b2,
+                     std::vector<float> &pool,
+                     std::vector<float> &fc_out,
+                     std::vector<float> &scale) {
+
+    assert(batch_size * channels <= pool.size());
+    assert(batch_size * se_size <= fc_out.size());
+    assert(batch_size * 2 * channels <= scale.size());
+
+    GlobalAvgPool::Forward(batch_size, channels, input, pool);
+    FullyConnect::Forward(batch_size, channels, se_size, pool, weights_w1, weights_b1, fc_out, true);
+    FullyConnect::Forward(batch_size, se_size, 2*channels, fc_out, weights_w2, weights_b2, scale, false);
+
+    SEProcess(batch_size, channels, input, residual, scale);
+}
 
-    SEProcess(channels, input, residual, pool);
+void SEUnit::Forward(const int batch_size,
+                     const size_t channels,
+                     const size_t se_size,
+                     std::vector<float> &input,
+                     const std::vector<float> &residual,
+                     const Int8Weights &weights_w1,
+                     const FloatWeights &weights_b1,
+                     const Int8Weights &weights_w2,
+                     const FloatWeights &weights_b2,
+                     std::vector<float> &pool,
+                     std::vector<float> &fc_out,
+                     std::vector<float> &scale) {
+
+    assert(batch_size * channels <= pool.size());
+    assert(batch_size * se_size <= fc_out.size());
+    assert(batch_size * 2 * channels <= scale.size());
+
+    GlobalAvgPool::Forward(batch_size, channels, input, pool);
+    FullyConnect::Forward(batch_size, channels, se_size, pool, weights_w1, weights_b1, fc_out, true);
+    FullyConnect::Forward(batch_size, se_size, 2*channels, fc_out, weights_w2, weights_b2, scale, false);
+
+    SEProcess(batch_size, channels, input, residual, scale);
 }
 
-void SEUnit::SEProcess(const size_t channels,
+void SEUnit::SEProcess(const int batch_size,
+                       const size_t channels,
                        std::vector<float> &input,
                        const std::vector<float> &residual,
                        const std::vector<float> &scale) {
@@ -467,24 +770,26 @@ void SEUnit::SEProcess(const size_t channels,
         return 1.0f / (1.0f + std::exp(-val));
     };
 
-    auto gamma_ptr = scale.data();
-    auto beta_ptr = scale.data() + channels;
     auto input_ptr = input.data();
     auto res_ptr = residual.data();
 
+    for (int n = 0; n < batch_size; ++n) {
+        auto gamma_ptr = scale.data() + n * 2 * channels;
+        auto beta_ptr = gamma_ptr + channels;
 
-    for (auto c = size_t{0}; c < channels; ++c) {
-        const auto gamma = lambda_sigmoid(*gamma_ptr);
-        const auto beta = *beta_ptr;
+        for (auto c = size_t{0}; c < channels; ++c) {
+            const auto gamma = lambda_sigmoid(*gamma_ptr);
+            const auto beta = *beta_ptr;
 
-        gamma_ptr++;
-        beta_ptr++;
+            gamma_ptr++;
+            beta_ptr++;
 
-        for (auto i = size_t{0}; i < spatial_size; ++i) {
-            float value = *input_ptr;
-            *input_ptr = lambda_ReLU(gamma * value + beta + *res_ptr);
-            input_ptr++;
-            res_ptr++;
+            for (auto i = size_t{0}; i < spatial_size; ++i) {
+                float value = *input_ptr;
+                *input_ptr = lambda_ReLU(gamma * value + beta + *res_ptr);
+                input_ptr++;
+                res_ptr++;
+            }
         }
     }
 }
@@ -492,23 +797,25 @@ void SEUnit::SEProcess(const size_t channels,
 
 std::vector<float> Activation::Softmax(const std::vector<float> &input,
                                        const float temperature) {
-    auto output = std::vector<float>{};
-    output.reserve(input.size());
+    auto output = std::vector<float>(input.size());
+    Softmax(input.data(), input.size(), output.data(), temperature);
+    return output;
+}
 
-    const auto alpha = *std::max_element(std::begin(input), std::end(input));
+void Activation::Softmax(const float *input, const size_t size,
+                         float *output, const float temperature) {
+    const auto alpha = *std::max_element(input, input + size);
     auto denom = 0.0f;
 
-    for (const auto in_val : input) {
-        auto val = std::exp((in_val - alpha) / temperature);
+    for (auto i = size_t{0}; i < size; ++i) {
+        auto val = std::exp((input[i] - alpha) / temperature);
         denom += val;
-        output.emplace_back(val);
+        output[i] = val;
     }
 
-    for (auto &out : output) {
-        out /= denom;
+    for (auto i = size_t{0}; i < size; ++i) {
+        output[i] /= denom;
     }
-
-    return output;
 }
 
 
@@ -541,18 +848,24 @@ std::vector<float> Activation::Sigmoid(const std::vector<float> &input) {
 }
 
 
-void InputPool::Forward(const size_t input_size,
+void InputPool::Forward(const int batch_size,
+                        const size_t input_size,
                         const size_t squeeze,
                         const size_t channels,
                         const std::vector<float> &input,
-                        const std::vector<float> &weights_w1,
-                        const std::vector<float> &weights_b1,
-                        const std::vector<float> &weights_w2,
-                        const std::vector<float> &weights_b2,
-                        std::vector<float> &output) {
+                        const FloatWeights &weights_w1,
+                        const FloatWeights &weights_b1,
+                        const FloatWeights &weights_w2,
+                        const FloatWeights &weights_b2,
+                        std::vector<float> &output,
+                        std::vector<float> &fc_out1,
+                        std::vector<float> &fc_out2) {
 
-    auto fc_out1 = FullyConnect::innerproduct(input_size, squeeze, input, weights_w1, weights_b1, true);
-    auto fc_out2 = FullyConnect::innerproduct(squeeze, channels, fc_out1, weights_w2, weights_b2, false);
+    assert(batch_size * squeeze <= fc_out1.size());
+    assert(batch_size * channels <= fc_out2.size());
+
+    FullyConnect::Forward(batch_size, input_size, squeeze, input, weights_w1, weights_b1, fc_out1, true);
+    FullyConnect::Forward(batch_size, squeeze, channels, fc_out1, weights_w2, weights_b2, fc_out2, false);
 
     const auto lambda_ReLU = [](const auto val) {
         return (val > 0.0f) ? val : 0;
@@ -560,12 +873,14 @@ void InputPool::Forward(const size_t input_size,
 
     auto output_ptr = output.data();
 
-    for (auto c = size_t{0}; c < channels; ++c) {
-        auto bais = fc_out2[c];
-        for (auto i = size_t{0}; i < spatial_size; ++i) {
-            auto value = *output_ptr;
-            *output_ptr = lambda_ReLU(value + bais);
-            output_ptr++;
+    for (int n = 0; n < batch_size; ++n) {
+        for (auto c = size_t{0}; c < channels; ++c) {
+            auto bais = fc_out2[n * channels + c];
+            for (auto i = size_t{0}; i < spatial_size; ++i) {
+                auto value = *output_ptr;
+                *output_ptr = lambda_ReLU(value + bais);
+                output_ptr++;
+            }
         }
     }
 }
@@ -37,6 +37,7 @@
 #include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <cstdint>
 
 #include "Board.h"
 
@@ -83,33 +84,178 @@ public:
 
 };
 
+// The fp32 weights of one layer. It owns a buffer, or it only refers to
+// the weights owned by others, e.g. the mapped binary weights file. The
+// referred weights are read-only and must outlive it.
+class FloatWeights {
+public:
+    FloatWeights() = default;
+    explicit FloatWeights(std::vector<float> weights) : m_buffer(std::move(weights)) {}
+
+    FloatWeights &operator=(std::vector<float> weights) {
+        m_buffer = std::move(weights);
+        m_refer = nullptr;
+        m_refer_size = 0;
+        return *this;
+    }
+
+    void refer(const float *weights, const size_t size) {
+        m_buffer.clear();
+        m_buffer.shrink_to_fit();
+        m_refer = weights;
+        m_refer_size = size;
+    }
+
+    bool is_owner() const { return m_refer == nullptr; }
+
+    const float *data() const { return m_refer ? m_refer : m_buffer.data(); }
+    size_t size() const { return m_refer ? m_refer_size : m_buffer.size(); }
+    bool empty() const { return size() == 0; }
+
+    const float *begin() const { return data(); }
+    const float *end() const { return data() + size(); }
+
+    const float &operator[](const size_t idx) const { return data()[idx]; }
+
+    // Only the owned weights are writable.
+    float &operator[](const size_t idx) {
+        assert(is_owner());
+        return m_buffer[idx];
+    }
+
+    std::vector<float> to_vector() const { return std::vector<float>(begin(), end()); }
+
+private:
+    std::vector<float> m_buffer;
+    const float *m_refer{nullptr};
+    size_t m_refer_size{0};
+};
+
+// The int8 weights of one layer, [outputs][padded_inputs]. Every output
+// channel has its own symmetric scale. The sums of the quantized weights
+// remove the zero point of the unsigned inputs.
+struct Int8Weights {
+    int outputs{0};
+    int inputs{0};
+    int padded_inputs{0};
+    std::vector<std::int8_t> weights;
+    std::vector<float> scales;
+    std::vector<std::int32_t> sums;
+};
+
+// The int8 kernels. The inputs are unsigned 8 bits and the weights are
+// signed 8 bits, the products are accumulated in 32 bits. It is the form
+// of the VNNI instruction, VPDPBUSD.
+class Int8 {
+public:
+    // For convolution, the inputs are padded to multiple of 4.
+    static constexpr int GEMM_ALIGNMENT = 4;
+
+    // For fullyconnect, the inputs are padded to multiple of 64.
+    static constexpr int DENSE_ALIGNMENT = 64;
+
+    // The columns of the gemm are padded to multiple of 16.
+    static constexpr int GEMM_COLUMNS = 16;
+
+    static Int8Weights quantize_weights(const int outputs,
+                                        const int inputs,
+                                        const int alignment,
+                                        const FloatWeights &weights);
+
+    // Find the asymmetric scale and zero point of the inputs.
+    static void get_input_range(const float *input, const size_t size,
+                                float &scale, std::int32_t &zero_point);
+
+    static std::uint8_t quantize_input(const float val,
+                                       const float inv_scale,
+                                       const std::int32_t zero_point) {
+        const auto q = static_cast<std::int32_t>(std::round(val * inv_scale)) + zero_point;
+        return static_cast<std::uint8_t>(std::min(255, std::max(0, q)));
+    }
+
+    // C[M][N] = A[M][K] * B[K][N]. The B is packed as [K/4][N][4], so
+    // one 64 bytes load gives 4 inputs of 16 columns.
+    static void gemm(const int M, const int N, const int K,
+                     const std::int8_t *A,
+                     const std::uint8_t *B,
+                     std::int32_t *C);
+
+    // C[batch][M] = B[batch][K] * A[M][K]^T.
+    static void dense(const int M, const int batch_size, const int K,
+                      const std::int8_t *A,
+                      const std::uint8_t *B,
+                      std::int32_t *C);
+
+    static const char *get_kernel_name();
+};
+
 class FullyConnect {
 public:
     FullyConnect() = delete;
-    static void Forward(const int inputs_size,
+    static void Forward(const int batch_size,
+                        const int inputs_size,
+                        const int outputs_size,
+                        const std::vector<float> &input,
+                        const FloatWeights &weights,
+                        const FloatWeights &biases,
+                        std::vector<float> &output,
+                        const bool ReLU);
+
+    static void Forward(const int batch_size,
+                        const int inputs_size,
                         const int outputs_size,
                         const std::vector<float> &input,
-                        const std::vector<float> &weights,
-                        const std::vector<float> &biases,
+                        const Int8Weights &weights,
+                        const FloatWeights &biases,
                         std::vector<float> &output,
                         const bool ReLU);
 
     static std::vector<float> innerproduct(const int inputs_size,
                                            const int outputs_size,
                                            const std::vector<float> &input,
-                                           const std::vector<float> &weights,
-                                           const std::vector<float> &biases,
+                                           const FloatWeights &weights,
+                                           const FloatWeights &biases,
                                            const bool ReLU);
 };
 
+// The batchnorm layers are folded into the convolution weights. The
+// epilogue adds the biases and the residual, then applies the ReLU, it
+// runs on the output of each channel while it is still in the cache.
+class ConvEpilogue {
+public:
+    ConvEpilogue() = delete;
+    static void Forward(const float *input,
+                        float *output,
+                        const size_t size,
+                        const float bias,
+                        const float *const eltwise,
+                        const bool ReLU) {
+        if (eltwise) {
+            for (auto i = size_t{0}; i < size; ++i) {
+                const auto val = input[i] + bias + eltwise[i];
+                output[i] = (ReLU && val < 0.0f) ? 0.0f : val;
+            }
+        } else {
+            for (auto i = size_t{0}; i < size; ++i) {
+                const auto val = input[i] + bias;
+                output[i] = (ReLU && val < 0.0f) ? 0.0f : val;
+            }
+        }
+    }
+};
+
 class Convolve1 {
 public:
     Convolve1() = delete;
-    static void Forward(const size_t input_channels,
+    static void Forward(const int batch_size,
+                        const size_t input_channels,
                         const size_t output_channels,
                         const std::vector<float> &input,
-                        const std::vector<float> &weights,
-                        std::vector<float> &output);
+                        const FloatWeights &weights,
+                        const FloatWeights &biases,
+                        std::vector<float> &output,
+                        const float *const eltwise = nullptr,
+                        const bool ReLU = true);
 
 private:
     static constexpr auto width = CONV_WIDTH;
@@ -121,19 +267,48 @@ template <size_t FILTER_SIZE>
 class Convolve {
 public:
     Convolve() = delete;
-    static void Forward(const size_t input_channels,
+    static void Forward(const int batch_size,
+                        const size_t input_channels,
                         const size_t output_channels,
                         const std::vector<float> &input,
-                        const std::vector<float> &weights,
-                        std::vector<float> &col,
-                        std::vector<float> &output);
+                        const FloatWeights &weights,
+                        const FloatWeights &biases,
+                        std::vector<float> &workspace,
+                        std::vector<float> &output,
+                        const float *const eltwise = nullptr,
+                        const bool ReLU = true);
+
+    static void Forward(const int batch_size,
+                        const size_t input_channels,
+                        const size_t output_channels,
+                        const std::vector<float> &input,
+                        const Int8Weights &weights,
+                        const FloatWeights &biases,
+                        std::vector<std::int32_t> &workspace,
+                        std::vector<float> &output,
+                        const float *const eltwise = nullptr,
+                        const bool ReLU = true);
 
-    static size_t get_workspace_size(const size_t input_channels);
+    static size_t get_workspace_size(const int batch_size,
+                                     const size_t input_channels,
+                                     const size_t output_channels);
+
+    static size_t get_int8_workspace_size(const int batch_size,
+                                          const size_t input_channels,
+                                          const size_t output_channels);
 
 private:
-    static void im2col(const int channels,
+    static void im2col(const int batch_size,
+                       const int channels,
                        const std::vector<float> &input,
-                       std::vector<float> &col);
+                       float *col);
+
+    static void im2col_int8(const int batch_size,
+                            const int channels,
+                            const int columns,
+                            const std::uint8_t *input,
+                            const std::int32_t *zero_points,
+                            std::uint8_t *col);
 
     static constexpr auto filter_size = FILTER_SIZE;
     static constexpr auto width = CONV_WIDTH;
@@ -145,9 +320,10 @@ private:
 class AddSpatialBias {
 public:
     AddSpatialBias() = delete;
-    static void Forward(const size_t channels,
+    static void Forward(const int batch_size,
+                        const size_t channels,
                         std::vector<float> &input,
-                        const std::vector<float> &biases);
+                        const FloatWeights &biases);
 private:
     static constexpr auto width = CONV_WIDTH;
     static constexpr auto height = CONV_HEIGHT;
@@ -157,10 +333,11 @@ private:
 class Batchnorm {
 public:
     Batchnorm() = delete;
-    static void Forward(const size_t channels,
+    static void Forward(const int batch_size,
+                        const size_t channels,
                         std::vector<float> &input,
-                        const std::vector<float> &means,
-                        const std::vector<float> &stddevs,
+                        const FloatWeights &means,
+                        const FloatWeights &stddevs,
                         const float *const eltwise = nullptr,
                         const bool ReLU = true);
 
@@ -173,7 +350,8 @@ private:
 class GlobalAvgPool {
 public:
     GlobalAvgPool() = delete;
-    static void Forward(const size_t input_channels,
+    static void Forward(const int batch_size,
+                        const size_t input_channels,
                         const std::vector<float> &input,
                         std::vector<float> &output);
 
@@ -187,17 +365,35 @@ private:
 class SEUnit {
 public:
     SEUnit() = delete;
-    static void Forward(const size_t channels,
+    static void Forward(const int batch_size,
+                        const size_t channels,
                         const size_t se_size,
                         std::vector<float> &input,
                         const std::vector<float> &residual,
-                        const std::vector<float> &weights_w1,
-                        const std::vector<float> &weights_b1,
-                        const std::vector<float> &weights_w2,
-                        const std::vector<float> &weights_b2);
+                        const FloatWeights &weights_w1,
+                        const FloatWeights &weights_b1,
+                        const FloatWeights &weights_w2,
+                        const FloatWeights &weights_b2,
+                        std::vector<float> &pool,
+                        std::vector<float> &fc_out,
+                        std::vector<float> &scale);
+
+    static void Forward(const int batch_size,
+                        const size_t channels,
+                        const size_t se_size,
+                        std::vector<float> &input,
+                        const std::vector<float> &residual,
+                        const Int8Weights &weights_w1,
+                        const FloatWeights &weights_b1,
+                        const Int8Weights &weights_w2,
+                        const FloatWeights &weights_b2,
+                        std::vector<float> &pool,
+                        std::vector<float> &fc_out,
+                        std::vector<float> &scale);
 
 private:
-    static void SEProcess(const size_t channels,
+    static void SEProcess(const int batch_size,
+                          const size_t channels,
                           std::vector<float> &input,
                           const std::vector<float> &residual,
                           const std::vector<float> &scale);
@@ -212,6 +408,9 @@ public:
     static std::vector<float> Softmax(const std::vector<float> &input,
                                       const float temperature = 1.0f);
 
+    static void Softmax(const float *input, const size_t size,
+                        float *output, const float temperature = 1.0f);
+
     static std::vector<float> Tanh(const std::vector<float> &input);
 
     static std::vector<float> Sigmoid(const std::vector<float> &input);
@@ -221,65 +420,90 @@ public:
 
 
 template <size_t FILTER_SIZE>
-void Convolve<FILTER_SIZE>::Forward(const size_t input_channels,
+void Convolve<FILTER_SIZE>::Forward(const int batch_size,
+                                    const size_t input_channels,
                                     const size_t output_channels,
                                     const std::vector<float> &input,
-                                    const std::vector<float> &weights,
-                                    std::vector<float> &col,
-                                    std::vector<float> &output) {
+                                    const FloatWeights &weights,
+                                    const FloatWeights &biases,
+                                    std::vector<float> &workspace,
+                                    std::vector<float> &output,
+                                    const float *const eltwise,
+                                    const bool ReLU) {
 
     constexpr auto filter_len = filter_size * filter_size;
     const auto filter_dim = filter_len * input_channels;
-    assert(output_channels * spatial_size == output.size());
-
-    im2col(input_channels, input, col);
+    const auto batch_spatial = batch_size * spatial_size;
+    assert(batch_size * output_channels * spatial_size <= output.size());
+    assert(get_workspace_size(batch_size, input_channels, output_channels) <= workspace.size());
+
+    // The columns of the whole batch are placed side by side, so one
+    // GEMM computes all the positions. The result is [channels][batch][spatial],
+    // we reorder it back to [batch][channels][spatial] later.
+    float *col = workspace.data();
+    float *gemm_out = batch_size == 1 ? output.data()
+                                      : workspace.data() + filter_dim * batch_spatial;
+
+    im2col(batch_size, input_channels, input, col);
     Blas::fixed_gemm((int)output_channels,
-                     spatial_size,
+                     batch_spatial,
                      (int)filter_dim,
                      1.0f,
                      weights.data(),
                      (int)filter_dim,
-                     col.data(),
-                     spatial_size,
+                     col,
+                     batch_spatial,
                      0.0f,
-                     output.data(),
-                     spatial_size);
-
+                     gemm_out,
+                     batch_spatial);
+
+    // The epilogue is fused with the reordering. If the batch size is
+    // one, it is in place.
+    for (auto o = size_t{0}; o < output_channels; ++o) {
+        for (int b = 0; b < batch_size; ++b) {
+            const auto offset = (b * output_channels + o) * spatial_size;
+            const auto src = gemm_out + o * batch_spatial + b * spatial_size;
+            const auto dst = output.data() + offset;
+            ConvEpilogue::Forward(src, dst, spatial_size, biases[o],
+                                  eltwise ? eltwise + offset : nullptr, ReLU);
+        }
+    }
 }
 
 template <size_t FILTER_SIZE>
-void Convolve<FILTER_SIZE>::im2col(const int channels,
+void Convolve<FILTER_SIZE>::im2col(const int batch_size,
+                                   const int channels,
                                    const std::vector<float> &input,
-                                   std::vector<float> &output) {
+                                   float *data_col) {
 
     constexpr int pad = (filter_size / 2);
     unsigned int output_h = height + 2 * pad - filter_size + 1;
     unsigned int output_w = width + 2 * pad - filter_size + 1;
 
-    const float *data_im = input.data();
-    float *data_col = output.data();
-
-    for (int channel = channels; channel--; data_im += spatial_size) {
+    for (int channel = 0; channel < channels; ++channel) {
         for (unsigned int kernel_row = 0; kernel_row < filter_size; kernel_row++) {
             for (unsigned int kernel_col = 0; kernel_col < filter_size;  kernel_col++) {
-                int input_row = -pad + kernel_row;
-                for (int output_rows = output_h; output_rows; output_rows--) {
-                    if (unsigned(input_row) < height) {
-                        int input_col = -pad + kernel_col;
-                        for (int output_col = output_w; output_col; output_col--) {
-                            if (unsigned(input_col) < width) {
-                                *(data_col++) = data_im[input_row * width + input_col];
-                            } else {
+                for (int b = 0; b < batch_size; ++b) {
+                    const float *data_im = input.data() + (b * channels + channel) * spatial_size;
+                    int input_row = -pad + kernel_row;
+                    for (int output_rows = output_h; output_rows; output_rows--) {
+                        if (unsigned(input_row) < height) {
+                            int input_col = -pad + kernel_col;
+                            for (int output_col = output_w; output_col; output_col--) {
+                                if (unsigned(input_col) < width) {
+                                    *(data_col++) = data_im[input_row * width + input_col];
+                                } else {
+                                    *(data_col++) = 0;
+                                }
+                                input_col++;
+                            }
+                        } else {
+                            for (int output_cols = output_w; output_cols; output_cols--) {
                                 *(data_col++) = 0;
                             }
-                            input_col++;
-                        }
-                    } else {
-                        for (int output_cols = output_w; output_cols; output_cols--) {
-                            *(data_col++) = 0;
                         }
+                        input_row++;
                     }
-                    input_row++;
                 }
             }
         }
@@ -287,24 +511,157 @@ void Convolve<FILTER_SIZE>::im2col(const int channels,
 }
 
 template <size_t FILTER_SIZE>
-size_t Convolve<FILTER_SIZE>::get_workspace_size(const size_t input_channels) {
+size_t Convolve<FILTER_SIZE>::get_workspace_size(const int batch_size,
+                                                 const size_t input_channels,
+                                                 const size_t output_channels) {
     constexpr  auto filter_len = filter_size * filter_size;
     const auto filter_dim = filter_len * input_channels;
-    return filter_dim * width * height;
+    const auto col_size = filter_dim * width * height * batch_size;
+    if (batch_size == 1) {
+        return col_size;
+    }
+    return col_size + output_channels * width * height * batch_size;
+}
+
+template <size_t FILTER_SIZE>
+size_t Convolve<FILTER_SIZE>::get_int8_workspace_size(const int batch_size,
+                                                      const size_t input_channels,
+                                                      const size_t output_channels) {
+    constexpr auto filter_len = filter_size * filter_size;
+    const auto align = size_t{Int8::GEMM_ALIGNMENT};
+    const auto padded_dim = (filter_len * input_channels + align - 1) / align * align;
+    const auto columns = (batch_size * spatial_size + Int8::GEMM_COLUMNS - 1) /
+                             Int8::GEMM_COLUMNS * Int8::GEMM_COLUMNS;
+
+    // The accumulators, the columns and the quantized inputs. The
+    // last two are bytes.
+    const auto bytes = padded_dim * columns + batch_size * input_channels * spatial_size;
+    return output_channels * columns + (bytes + 3) / 4;
+}
+
+template <size_t FILTER_SIZE>
+void Convolve<FILTER_SIZE>::Forward(const int batch_size,
+                                    const size_t input_channels,
+                                    const size_t output_channels,
+                                    const std::vector<float> &input,
+                                    const Int8Weights &weights,
+                                    const FloatWeights &biases,
+                                    std::vector<std::int32_t> &workspace,
+                                    std::vector<float> &output,
+                                    const float *const eltwise,
+                                    const bool ReLU) {
+
+    constexpr auto filter_len = filter_size * filter_size;
+    const auto padded_dim = weights.padded_inputs;
+    const auto batch_spatial = batch_size * spatial_size;
+    const auto columns = (batch_spatial + Int8::GEMM_COLUMNS - 1) /
+                             Int8::GEMM_COLUMNS * Int8::GEMM_COLUMNS;
+    assert(weights.inputs == (int)(filter_len * input_channels));
+    assert(weights.outputs == (int)output_channels);
+    assert(batch_size * output_channels * spatial_size <= output.size());
+    assert(get_int8_workspace_size(batch_size, input_channels, output_channels) <= workspace.size());
+    (void) filter_len;
+
+    std::int32_t *acc = workspace.data();
+    auto col = reinterpret_cast<std::uint8_t*>(workspace.data() + output_channels * columns);
+    auto quantized = col + padded_dim * columns;
+
+    // Every position of the batch has its own input range.
+    auto scales = std::vector<float>(batch_size);
+    auto zero_points = std::vector<std::int32_t>(batch_size);
+    for (int b = 0; b < batch_size; ++b) {
+        const auto size = input_channels * spatial_size;
+        const float *input_ptr = input.data() + b * size;
+        Int8::get_input_range(input_ptr, size, scales[b], zero_points[b]);
+
+        const auto inv_scale = 1.0f / scales[b];
+        for (auto i = size_t{0}; i < size; ++i) {
+            quantized[b * size + i] = Int8::quantize_input(input_ptr[i], inv_scale, zero_points[b]);
+        }
+    }
+
+    // The padding inputs and columns must be zero.
+    std::fill(col, col + padded_dim * columns, 0);
+    im2col_int8(batch_size, input_channels, columns, quantized, zero_points.data(), col);
+
+    Int8::gemm((int)output_channels, columns, padded_dim,
+               weights.weights.data(), col, acc);
+
+    // Dequantize and reorder the result to [batch][channels][spatial],
+    // then apply the epilogue.
+    for (auto o = size_t{0}; o < output_channels; ++o) {
+        const auto w_scale = weights.scales[o];
+        const auto w_sum = weights.sums[o];
+        for (int b = 0; b < batch_size; ++b) {
+            const auto scale = w_scale * scales[b];
+            const auto offset = zero_points[b] * w_sum;
+            const auto out_offset = (b * output_channels + o) * spatial_size;
+            const auto src = acc + o * columns + b * spatial_size;
+            const auto dst = output.data() + out_offset;
+            for (auto i = size_t{0}; i < spatial_size; ++i) {
+                dst[i] = scale * static_cast<float>(src[i] - offset);
+            }
+            ConvEpilogue::Forward(dst, dst, spatial_size, biases[o],
+                                  eltwise ? eltwise + out_offset : nullptr, ReLU);
+        }
+    }
+}
+
+template <size_t FILTER_SIZE>
+void Convolve<FILTER_SIZE>::im2col_int8(const int batch_size,
+                                        const int channels,
+                                        const int columns,
+                                        const std::uint8_t *input,
+                                        const std::int32_t *zero_points,
+                                        std::uint8_t *col) {
+
+    constexpr int pad = (filter_size / 2);
+    constexpr int align = Int8::GEMM_ALIGNMENT;
+
+    // The packed layout is [filter_dim/4][columns][4]. The vertices
+    // out of the board are the zero points, it is the real zero.
+    for (int channel = 0; channel < channels; ++channel) {
+        for (int kernel_row = 0; kernel_row < (int)filter_size; kernel_row++) {
+            for (int kernel_col = 0; kernel_col < (int)filter_size; kernel_col++) {
+                const int k = (channel * filter_size + kernel_row) * filter_size + kernel_col;
+                std::uint8_t *dst = col + (k / align) * columns * align + (k % align);
+
+                for (int b = 0; b < batch_size; ++b) {
+                    const std::uint8_t *data_im = input + (b * channels + channel) * spatial_size;
+                    const auto zero_point = static_cast<std::uint8_t>(zero_points[b]);
+                    for (int y = 0; y < (int)height; ++y) {
+                        const int input_row = y - pad + kernel_row;
+                        for (int x = 0; x < (int)width; ++x) {
+                            const int input_col = x - pad + kernel_col;
+                            if (unsigned(input_row) < height && unsigned(input_col) < width) {
+                                *dst = data_im[input_row * width + input_col];
+                            } else {
+                                *dst = zero_point;
+                            }
+                            dst += align;
+                        }
+                    }
+                }
+            }
+        }
+    }
 }
 
 class InputPool {
 public:
     InputPool() = delete;
-    static void Forward(const size_t input_size,
+    static void Forward(const int batch_size,
+                        const size_t input_size,
                         const size_t squeeze,
                         const size_t channels,
                         const std::vector<float> &input,
-                        const std::vector<float> &weights_w1,
-                        const std::vector<float> &weights_b1,
-                        const std::vector<float> &weights_w2,
-                        const std::vector<float> &weights_b2,
-                        std::vector<float> &output);
+                        const FloatWeights &weights_w1,
+                        const FloatWeights &weights_b1,
+                        const FloatWeights &weights_w2,
+                        const FloatWeights &weights_b2,
+                        std::vector<float> &output,
+                        std::vector<float> &fc_out1,
+                        std::vector<float> &fc_out2);
 
 private:
     static constexpr auto width = CONV_WIDTH;
@@ -28,11 +28,83 @@ constexpr std::array<Types::Piece, Board::NUM_VERTICES> Board::START_VERTICES;
 
 constexpr std::array<Types::Direction, 8> Board::m_dirs;
 
-std::array<std::array<BitBoard, Board::NUM_VERTICES>, 2> Board::m_pawn_attacks;
-std::array<BitBoard, Board::NUM_VERTICES> Board::m_advisor_attacks;
-std::array<BitBoard, Board::NUM_VERTICES> Board::m_king_attacks;
+namespace {
+
+using VertexTable = StaticArray<BitBoard, BITBOARD_NUM_VERTICES>;
+
+constexpr VertexTable generate_pawn_attacks(const Types::Color color) {
+    auto table = VertexTable{};
+    for (int vtx = 0; vtx < BITBOARD_NUM_VERTICES; ++vtx) {
+        auto attack = BitBoard(0ULL);
+        if (!Utils::on_board(vtx)) {
+            table[vtx] = attack;
+            continue;
+        }
+        if (color == Types::BLACK) {
+            attack |= Utils::vertex2bitboard(vtx + Types::SOUTH);
+            if (Utils::on_area(vtx, RedSide)) {
+                attack |= Utils::vertex2bitboard(vtx + Types::WEST);
+                attack |= Utils::vertex2bitboard(vtx + Types::EAST);
+            }
+        } else {
+            attack |= Utils::vertex2bitboard(vtx + Types::NORTH);
+            if (Utils::on_area(vtx, BlackSide)) {
+                attack |= Utils::vertex2bitboard(vtx + Types::WEST);
+                attack |= Utils::vertex2bitboard(vtx + Types::EAST);
+            }
+        }
+        table[vtx] = attack & onBoard;
+    }
+    return table;
+}
+
+// The reverse table, the pawns on these vertices attack the vertex.
+constexpr VertexTable generate_pawn_attackers(const Types::Color color) {
+    const auto attacks = generate_pawn_attacks(color);
+    auto table = VertexTable{};
+    for (int v = 0; v < BITBOARD_NUM_VERTICES; ++v) {
+        for (int vtx = 0; vtx < BITBOARD_NUM_VERTICES; ++vtx) {
+            if (attacks[v] & Utils::vertex2bitboard(vtx)) {
+                table[vtx] |= Utils::vertex2bitboard(v);
+            }
+        }
+    }
+    return table;
+}
+
+// One step to the given directions, and stay in the palace.
+constexpr VertexTable generate_palace_attacks(const Types::Direction (&dirs)[4]) {
+    auto table = VertexTable{};
+    for (int v = 0; v < BITBOARD_NUM_VERTICES; ++v) {
+        const auto bb = Utils::vertex2bitboard(v);
+        auto mask = BitBoard(0ULL);
+        if (Utils::on_area(bb, KingArea)) {
+            for (const auto dir : dirs) {
+                mask |= Utils::shift(dir, bb);
+            }
+            mask &= KingArea;
+        }
+        table[v] = mask;
+    }
+    return table;
+}
+
+constexpr Types::Direction advisor_dirs[4] =
+    {Types::NORTH_EAST, Types::SOUTH_EAST, Types::SOUTH_WEST, Types::NORTH_WEST};
+constexpr Types::Direction king_dirs[4] =
+    {Types::NORTH, Types::EAST, Types::SOUTH, Types::WEST};
+
+} // namespace
+
+constexpr StaticArray<Board::AttackTable, 2> Board::m_pawn_attacks =
+    {{generate_pawn_attacks(Types::RED), generate_pawn_attacks(Types::BLACK)}};
+constexpr StaticArray<Board::AttackTable, 2> Board::m_pawn_attackers =
+    {{generate_pawn_attackers(Types::RED), generate_pawn_attackers(Types::BLACK)}};
+constexpr Board::AttackTable Board::m_advisor_attacks = generate_palace_attacks(advisor_dirs);
+constexpr Board::AttackTable Board::m_king_attacks = generate_palace_attacks(king_dirs);
 
 std::array<Board::Magic, Board::NUM_VERTICES> Board::m_horse_magics;
+std::array<Board::Magic, Board::NUM_VERTICES> Board::m_horseattacker_magics;
 std::array<Board::Magic, Board::NUM_VERTICES> Board::m_elephant_magics;
 
 std::array<Board::Magic, Board::NUM_VERTICES> Board::m_rookrank_magics;
@@ -41,6 +113,8 @@ std::array<Board::Magic, Board::NUM_VERTICES> Board::m_rookfile_magics;
 std::array<Board::Magic, Board::NUM_VERTICES> Board::m_cannonrank_magics;
 std::array<Board::Magic, Board::NUM_VERTICES> Board::m_cannonfile_magics;
 
+std::vector<BitBoard> Board::m_attacks_table;
+
 #define PIECES_CACHE                                         \
 const auto blk_pawn = option<char>("black_pawn_en");         \
 const auto blk_cannon = option<char>("black_cannon_en");     \
@@ -62,7 +136,6 @@ void Board::reset_board() {
     auto start_position = get_start_position();
     fen2board(start_position);
     m_hash = calc_hash();
-    m_bb_attacks = calc_attacks();
 }
 
 void Board::clear_status() {
@@ -216,6 +289,19 @@ bool Board::fen2board(std::string &fen) {
         success = false;
     }
 
+    // No side may have more pieces than at the start. The moves never
+    // add any, so the move list never overflows. See MoveList.
+    for (const auto bb_color : {bb_red, bb_black}) {
+        if (Utils::count(bb_pawn & bb_color) > 5 ||
+                Utils::count(bb_cannon & bb_color) > 2 ||
+                Utils::count(bb_rook & bb_color) > 2 ||
+                Utils::count(bb_horse & bb_color) > 2 ||
+                Utils::count(bb_elephant & bb_color) > 2 ||
+                Utils::count(bb_advisor & bb_color) > 2) {
+            success = false;
+        }
+    }
+
     if (success) {
         clear_status();
         m_king_vertex[Types::RED] = king_vertex_red;
@@ -236,77 +322,14 @@ bool Board::fen2board(std::string &fen) {
 
         // Calculate the new hash value and attacks.
         m_hash = calc_hash();
-        m_bb_attacks = calc_attacks();
+        init_attacks();
     }
 
     return success;
 }
 
-void Board::init_pawn_attacks() {
-    const auto lambda_pawn_attacks = [](const int vtx, const int color) -> BitBoard {
-        auto BitBoard = tie(0ULL, 0ULL);
-        if (color == Types::BLACK) {
-            BitBoard |= Utils::vertex2bitboard(vtx + Types::SOUTH);
-            if (Utils::on_area(vtx, RedSide)) {
-                BitBoard |= Utils::vertex2bitboard(vtx + Types::WEST);
-                BitBoard |= Utils::vertex2bitboard(vtx + Types::EAST);
-            }
-            BitBoard &= onBoard;
-        } else if (color == Types::RED) {
-            BitBoard |= Utils::vertex2bitboard(vtx + Types::NORTH);
-            if (Utils::on_area(vtx, BlackSide)) {
-                BitBoard |= Utils::vertex2bitboard(vtx + Types::WEST);
-                BitBoard |= Utils::vertex2bitboard(vtx + Types::EAST);
-            }
-            BitBoard &= onBoard;
-        }
-
-        return BitBoard;
-    };
-
-    for (int y = 0; y < HEIGHT; ++y) {
-        for (int x = 0; x < WIDTH; ++x) {
-            const auto vtx = get_vertex(x, y);
-            m_pawn_attacks[Types::RED][vtx] = lambda_pawn_attacks(vtx, Types::RED);
-            m_pawn_attacks[Types::BLACK][vtx] = lambda_pawn_attacks(vtx, Types::BLACK);
-        }
-    }
-}
-
-// Initialize attack table and magic mask.
+// Initialize the magic masks.
 void Board::init_move_pattens() {
-    init_pawn_attacks();
-
-    // advisor attacks
-    for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
-        const auto bb = Utils::vertex2bitboard(v);
-        auto mask = BitBoard(0ULL);
-        if (Utils::on_area(bb, KingArea)) {
-            for (int k = 4; k < 8; ++k) {
-                const auto dir = Board::m_dirs[k];
-                const auto k_bb = Utils::shift(dir, bb);
-                mask |= k_bb;
-            }
-            mask &= KingArea;
-        }
-        m_advisor_attacks[v] = mask;
-    }
-
-    // king attacks
-    for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
-        const auto bb = Utils::vertex2bitboard(v);
-        auto mask = BitBoard(0ULL);
-        if (Utils::on_area(bb, KingArea)) {
-            for (int k = 0; k < 4; ++k) {
-                const auto dir = Board::m_dirs[k];
-                const auto k_bb = Utils::shift(dir, bb);
-                mask |= k_bb;
-            }
-            mask &= KingArea;
-        }
-        m_king_attacks[v] = mask;
-    }
-
     // horse magics
     for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
         const auto bb = Utils::vertex2bitboard(v);
@@ -333,6 +356,10 @@ void Board::init_move_pattens() {
             }
         }
         m_elephant_magics[v].mask = mask;
+
+        // The legs of the horses which attack this vertex are the
+        // diagonal vertices too.
+        m_horseattacker_magics[v].mask = mask;
     }
 
     // rank and file magics
@@ -340,17 +367,19 @@ void Board::init_move_pattens() {
         const auto x = get_x(v);
         const auto y = get_y(v);
         const auto rankmask = (Rank0BB << (BITBOARD_SHIFT * y)) & onBoard;
-        auto filemask = (FileABB << x) & onBoard;
-
-        m_rookrank_magics[v].mask = rankmask;
-        m_rookfile_magics[v].mask = filemask;
-        m_cannonrank_magics[v].mask = rankmask;
-        m_cannonfile_magics[v].mask = filemask;
+        const auto filemask = (FileABB << x) & onBoard;
 
         const auto test = rankmask & filemask;
         if (test) {
             assert(test == Utils::vertex2bitboard(v));
         }
+
+        // The slider itself is always on its vertex, it is not a
+        // part of the index.
+        m_rookrank_magics[v].mask = rankmask & ~test;
+        m_rookfile_magics[v].mask = filemask & ~test;
+        m_cannonrank_magics[v].mask = rankmask & ~test;
+        m_cannonfile_magics[v].mask = filemask & ~test;
     }
 }
 
@@ -359,13 +388,25 @@ void Board::init_magics() {
     // Some masks may be out of the board (ex. VTX_J0, VTX_J1, ... ,VTX_J8, VTX_J9), or
     // out of itself legal area. Find them and set invalid.
     const auto set_valid = [](std::array<Magic, NUM_VERTICES> &magics) -> void {
-        std::for_each(std::begin(magics), std::end(magics), [](auto &in){
-                          if (in.mask != BitBoard(0ULL)) {
-                              in.valid = true;
-                          } else {
-                              in.valid = false;
-                          }
-                      }); 
+        for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
+            magics[v].valid = is_on_board(v) && magics[v].mask != BitBoard(0ULL);
+        }
+    };
+
+    // The size of the table of one magic. The original hash table size
+    // is enough. But the adding the addition size may be more easy to
+    // find all magic numbers. The pext index needs no addition.
+    const auto get_attacksize = [](const int addition, const Magic &magic) -> size_t {
+        if (!magic.valid) {
+            return 0;
+        }
+        const auto count = Utils::count(magic.mask);
+#ifdef USE_PEXT
+        (void) addition;
+        return size_t{1} << count;
+#else
+        return size_t{1} << (count + addition);
+#endif
     };
 
     // Generate the magic numbers.
@@ -382,14 +423,10 @@ void Board::init_magics() {
         const auto begin = 0ULL;
         const auto end = 1ULL << count;
 
-        // The original hash table size is enough. But the adding the
-        // addition size may be more easy to find all magic numbers.
-        const auto attacksize = 1ULL << (count + addition);
+        const auto attacksize = get_attacksize(addition, magics[v]);
 
         magics[v].shift = 64 - (count + addition);
-        magics[v].attacks.resize(attacksize);
-        magics[v].attacks.shrink_to_fit();
-        magics[v].limit = magics[v].attacks.size();
+        magics[v].limit = attacksize;
         auto used = std::vector<bool>(attacksize);
 
         auto vtxs = std::vector<Types::Vertices>{};
@@ -424,10 +461,9 @@ void Board::init_magics() {
             // generated by magic number. 
             auto reference = generate_reference(center, occupancy);
 
-            if (!reference) {
-                continue;
-            }
-
+            // The empty reference must be stored too. The fully blocked
+            // horse and elephant have no move. If we skip them, the index
+            // may collide with other occupancy and return its moves.
             const auto index = magics[v].index(occupancy);
             if (!used[index]) {
                 magics[v].attacks[index] = reference;
@@ -435,7 +471,7 @@ void Board::init_magics() {
             } else {
                 // If the slot has been used. Mean the collision was happened. We
                 // need to check if the slot is same as new reference. If they are
-                // different. Fail this time.
+                // different. Fail this time. The pext index never collides.
                 if (magics[v].attacks[index] != reference) {
                     b = begin-1;
                 }
@@ -482,6 +518,29 @@ void Board::init_magics() {
         return reference;
     };
 
+    const auto horseattacker_reference = [&](BitBoard &center,
+                                             BitBoard &occupancy) -> BitBoard {
+        const auto lambda_components = [](const Types::Direction dir) {
+            const auto vertical = (dir == Types::NORTH_EAST || dir == Types::NORTH_WEST) ?
+                                      Types::NORTH : Types::SOUTH;
+            const auto horizontal = (dir == Types::NORTH_EAST || dir == Types::SOUTH_EAST) ?
+                                        Types::EAST : Types::WEST;
+            return std::make_pair(vertical, horizontal);
+        };
+
+        auto reference = BitBoard(0ULL);
+        for (int k = 4; k < 8; ++k) {
+            const auto dir = Board::m_dirs[k];
+            const auto leg = Utils::shift(dir, center);
+            if (!(leg & occupancy)) {
+                const auto components = lambda_components(dir);
+                reference |= Utils::shift(components.first, leg);
+                reference |= Utils::shift(components.second, leg);
+            }
+        }
+        return reference;
+    };
+
     const auto rookrank_reference = [&](BitBoard &center,
                                         BitBoard &occupancy) -> BitBoard {
         auto reference = BitBoard(0ULL);
@@ -550,21 +609,57 @@ void Board::init_magics() {
         return reference;
     };
 
+    struct MagicTable {
+        std::array<Magic, NUM_VERTICES> &magics;
+        int addition;
+        std::function<BitBoard(BitBoard &, BitBoard &)> reference;
+    };
+
+    // The rook and cannon tables are the most used. They are the
+    // first ones.
+    const auto tables = std::array<MagicTable, 7>{{
+        {m_rookrank_magics, 2, rookrank_reference},
+        {m_rookfile_magics, 4, rookfile_reference},
+        {m_cannonrank_magics, 2, cannonrank_reference},
+        {m_cannonfile_magics, 4, cannonfile_reference},
+        {m_horse_magics, 0, horse_reference},
+        {m_horseattacker_magics, 0, horseattacker_reference},
+        {m_elephant_magics, 0, elephant_reference}
+    }};
+
     auto timer = Utils::Timer{};
-    set_valid(m_elephant_magics);
-    set_valid(m_horse_magics);
-    set_valid(m_rookrank_magics);
-    set_valid(m_rookfile_magics);
-    set_valid(m_cannonrank_magics);
-    set_valid(m_cannonfile_magics);
 
-    for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
-        generate_magics(0, v, m_elephant_magics, elephant_reference);
-        generate_magics(0, v, m_horse_magics, horse_reference);
-        generate_magics(2, v, m_rookrank_magics, rookrank_reference);
-        generate_magics(4, v, m_rookfile_magics, rookfile_reference);
-        generate_magics(2, v, m_cannonrank_magics, cannonrank_reference);
-        generate_magics(4, v, m_cannonfile_magics, cannonfile_reference);
+    // Share out the one table. Every slice is rounded up to full cache
+    // lines.
+    constexpr auto LINE_SIZE = size_t{64} / sizeof(BitBoard);
+    const auto lambda_round_up = [LINE_SIZE](size_t size) {
+        return (size + LINE_SIZE - 1) / LINE_SIZE * LINE_SIZE;
+    };
+
+    auto tablesize = size_t{0};
+    for (const auto &table : tables) {
+        set_valid(table.magics);
+        for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
+            tablesize += lambda_round_up(get_attacksize(table.addition, table.magics[v]));
+        }
+    }
+
+    m_attacks_table.assign(tablesize + LINE_SIZE, BitBoard(0ULL));
+    m_attacks_table.shrink_to_fit();
+
+    const auto misalign = reinterpret_cast<std::uintptr_t>(m_attacks_table.data()) % 64;
+    auto attacks = m_attacks_table.data() + (misalign ? (64 - misalign) / sizeof(BitBoard) : 0);
+    for (const auto &table : tables) {
+        for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
+            table.magics[v].attacks = attacks;
+            attacks += lambda_round_up(get_attacksize(table.addition, table.magics[v]));
+        }
+    }
+
+    for (const auto &table : tables) {
+        for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
+            generate_magics(table.addition, v, table.magics, table.reference);
+        }
     }
 
     const auto t = timer.get_duration();
@@ -576,27 +671,28 @@ void Board::init_magics() {
 void Board::dump_memory() {
     auto res = size_t{0};
     res += sizeof(m_pawn_attacks);
+    res += sizeof(m_pawn_attackers);
     res += sizeof(m_advisor_attacks);
     res += sizeof(m_king_attacks);
 
     res += sizeof(m_horse_magics);
+    res += sizeof(m_horseattacker_magics);
     res += sizeof(m_elephant_magics);
     res += sizeof(m_rookrank_magics);
     res += sizeof(m_rookfile_magics);
     res += sizeof(m_cannonrank_magics);
     res += sizeof(m_cannonfile_magics);
 
-    for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
-        res += sizeof(BitBoard) * m_horse_magics[v].attacks.capacity();
-        res += sizeof(BitBoard) * m_elephant_magics[v].attacks.capacity();
-        res += sizeof(BitBoard) * m_rookrank_magics[v].attacks.capacity();
-        res += sizeof(BitBoard) * m_rookfile_magics[v].attacks.capacity();
-        res += sizeof(BitBoard) * m_cannonrank_magics[v].attacks.capacity();
-        res += sizeof(BitBoard) * m_cannonfile_magics[v].attacks.capacity();
-    }
+    res += sizeof(BitBoard) * m_attacks_table.capacity();
+
+#ifdef USE_PEXT
+    const auto indexing = "pext";
+#else
+    const auto indexing = "magic";
+#endif
     if (option<bool>("stats_verbose")) {
-        Utils::printf<Utils::AUTO>("Attacks Table Memory : %.4f (Mib)\n",
-                                        static_cast<float>(res) / (1024.f * 1024.f));
+        Utils::printf<Utils::AUTO>("Attacks Table Memory : %.4f (Mib), %s index\n",
+                                        static_cast<float>(res) / (1024.f * 1024.f), indexing);
     }
 }
 
@@ -829,13 +925,166 @@ std::uint64_t Board::calc_hash() const {
     return res;
 }
 
-std::array<BitBoard, 2> Board::calc_attacks() {
-    auto bb_attacks = std::array<BitBoard, 2>{};
-    auto movelist = std::vector<Move>{};
-    bb_attacks[Types::RED] = generate_movelist(Types::RED, movelist);
-    movelist.clear();
-    bb_attacks[Types::BLACK] = generate_movelist(Types::BLACK, movelist);
-    return bb_attacks;
+BitBoard Board::calc_piece_attacks(Types::Piece_t pt, Types::Color color) const {
+    const auto opp_color = swap_color(color);
+    const auto occupancy = m_bb_color[Types::RED] | m_bb_color[Types::BLACK];
+    auto attacks = BitBoard(0ULL);
+
+    if (pt == Types::KING) {
+        const auto vtx = m_king_vertex[color];
+        if (vtx == Types::NO_VERTEX) {
+            return attacks;
+        }
+        attacks = m_king_attacks[vtx];
+        if (m_king_face) {
+            attacks |= Utils::vertex2bitboard(m_king_vertex[opp_color]);
+        }
+        return attacks;
+    }
+
+    const auto side = color == Types::RED ? RedSide : BlackSide;
+    auto bb = m_bb_color[color];
+    switch (pt) {
+        case Types::PAWN:     bb &= m_bb_pawn;     break;
+        case Types::CANNON:   bb &= m_bb_cannon;   break;
+        case Types::ROOK:     bb &= m_bb_rook;     break;
+        case Types::HORSE:    bb &= m_bb_horse;    break;
+        case Types::ELEPHANT: bb &= m_bb_elephant; break;
+        case Types::ADVISOR:  bb &= m_bb_advisor;  break;
+        default: return attacks;
+    }
+
+    while (bb) {
+        const auto vtx = Utils::extract(bb);
+        switch (pt) {
+            case Types::PAWN:
+                attacks |= m_pawn_attacks[color][vtx];
+                break;
+            case Types::CANNON:
+                attacks |= m_cannonrank_magics[vtx].attack(occupancy) |
+                               m_cannonfile_magics[vtx].attack(occupancy);
+                break;
+            case Types::ROOK:
+                attacks |= m_rookrank_magics[vtx].attack(occupancy) |
+                               m_rookfile_magics[vtx].attack(occupancy);
+                break;
+            case Types::HORSE:
+                attacks |= m_horse_magics[vtx].attack(occupancy);
+                break;
+            case Types::ELEPHANT:
+                attacks |= m_elephant_magics[vtx].attack(occupancy) & side;
+                break;
+            default:
+                attacks |= m_advisor_attacks[vtx];
+                break;
+        }
+    }
+
+    if (pt == Types::CANNON) {
+        // The cannons can not eat pieces directly.
+        attacks &= m_bb_color[opp_color];
+    }
+    return attacks;
+}
+
+BitBoard Board::calc_checkers(Types::Color color) const {
+    const auto king_vtx = m_king_vertex[swap_color(color)];
+    if (king_vtx == Types::NO_VERTEX) {
+        return BitBoard(0ULL);
+    }
+
+    // The same reverse lookup as is_attacked(), but we collect all of
+    // the attackers.
+    const auto occupancy = m_bb_color[Types::RED] | m_bb_color[Types::BLACK];
+    const auto attackers = get_attackers(color);
+    const auto fileattack = m_rookfile_magics[king_vtx].attack(occupancy);
+    const auto rankattack = m_rookrank_magics[king_vtx].attack(occupancy);
+    const auto cannonattack = m_cannonfile_magics[king_vtx].attack(occupancy) |
+                                  m_cannonrank_magics[king_vtx].attack(occupancy);
+
+    return (m_pawn_attackers[color][king_vtx] & attackers.pawn) |
+               (m_horseattacker_magics[king_vtx].attack(occupancy) & attackers.horse) |
+               ((fileattack | rankattack) & attackers.rook) |
+               (fileattack & attackers.king) |
+               (cannonattack & attackers.cannon);
+}
+
+bool Board::calc_king_face() const {
+    const auto red_vtx = m_king_vertex[Types::RED];
+    const auto black_vtx = m_king_vertex[Types::BLACK];
+    if (red_vtx == Types::NO_VERTEX || black_vtx == Types::NO_VERTEX) {
+        return false;
+    }
+
+    // The first piece on the file is the opponent king.
+    const auto occupancy = m_bb_color[Types::RED] | m_bb_color[Types::BLACK];
+    return m_rookfile_magics[red_vtx].attack(occupancy) &
+               Utils::vertex2bitboard(black_vtx);
+}
+
+void Board::init_attacks() {
+    m_king_face = calc_king_face();
+    for (const auto color : {Types::RED, Types::BLACK}) {
+        m_bb_attacks[color] = BitBoard(0ULL);
+        for (auto pt = Types::PAWN; pt < Types::PIECE_T_NB; pt += 1) {
+            m_bb_piece_attacks[color][pt] = calc_piece_attacks(pt, color);
+            m_bb_attacks[color] |= m_bb_piece_attacks[color][pt];
+        }
+    }
+    for (const auto color : {Types::RED, Types::BLACK}) {
+        m_bb_checkers[color] = is_check(color) ? calc_checkers(color) : BitBoard(0ULL);
+    }
+}
+
+void Board::update_attacks(Move move, Types::Piece_t pt, Types::Piece_t capture_pt) {
+    const auto from = move.get_from();
+    const auto to = move.get_to();
+    const auto color = get_to_move();
+    const auto changed = move.get_from_bitboard() | move.get_to_bitboard();
+
+    // The occupancy only changes on the from and to vertices. The
+    // sliders on their ranks and files, the horses whose leg is one of
+    // them and the elephants whose eye is one of them may attack
+    // differently.
+    const auto lines = Utils::file2bitboard(static_cast<Types::File>(get_x(from))) |
+                           Utils::rank2bitboard(static_cast<Types::Rank>(get_y(from))) |
+                           Utils::file2bitboard(static_cast<Types::File>(get_x(to))) |
+                           Utils::rank2bitboard(static_cast<Types::Rank>(get_y(to)));
+    auto legs = BitBoard(0ULL);
+    auto eyes = BitBoard(0ULL);
+    for (int k = 0; k < 4; ++k) {
+        legs |= Utils::shift(m_dirs[k], changed);
+        eyes |= Utils::shift(m_dirs[k+4], changed);
+    }
+
+    m_king_face = calc_king_face();
+    for (const auto c : {Types::RED, Types::BLACK}) {
+        const auto own = m_bb_color[c];
+        auto &piece_attacks = m_bb_piece_attacks[c];
+
+        const auto lambda_update = [&](Types::Piece_t t, bool dirty) {
+            if (dirty || (c == color && t == pt) ||
+                    (c != color && t == capture_pt)) {
+                piece_attacks[t] = calc_piece_attacks(t, c);
+            }
+        };
+        lambda_update(Types::PAWN,     false);
+        lambda_update(Types::ADVISOR,  false);
+        lambda_update(Types::ELEPHANT, eyes & own & m_bb_elephant);
+        lambda_update(Types::HORSE,    legs & own & m_bb_horse);
+        lambda_update(Types::ROOK,     lines & own & m_bb_rook);
+        lambda_update(Types::CANNON,   lines & own & m_bb_cannon);
+        lambda_update(Types::KING,     true);
+
+        m_bb_attacks[c] = BitBoard(0ULL);
+        for (const auto &attacks : piece_attacks) {
+            m_bb_attacks[c] |= attacks;
+        }
+    }
+
+    for (const auto c : {Types::RED, Types::BLACK}) {
+        m_bb_checkers[c] = is_check(c) ? calc_checkers(c) : BitBoard(0ULL);
+    }
 }
 
 bool Board::is_on_board(const Types::Vertices vtx) {
@@ -938,7 +1187,7 @@ BitBoard &Board::get_piece_bitboard_ref(Types::Piece_t pt) {
 
 const auto lambda_separate_bitboarad = [](Types::Vertices vtx,
                                           BitBoard &legal_bitboard,
-                                          std::vector<Move> &movelist) -> void {
+                                          MoveList &movelist) -> void {
     while (legal_bitboard) {
         const auto res = Utils::extract(legal_bitboard);
         assert(res != Types::NO_VERTEX);
@@ -950,9 +1199,13 @@ const auto lambda_separate_bitboarad = [](Types::Vertices vtx,
 };
 
 template<>
-BitBoard Board::generate_move<Types::KING>(Types::Color color, std::vector<Move> &movelist) const {
+BitBoard Board::generate_move<Types::KING>(Types::Color color, MoveList &movelist) const {
 
     const auto vtx = m_king_vertex[color];
+    if (vtx == Types::NO_VERTEX) {
+        // The king has been captured.
+        return BitBoard(0ULL);
+    }
     const auto attack = m_king_attacks[vtx];
     const auto block = attack & m_bb_color[color];
     auto legal_bitboard = attack ^ block;
@@ -962,7 +1215,7 @@ BitBoard Board::generate_move<Types::KING>(Types::Color color, std::vector<Move>
 }
 
 template<>
-BitBoard Board::generate_move<Types::PAWN>(Types::Color color, std::vector<Move> &movelist) const {
+BitBoard Board::generate_move<Types::PAWN>(Types::Color color, MoveList &movelist) const {
     auto attacks = BitBoard(0ULL);
     auto bb_p = m_bb_pawn & m_bb_color[color];
     while (bb_p) {
@@ -977,7 +1230,7 @@ BitBoard Board::generate_move<Types::PAWN>(Types::Color color, std::vector<Move>
 }
 
 template<>
-BitBoard Board::generate_move<Types::ADVISOR>(Types::Color color, std::vector<Move> &movelist) const {
+BitBoard Board::generate_move<Types::ADVISOR>(Types::Color color, MoveList &movelist) const {
     auto attacks = BitBoard(0ULL);
     auto bb_a = m_bb_advisor & m_bb_color[color];
     while (bb_a) {
@@ -992,7 +1245,7 @@ BitBoard Board::generate_move<Types::ADVISOR>(Types::Color color, std::vector<Mo
 }
 
 template<>
-BitBoard Board::generate_move<Types::ELEPHANT>(Types::Color color, std::vector<Move> &movelist) const {
+BitBoard Board::generate_move<Types::ELEPHANT>(Types::Color color, MoveList &movelist) const {
     auto attacks = BitBoard(0ULL);
     auto bb_e = m_bb_elephant & m_bb_color[color];
     auto occupancy = m_bb_color[color] | m_bb_color[swap_color(color)];
@@ -1009,7 +1262,7 @@ BitBoard Board::generate_move<Types::ELEPHANT>(Types::Color color, std::vector<M
 }
 
 template<>
-BitBoard Board::generate_move<Types::HORSE>(Types::Color color, std::vector<Move> &movelist) const {
+BitBoard Board::generate_move<Types::HORSE>(Types::Color color, MoveList &movelist) const {
     auto attacks = BitBoard(0ULL);
     auto bb_h = m_bb_horse & m_bb_color[color];
     auto occupancy = m_bb_color[color] | m_bb_color[swap_color(color)];
@@ -1025,7 +1278,7 @@ BitBoard Board::generate_move<Types::HORSE>(Types::Color color, std::vector<Move
 }
 
 template<>
-BitBoard Board::generate_move<Types::ROOK>(Types::Color color, std::vector<Move> &movelist) const {
+BitBoard Board::generate_move<Types::ROOK>(Types::Color color, MoveList &movelist) const {
     auto attacks = BitBoard(0ULL);
     auto bb_r = m_bb_rook & m_bb_color[color];
     auto occupancy = m_bb_color[color] | m_bb_color[swap_color(color)];
@@ -1043,7 +1296,7 @@ BitBoard Board::generate_move<Types::ROOK>(Types::Color color, std::vector<Move>
 }
 
 template<>
-BitBoard Board::generate_move<Types::CANNON>(Types::Color color, std::vector<Move> &movelist) const {
+BitBoard Board::generate_move<Types::CANNON>(Types::Color color, MoveList &movelist) const {
     auto attacks = BitBoard(0ULL);
     auto opp_color = swap_color(color);
     auto bb_c = m_bb_cannon & m_bb_color[color];
@@ -1064,8 +1317,8 @@ BitBoard Board::generate_move<Types::CANNON>(Types::Color color, std::vector<Mov
 }
 
 
-// Generating the all legal moves to the list.
-BitBoard Board::generate_movelist(Types::Color color, std::vector<Move> &movelist) const {
+// Generating the all pseudo legal moves to the list.
+BitBoard Board::generate_movelist(Types::Color color, MoveList &movelist) const {
     auto attacks = BitBoard(0ULL);
 
     // We don't remove the moves which may make the king be
@@ -1089,6 +1342,279 @@ BitBoard Board::generate_movelist(Types::Color color, std::vector<Move> &movelis
     return attacks;
 }
 
+BitBoard Board::generate_movelist(Types::Color color, std::vector<Move> &movelist) const {
+    auto list = MoveList{};
+    const auto attacks = generate_movelist(color, list);
+    movelist.insert(std::end(movelist), std::begin(list), std::end(list));
+    return attacks;
+}
+
+void Board::generate_evasions(MoveList &movelist) const {
+    const auto color = get_to_move();
+    const auto opp_color = swap_color(color);
+    const auto king_vtx = m_king_vertex[color];
+    assert(is_check(opp_color));
+
+    // Every checker gives the vertices which a move must go to, or
+    // leave from, to stop its check. They are capturing it, blocking
+    // the line or the horse leg, and moving the cannon screen away.
+    struct Evasion {
+        BitBoard to;
+        BitBoard from;
+    };
+    auto evasions = std::array<Evasion, 16>{};
+    auto num_evasions = size_t{0};
+
+    const auto occupancy = m_bb_color[Types::RED] | m_bb_color[Types::BLACK];
+    const auto attackers = get_attackers(opp_color);
+    const auto checkers = m_bb_checkers[opp_color];
+
+    auto line_checkers = checkers & (attackers.rook | attackers.king);
+    auto cannon_checkers = checkers & attackers.cannon;
+    auto horse_checkers = checkers & attackers.horse;
+    auto pawn_checkers = checkers & attackers.pawn;
+
+    while (line_checkers) {
+        const auto vtx = Utils::extract(line_checkers);
+        evasions[num_evasions++] = {Utils::vertex2bitboard(vtx) | between_bitboard(king_vtx, vtx),
+                                    BitBoard(0ULL)};
+    }
+    while (cannon_checkers) {
+        const auto vtx = Utils::extract(cannon_checkers);
+        const auto between = between_bitboard(king_vtx, vtx);
+        evasions[num_evasions++] = {Utils::vertex2bitboard(vtx) | between,
+                                    between & occupancy};
+    }
+    while (horse_checkers) {
+        const auto vtx = Utils::extract(horse_checkers);
+        const auto dx = get_x(vtx) > get_x(king_vtx) ? 1 : -1;
+        const auto dy = get_y(vtx) > get_y(king_vtx) ? 1 : -1;
+        const auto leg = get_vertex(get_x(king_vtx) + dx, get_y(king_vtx) + dy);
+        evasions[num_evasions++] = {Utils::vertex2bitboard(vtx) | Utils::vertex2bitboard(leg),
+                                    BitBoard(0ULL)};
+    }
+    while (pawn_checkers) {
+        const auto vtx = Utils::extract(pawn_checkers);
+        evasions[num_evasions++] = {Utils::vertex2bitboard(vtx), BitBoard(0ULL)};
+    }
+
+    auto pseudo = MoveList{};
+    generate_movelist(color, pseudo);
+    for (const auto &move : pseudo) {
+        if (move.get_from() != king_vtx) {
+            const auto from_bb = move.get_from_bitboard();
+            const auto to_bb = move.get_to_bitboard();
+            auto success = true;
+            for (auto i = size_t{0}; i < num_evasions; ++i) {
+                if (!(evasions[i].to & to_bb) && !(evasions[i].from & from_bb)) {
+                    success = false;
+                    break;
+                }
+            }
+            if (!success) {
+                continue;
+            }
+        }
+        if (is_safe_move(move)) {
+            movelist.emplace_back(move);
+        }
+    }
+}
+
+void Board::generate_legal_moves(MoveList &movelist) const {
+    const auto color = get_to_move();
+    if (is_check(swap_color(color))) {
+        generate_evasions(movelist);
+        return;
+    }
+
+    auto pinned = BitBoard(0ULL);
+    auto screens = BitBoard(0ULL);
+    calc_king_blockers(color, pinned, screens);
+
+    // Out of check, only the king, the pinned pieces and the moves
+    // to the screen vertices may let the king be captured.
+    const auto king_vtx = m_king_vertex[color];
+    auto pseudo = MoveList{};
+    generate_movelist(color, pseudo);
+    for (const auto &move : pseudo) {
+        if (move.get_from() == king_vtx ||
+                (move.get_from_bitboard() & pinned) ||
+                (move.get_to_bitboard() & screens)) {
+            if (!is_safe_move(move)) {
+                continue;
+            }
+        }
+        movelist.emplace_back(move);
+    }
+}
+
+Board::Attackers Board::get_attackers(Types::Color color) const {
+    auto attackers = Attackers{};
+    attackers.pawn = m_bb_pawn & m_bb_color[color];
+    attackers.horse = m_bb_horse & m_bb_color[color];
+    attackers.rook = m_bb_rook & m_bb_color[color];
+    attackers.cannon = m_bb_cannon & m_bb_color[color];
+    attackers.king = BitBoard(0ULL);
+    if (m_king_vertex[color] != Types::NO_VERTEX) {
+        attackers.king = Utils::vertex2bitboard(m_king_vertex[color]);
+    }
+    return attackers;
+}
+
+bool Board::is_attacked(Types::Vertices vtx, Types::Color color,
+                        const Attackers &attackers, BitBoard occupancy) {
+    // The attacks are symmetric except the pawn and the horse. We look
+    // them up with the reverse tables. The advisors and elephants never
+    // leave their own side, they can not attack the king.
+    if (m_pawn_attackers[color][vtx] & attackers.pawn) {
+        return true;
+    }
+    if (m_horseattacker_magics[vtx].attack(occupancy) & attackers.horse) {
+        return true;
+    }
+
+    // The king can fly to the opponent king on the same file.
+    const auto fileattack = m_rookfile_magics[vtx].attack(occupancy);
+    const auto rankattack = m_rookrank_magics[vtx].attack(occupancy);
+    if (((fileattack | rankattack) & attackers.rook) || (fileattack & attackers.king)) {
+        return true;
+    }
+
+    const auto cannonattack = m_cannonfile_magics[vtx].attack(occupancy) |
+                                  m_cannonrank_magics[vtx].attack(occupancy);
+    return cannonattack & attackers.cannon;
+}
+
+bool Board::is_safe_move(Move move) const {
+    const auto color = get_to_move();
+    const auto opp_color = swap_color(color);
+    const auto from = move.get_from();
+    const auto to = move.get_to();
+    if (to == m_king_vertex[opp_color]) {
+        // Capture the king, the game is over.
+        return true;
+    }
+
+    const auto to_bb = move.get_to_bitboard();
+    const auto occupancy = ((m_bb_color[Types::RED] | m_bb_color[Types::BLACK]) ^
+                               move.get_from_bitboard()) | to_bb;
+
+    // The captured piece can not attack us.
+    auto attackers = get_attackers(opp_color);
+    attackers.pawn &= ~to_bb;
+    attackers.horse &= ~to_bb;
+    attackers.rook &= ~to_bb;
+    attackers.cannon &= ~to_bb;
+
+    const auto king_vtx = from == m_king_vertex[color] ? to : m_king_vertex[color];
+    return !is_attacked(king_vtx, opp_color, attackers, occupancy);
+}
+
+bool Board::gives_check(Move move) const {
+    const auto color = get_to_move();
+    const auto opp_color = swap_color(color);
+    const auto opp_king_vtx = m_king_vertex[opp_color];
+    if (opp_king_vtx == Types::NO_VERTEX || move.get_to() == opp_king_vtx) {
+        return false;
+    }
+
+    const auto from_bb = move.get_from_bitboard();
+    const auto to_bb = move.get_to_bitboard();
+    const auto occupancy = ((m_bb_color[Types::RED] | m_bb_color[Types::BLACK]) ^ from_bb) | to_bb;
+
+    // Move the piece in our attackers. The discovered checks are found
+    // because the occupancy is updated too.
+    auto attackers = get_attackers(color);
+    const auto pt = get_piece_type(move.get_from());
+    if (pt == Types::PAWN) {
+        attackers.pawn ^= (from_bb | to_bb);
+    } else if (pt == Types::HORSE) {
+        attackers.horse ^= (from_bb | to_bb);
+    } else if (pt == Types::ROOK) {
+        attackers.rook ^= (from_bb | to_bb);
+    } else if (pt == Types::CANNON) {
+        attackers.cannon ^= (from_bb | to_bb);
+    } else if (pt == Types::KING) {
+        attackers.king = to_bb;
+    }
+
+    return is_attacked(opp_king_vtx, color, attackers, occupancy);
+}
+
+void Board::calc_king_blockers(Types::Color color, BitBoard &pinned, BitBoard &screens) const {
+    const auto opp_color = swap_color(color);
+    const auto king_vtx = m_king_vertex[color];
+    const auto occupancy = m_bb_color[Types::RED] | m_bb_color[Types::BLACK];
+    const auto attackers = get_attackers(opp_color);
+
+    pinned = BitBoard(0ULL);
+    screens = BitBoard(0ULL);
+    if (king_vtx == Types::NO_VERTEX) {
+        return;
+    }
+
+    // One piece between the king and the rook (or the opponent king) is
+    // pinned. Two pieces between the king and the cannon are both pinned,
+    // if one of them leaves, the other one becomes the screen. If no piece
+    // is between the king and the cannon, every vertex between them is a
+    // screen.
+    const auto lines = Utils::file2bitboard(static_cast<Types::File>(get_x(king_vtx))) |
+                           Utils::rank2bitboard(static_cast<Types::Rank>(get_y(king_vtx)));
+
+    auto sliders = lines & (attackers.rook | attackers.king | attackers.cannon);
+    while (sliders) {
+        const auto vtx = Utils::extract(sliders);
+        const auto between = between_bitboard(king_vtx, vtx);
+        const auto blockers = between & occupancy;
+        const auto cnt = Utils::count_few(blockers);
+        if (attackers.cannon & Utils::vertex2bitboard(vtx)) {
+            if (cnt == 2) {
+                pinned |= blockers;
+            } else if (cnt == 0) {
+                screens |= between;
+            }
+        } else if (cnt == 1) {
+            pinned |= blockers;
+        }
+    }
+
+    // The piece on the horse leg is pinned if the horse attacks the
+    // king after it leaves.
+    const auto horse_attacks = m_horseattacker_magics[king_vtx].attack(occupancy) & attackers.horse;
+    for (int k = 4; k < 8; ++k) {
+        const auto leg = Utils::shift(Board::m_dirs[k], Utils::vertex2bitboard(king_vtx));
+        if (leg & occupancy) {
+            const auto attacks = m_horseattacker_magics[king_vtx].attack(occupancy ^ leg) & attackers.horse;
+            if (attacks != horse_attacks) {
+                pinned |= leg;
+            }
+        }
+    }
+}
+
+BitBoard Board::between_bitboard(Types::Vertices from, Types::Vertices to) {
+    auto between = BitBoard(0ULL);
+    const auto from_x = get_x(from);
+    const auto from_y = get_y(from);
+    const auto to_x = get_x(to);
+    const auto to_y = get_y(to);
+    if (from_x != to_x && from_y != to_y) {
+        return between;
+    }
+
+    const auto dx = (to_x > from_x) - (to_x < from_x);
+    const auto dy = (to_y > from_y) - (to_y < from_y);
+    auto x = from_x + dx;
+    auto y = from_y + dy;
+    while (x != to_x || y != to_y) {
+        between |= Utils::vertex2bitboard(get_vertex(x, y));
+        x += dx;
+        y += dy;
+    }
+    return between;
+}
+
 void Board::set_last_move(Move move) {
     m_lastmove = move;
 }
@@ -1161,8 +1687,8 @@ void Board::do_move_assume_legal(Move move) {
     // Update last move.
     set_last_move(move);
 
-    // Update attacks
-    m_bb_attacks = calc_attacks();
+    // Update attacks.
+    update_attacks(move, pt, capture_pt);
 
     // Update zobrist.
     update_zobrist(p , from, to);
@@ -1185,18 +1711,7 @@ void Board::do_move_assume_legal(Move move) {
 }
 
 bool Board::is_king_face_king() const {
-    const auto red_x = get_x(m_king_vertex[Types::RED]);
-    const auto black_x = get_x(m_king_vertex[Types::BLACK]);
-    if (red_x == black_x) {
-        const auto mask = m_bb_color[Types::RED] | m_bb_color[Types::BLACK];
-        const auto file = static_cast<Types::File>(red_x);
-        const auto file_bb = Utils::file2bitboard(file);
-        const auto cnt = Utils::count_few(file_bb & mask);
-        if (cnt == 2) {
-            return true;
-        }
-    }
-    return false;
+    return m_king_face;
 }
 
 bool Board::is_check(const Types::Color color) const {
@@ -1208,18 +1723,9 @@ bool Board::is_check(const Types::Color color) const {
 }
 
 bool Board::is_legal(Move move) const {
-    auto movelist = std::vector<Move>{};
+    auto movelist = MoveList{};
     generate_movelist(get_to_move(), movelist);
-    auto success = bool{false};
-    
-    for (const auto &m : movelist) {
-        if (move.get_data() == m.get_data()) {
-            success = true;
-            break;
-        }
-    }
-
-    return success;
+    return movelist.contains(move);
 }
 
 Move Board::text2move(std::string text) {
@@ -21,7 +21,9 @@
 
 #include "Uint128_t.h"
 #include "BitBoard.h"
+#include "MoveList.h"
 #include "Zobrist.h"
+#include "StaticArray.h"
 #include "Utils.h"
 
 #include <cassert>
@@ -68,8 +70,16 @@ public:
     int get_rule50_ply() const;
     int get_rule50_ply_left() const;
 
+    // Generating the pseudo legal moves. The moves which let the own
+    // king be captured are included.
+    BitBoard generate_movelist(Types::Color color, MoveList &movelist) const;
     BitBoard generate_movelist(Types::Color color, std::vector<Move> &movelist) const;
 
+    // The staged generators, both of them are for the side to move. The
+    // evasions and the legal moves never let the own king be captured.
+    void generate_evasions(MoveList &movelist) const;
+    void generate_legal_moves(MoveList &movelist) const;
+
     static bool is_on_board(const Types::Vertices vtx);
 
     void fen_stream(std::ostream &out) const;
@@ -103,6 +113,16 @@ public:
     bool is_capture() const;
     bool is_check(const Types::Color color) const;
 
+    // Two kings are on the same file, and nothing is between them.
+    bool is_king_face_king() const;
+
+    // Test the pseudo legal move of the side to move on the bitboards,
+    // without playing it. is_safe_move() is true if the own king can not
+    // be captured after the move. gives_check() is true if we attack the
+    // opponent king after the move.
+    bool is_safe_move(Move move) const;
+    bool gives_check(Move move) const;
+
 private:
     #define P_  Types::R_PAWN
     #define H_  Types::R_HORSE
@@ -156,11 +176,16 @@ private:
     #undef ET
     #undef invalid_
 
+    // With USE_PEXT, the occupancy under the mask is gathered into the
+    // index by the pext instruction. Otherwise the two halves are hashed
+    // by the magic numbers.
     struct Magic {
         BitBoard  mask;
         std::uint64_t  upper_magic;
         std::uint64_t  lower_magic;
-        std::vector<BitBoard> attacks;
+
+        // The slice of m_attacks_table owned by this magic.
+        BitBoard *attacks;
 
         std::uint64_t limit;
         int shift;
@@ -168,23 +193,36 @@ private:
         bool valid;
 
         inline std::uint64_t index(BitBoard occupied) const {
+#ifdef USE_PEXT
+            return Utils::pext(occupied, mask);
+#else
             auto mark = occupied & mask;
             return (mark.get_upper() * upper_magic +
                         mark.get_lower() * lower_magic) >> shift;
+#endif
         }
 
         inline BitBoard attack(BitBoard occupied) const {
             const auto idx = index(occupied);
-            assert(idx <= limit && valid);
+            assert(idx < limit && valid);
             return attacks[idx];
         }
     };
 
-    static std::array<std::array<BitBoard, NUM_VERTICES>, 2> m_pawn_attacks;
-    static std::array<BitBoard, NUM_VERTICES> m_advisor_attacks;
-    static std::array<BitBoard, NUM_VERTICES> m_king_attacks;
+    // The attacks of all the magics in one block. Every slice starts on
+    // a cache line.
+    static std::vector<BitBoard> m_attacks_table;
+
+    // The leaper tables are generated at compile time.
+    using AttackTable = StaticArray<BitBoard, NUM_VERTICES>;
+
+    static const StaticArray<AttackTable, 2> m_pawn_attacks;
+    static const StaticArray<AttackTable, 2> m_pawn_attackers;
+    static const AttackTable m_advisor_attacks;
+    static const AttackTable m_king_attacks;
 
     static std::array<Magic, NUM_VERTICES> m_horse_magics;
+    static std::array<Magic, NUM_VERTICES> m_horseattacker_magics;
     static std::array<Magic, NUM_VERTICES> m_elephant_magics;
     static std::array<Magic, NUM_VERTICES> m_rookrank_magics;
     static std::array<Magic, NUM_VERTICES> m_rookfile_magics;
@@ -192,7 +230,6 @@ private:
     static std::array<Magic, NUM_VERTICES> m_cannonrank_magics;
     static std::array<Magic, NUM_VERTICES> m_cannonfile_magics;
 
-    static void init_pawn_attacks();
     static void init_move_pattens();
     static void init_magics();
     static void dump_memory();
@@ -206,7 +243,13 @@ private:
     BitBoard &get_piece_bitboard_ref(Types::Piece_t pt);
 
     std::array<BitBoard, 2> m_bb_color;
+
+    // The attacks of every piece type, and the union of them. Only the
+    // types whose attacks may change are computed again after a move.
+    std::array<std::array<BitBoard, Types::PIECE_T_NB>, 2> m_bb_piece_attacks;
     std::array<BitBoard, 2> m_bb_attacks;
+    std::array<BitBoard, 2> m_bb_checkers;
+    bool m_king_face;
 
     BitBoard m_bb_pawn;
     BitBoard m_bb_horse;
@@ -219,8 +262,6 @@ private:
 
     Types::Color m_tomove;
 
-    bool is_king_face_king() const;
-
     int m_movenum;
     int m_gameply;
     bool m_capture;
@@ -232,8 +273,26 @@ private:
 
     std::uint64_t m_hash;
 
+    // The pieces which may attack one vertex.
+    struct Attackers {
+        BitBoard pawn;
+        BitBoard horse;
+        BitBoard rook;
+        BitBoard cannon;
+        BitBoard king;
+    };
+
+    Attackers get_attackers(Types::Color color) const;
+    static bool is_attacked(Types::Vertices vtx, Types::Color color,
+                            const Attackers &attackers, BitBoard occupancy);
+
+    // The pieces whose leaving exposes the own king, and the empty
+    // vertices which become a cannon screen if we move a piece there.
+    void calc_king_blockers(Types::Color color, BitBoard &pinned, BitBoard &screens) const;
+    static BitBoard between_bitboard(Types::Vertices from, Types::Vertices to);
+
     void clear_status();
-    template<Types::Piece_t> BitBoard generate_move(Types::Color color, std::vector<Move> &movelist) const;
+    template<Types::Piece_t> BitBoard generate_move(Types::Color color, MoveList &movelist) const;
     template<Types::Language> void piece_stream(std::ostream &out, const int x, const int y) const;
     template<Types::Language> void info_stream(std::ostream &out) const;
 
@@ -241,7 +300,12 @@ private:
     void update_zobrist_remove(Types::Piece p, Types::Vertices vtx);
     void update_zobrist_tomove(Types::Color old_color, Types::Color new_color);
 
-    std::array<BitBoard, 2> calc_attacks();
+    BitBoard calc_piece_attacks(Types::Piece_t pt, Types::Color color) const;
+    BitBoard calc_checkers(Types::Color color) const;
+    bool calc_king_face() const;
+
+    void init_attacks();
+    void update_attacks(Move move, Types::Piece_t pt, Types::Piece_t capture_pt);
 };
 
 inline Types::Vertices Board::get_vertex(const int x, const int y) {
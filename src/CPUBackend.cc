@@ -20,16 +20,21 @@
 #include "Board.h"
 #include "Utils.h"
 #include "Model.h"
+#include "WinogradHelper.h"
+
+#include <algorithm>
+#include <iterator>
+#include <chrono>
 
 void CPUBackend::initialize(std::shared_ptr<Model::NNWeights> weights) {
     reload(weights);
+    prepare_worker();
 }
 
 void CPUBackend::reload(std::shared_ptr<Model::NNWeights> weights) {
-    if (m_weights != nullptr) {
-        m_weights.reset();
-    }
-    m_weights = weights;
+    // The evaluators may be computing a batch. Every batch holds its own
+    // copy of the weights, so the old weights are freed after the batch.
+    std::atomic_store(&m_weights, weights);
 }
 
 void CPUBackend::forward(const std::vector<float> &planes,
@@ -37,145 +42,448 @@ void CPUBackend::forward(const std::vector<float> &planes,
                          std::vector<float> &output_pol,
                          std::vector<float> &output_val) {
 
+    if (m_threads.empty()) {
+        // There is no evaluator, compute the network on the search thread.
+        batch_forward(1, planes, features, output_pol, output_val);
+        return;
+    }
+
+    auto entry = std::make_shared<ForwardEntry>(planes,
+                                                 features,
+                                                 output_pol,
+                                                 output_val);
+    {
+        std::unique_lock<std::mutex> queue_lock(m_queue_mutex);
+        m_forward_queue.emplace_back(entry);
+        if (m_forward_queue.size() >= (size_t)option<int>("batchsize")) {
+            m_cv.notify_one();
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(entry->mutex);
+    entry->cv.wait(lock, [entry](){ return entry->done; });
+}
+
+void CPUBackend::ForwardContext::resize(const Model::NNWeights &weights, const int batch_size) {
     using Convolve3 = Convolve<3>;
 
-    const auto output_channels = m_weights->residual_channels;
-    auto max_channels = std::max({INPUT_CHANNELS,
-                                  output_channels,
-                                  m_weights->policy_extract_channels,
-                                  m_weights->policy_map});
-    
-    auto workspace_size = Convolve3::get_workspace_size(max_channels);
-    auto workspace = std::vector<float>(workspace_size);
+    const auto lambda_grow = [](auto &buffer, const size_t size) {
+        if (buffer.size() < size) {
+            buffer.resize(size);
+        }
+    };
+
+    const auto output_channels = weights.residual_channels;
+    const auto max_channels = std::max({INPUT_CHANNELS,
+                                        output_channels,
+                                        weights.policy_extract_channels,
+                                        weights.policy_map});
+    auto se_size = 0;
+    for (const auto &residual : weights.residual_tower) {
+        se_size = std::max(se_size, residual.se_size);
+    }
+
+    auto workspace_size = Convolve3::get_workspace_size(batch_size, max_channels, max_channels);
+    if (weights.winograd) {
+        workspace_size = std::max(workspace_size,
+                                  Winograd::get_workspace_size(batch_size, max_channels, max_channels));
+    }
+    lambda_grow(workspace, workspace_size);
+
+    // The int8 mode uses its own workspace, the accumulators are
+    // 32 bits integers.
+    if (weights.int8) {
+        lambda_grow(int8_workspace, Convolve3::get_int8_workspace_size(batch_size, max_channels, max_channels));
+    }
+
+    const auto tower_size = batch_size * output_channels * Board::INTERSECTIONS;
+    lambda_grow(conv_in, tower_size);
+    lambda_grow(conv_out, tower_size);
+    lambda_grow(res, tower_size);
+
+    lambda_grow(pool_fc1, batch_size * 2 * output_channels);
+    lambda_grow(pool_fc2, batch_size * output_channels);
+    lambda_grow(se_pool, batch_size * output_channels);
+    lambda_grow(se_fc, batch_size * se_size);
+    lambda_grow(se_scale, batch_size * 2 * output_channels);
+
+    lambda_grow(policy_conv, batch_size * weights.policy_extract_channels * Board::INTERSECTIONS);
+    lambda_grow(value_conv, batch_size * weights.value_extract_channels * Board::INTERSECTIONS);
+    lambda_grow(value_fc, batch_size * VALUELAYER);
+
+    lambda_grow(batch_planes, batch_size * INPUT_CHANNELS * Board::INTERSECTIONS);
+    lambda_grow(batch_features, batch_size * INPUT_FEATURES);
+    lambda_grow(batch_pol, batch_size * POLICYMAP * Board::INTERSECTIONS);
+    lambda_grow(batch_val, batch_size * WINRATELAYER);
+}
+
+void CPUBackend::batch_forward(const int batch_size,
+                               const std::vector<float> &planes,
+                               const std::vector<float> &features,
+                               std::vector<float> &output_pol,
+                               std::vector<float> &output_val) {
+    const auto weights = std::atomic_load(&m_weights);
+    if (weights == nullptr) {
+        // The weights are released, output the empty result.
+        std::fill(std::begin(output_pol), std::end(output_pol), 0.0f);
+        std::fill(std::begin(output_val), std::end(output_val), 0.0f);
+        return;
+    }
+    thread_local auto context = ForwardContext{};
+    context.resize(*weights, batch_size);
+    batch_forward(context, *weights, batch_size, planes, features, output_pol, output_val);
+}
+
+void CPUBackend::forward_batch(const int batch_size,
+                               const std::vector<float> &planes,
+                               const std::vector<float> &features,
+                               std::vector<float> &output_pol,
+                               std::vector<float> &output_val) {
+    batch_forward(batch_size, planes, features, output_pol, output_val);
+}
+
+void CPUBackend::batch_forward(ForwardContext &context,
+                               const Model::NNWeights &weights,
+                               const int batch_size,
+                               const std::vector<float> &planes,
+                               const std::vector<float> &features,
+                               std::vector<float> &output_pol,
+                               std::vector<float> &output_val) {
+
+    using Convolve3 = Convolve<3>;
+
+    const auto output_channels = weights.residual_channels;
+    const auto use_int8 = weights.int8;
+    const auto use_winograd = weights.winograd;
+
+    auto &workspace = context.workspace;
+    auto &int8_workspace = context.int8_workspace;
 
-    auto conv_out = std::vector<float>(output_channels * Board::INTERSECTIONS);
-    auto conv_in = std::vector<float>(output_channels * Board::INTERSECTIONS);
-    auto res = std::vector<float>(output_channels * Board::INTERSECTIONS);
+    // The batchnorm layers are folded into the convolutions, so every
+    // convolution ends with its biases, the residual and the ReLU.
+    const auto convolve3 = [&](const size_t input_channels,
+                               const size_t output_channels,
+                               const std::vector<float> &input,
+                               const Desc::ConvLayer &layer,
+                               std::vector<float> &output,
+                               const float *const eltwise,
+                               const bool ReLU) {
+        if (use_int8 && !layer.int8_weights.weights.empty()) {
+            Convolve3::Forward(batch_size, input_channels, output_channels,
+                               input, layer.int8_weights, layer.biases,
+                               int8_workspace, output, eltwise, ReLU);
+        } else if (use_winograd) {
+            Winograd::Forward(batch_size, input_channels, output_channels,
+                              input, layer.weights, layer.biases,
+                              workspace, output, eltwise, ReLU);
+        } else {
+            Convolve3::Forward(batch_size, input_channels, output_channels,
+                               input, layer.weights, layer.biases,
+                               workspace, output, eltwise, ReLU);
+        }
+    };
+
+    auto &conv_out = context.conv_out;
+    auto &conv_in = context.conv_in;
+    auto &res = context.res;
     
     // input
-    Convolve3::Forward(INPUT_CHANNELS, output_channels,
-                       planes,
-                       m_weights->input_conv.weights,
-                       workspace, conv_out);
+    convolve3(INPUT_CHANNELS, output_channels,
+              planes,
+              weights.input_conv,
+              conv_out,
+              nullptr, false);
 
-    Batchnorm::Forward(output_channels, conv_out,
-                       m_weights->input_bn.means,
-                       m_weights->input_bn.stddevs,
-                       nullptr, false);
-
-    InputPool::Forward(INPUT_FEATURES, 2 * output_channels, output_channels,
+    InputPool::Forward(batch_size, INPUT_FEATURES, 2 * output_channels, output_channels,
                        features,
-                       m_weights->input_fc1.weights,
-                       m_weights->input_fc1.biases,
-                       m_weights->input_fc2.weights,
-                       m_weights->input_fc2.biases,
-                       conv_out);
+                       weights.input_fc1.weights,
+                       weights.input_fc1.biases,
+                       weights.input_fc2.weights,
+                       weights.input_fc2.biases,
+                       conv_out,
+                       context.pool_fc1,
+                       context.pool_fc2);
 
     // residual tower
-    const auto residuals =  m_weights->residual_blocks;
+    const auto residuals =  weights.residual_blocks;
     for (int i = 0; i < residuals; ++i) {
-        const auto tower_channels = m_weights->residual_channels;
-        const auto tower_ptr = m_weights->residual_tower.data() + i;
+        const auto tower_channels = weights.residual_channels;
+        const auto tower_ptr = weights.residual_tower.data() + i;
 
         std::swap(conv_in, conv_out);
         
-        Convolve3::Forward(tower_channels, tower_channels,
-                           conv_in,
-                           tower_ptr->conv_1.weights,
-                           workspace, conv_out);
-
-        Batchnorm::Forward(tower_channels, conv_out,
-                           tower_ptr->bn_1.means,
-                           tower_ptr->bn_1.stddevs);
+        convolve3(tower_channels, tower_channels,
+                  conv_in,
+                  tower_ptr->conv_1,
+                  conv_out,
+                  nullptr, true);
 
         std::swap(conv_in, res);
         std::swap(conv_out, conv_in);
-        Convolve3::Forward(tower_channels, tower_channels,
-                           conv_in,
-                           tower_ptr->conv_2.weights,
-                           workspace, conv_out);
 
         if (tower_ptr->apply_se) {
-            Batchnorm::Forward(tower_channels, conv_out,
-                               tower_ptr->bn_2.means,
-                               tower_ptr->bn_2.stddevs,
-                               nullptr, false);
+            convolve3(tower_channels, tower_channels,
+                      conv_in,
+                      tower_ptr->conv_2,
+                      conv_out,
+                      nullptr, false);
        
             const size_t se_size = tower_ptr->se_size;
-            SEUnit::Forward(tower_channels, se_size,
-                            conv_out, res,
-                            tower_ptr->extend.weights,
-                            tower_ptr->extend.biases,
-                            tower_ptr->squeeze.weights,
-                            tower_ptr->squeeze.biases);
+            if (use_int8) {
+                SEUnit::Forward(batch_size, tower_channels, se_size,
+                                conv_out, res,
+                                tower_ptr->extend.int8_weights,
+                                tower_ptr->extend.biases,
+                                tower_ptr->squeeze.int8_weights,
+                                tower_ptr->squeeze.biases,
+                                context.se_pool,
+                                context.se_fc,
+                                context.se_scale);
+            } else {
+                SEUnit::Forward(batch_size, tower_channels, se_size,
+                                conv_out, res,
+                                tower_ptr->extend.weights,
+                                tower_ptr->extend.biases,
+                                tower_ptr->squeeze.weights,
+                                tower_ptr->squeeze.biases,
+                                context.se_pool,
+                                context.se_fc,
+                                context.se_scale);
+            }
         
         } else {
-             Batchnorm::Forward(tower_channels, conv_out,
-                                tower_ptr->bn_2.means,
-                                tower_ptr->bn_2.stddevs,
-                                res.data());
+            convolve3(tower_channels, tower_channels,
+                      conv_in,
+                      tower_ptr->conv_2,
+                      conv_out,
+                      res.data(), true);
         }
     }
     
     // policy head
-    const auto policy_extract_channels = m_weights->policy_extract_channels;
-    auto policy_conv = std::vector<float>(policy_extract_channels * Board::INTERSECTIONS);
+    const auto policy_extract_channels = weights.policy_extract_channels;
+    auto &policy_conv = context.policy_conv;
 
-    Convolve3::Forward(output_channels, policy_extract_channels,
-                       conv_out,
-                       m_weights->p_ex_conv.weights,
-                       workspace, policy_conv);
-    
-    Batchnorm::Forward(policy_extract_channels, policy_conv,
-                       m_weights->p_ex_bn.means,
-                       m_weights->p_ex_bn.stddevs);
+    convolve3(output_channels, policy_extract_channels,
+              conv_out,
+              weights.p_ex_conv,
+              policy_conv,
+              nullptr, true);
     
-    Convolve3::Forward(policy_extract_channels, POLICYMAP,
-                       policy_conv,
-                       m_weights->p_map.weights,
-                       workspace, output_pol);
-    
-    AddSpatialBias::Forward(POLICYMAP, output_pol, m_weights->p_map.biases);
+    convolve3(policy_extract_channels, POLICYMAP,
+              policy_conv,
+              weights.p_map,
+              output_pol,
+              nullptr, false);
     
     // value head
-    const auto value_extract_channels = m_weights->value_extract_channels;
-    auto value_conv = std::vector<float>(value_extract_channels * Board::INTERSECTIONS);
-    auto value_fc = std::vector<float>(VALUELAYER);
+    const auto value_extract_channels = weights.value_extract_channels;
+    auto &value_conv = context.value_conv;
+    auto &value_fc = context.value_fc;
     
-    Convolve1::Forward(output_channels, value_extract_channels,
+    Convolve1::Forward(batch_size, output_channels, value_extract_channels,
                        conv_out,
-                       m_weights->v_ex_conv.weights,
+                       weights.v_ex_conv.weights,
+                       weights.v_ex_conv.biases,
                        value_conv);
     
-    Batchnorm::Forward(value_extract_channels, value_conv,
-                       m_weights->v_ex_bn.means,
-                       m_weights->v_ex_bn.stddevs);
-    
-    FullyConnect::Forward(value_extract_channels * Board::INTERSECTIONS, VALUELAYER,
-                          value_conv,
-                          m_weights->v_fc1.weights,
-                          m_weights->v_fc1.biases,
-                          value_fc, true);
+    if (use_int8) {
+        FullyConnect::Forward(batch_size, value_extract_channels * Board::INTERSECTIONS, VALUELAYER,
+                              value_conv,
+                              weights.v_fc1.int8_weights,
+                              weights.v_fc1.biases,
+                              value_fc, true);
+    } else {
+        FullyConnect::Forward(batch_size, value_extract_channels * Board::INTERSECTIONS, VALUELAYER,
+                              value_conv,
+                              weights.v_fc1.weights,
+                              weights.v_fc1.biases,
+                              value_fc, true);
+    }
     
-    FullyConnect::Forward(VALUELAYER, WINRATELAYER,
+    FullyConnect::Forward(batch_size, VALUELAYER, WINRATELAYER,
                           value_fc,
-                          m_weights->v_fc2.weights,
-                          m_weights->v_fc2.biases,
+                          weights.v_fc2.weights,
+                          weights.v_fc2.biases,
                           output_val, false);
 
 }
 
 void CPUBackend::destroy() {
-    // Do nothing.
+    // Stop the evaluators before the weights are gone.
+    quit_worker();
+    release();
 }
 
 void CPUBackend::release() {
-    if (m_weights != nullptr) {
-        m_weights.reset();
-    }
-    m_weights = nullptr;
+    std::atomic_store(&m_weights, std::shared_ptr<Model::NNWeights>{nullptr});
 }
 
 bool CPUBackend::valid() {
-    return m_weights->loaded;
+    const auto weights = std::atomic_load(&m_weights);
+    return weights != nullptr && weights->loaded;
+}
+
+void CPUBackend::worker() {
+    const auto gather_batches = [this](){
+        const size_t maxbatch = (size_t)option<int>("batchsize");
+        const auto max_waittime = option<int>("gpu_waittime");
+        std::list<std::shared_ptr<ForwardEntry>> inputs;
+
+        std::unique_lock<std::mutex> queue_lock(m_queue_mutex);
+        while(true) {
+            if (!m_thread_running) {
+                return inputs;
+            }
+
+            int waittime = m_waittime.load();
+            if (m_forward_queue.size() >= maxbatch) {
+                if (waittime > max_waittime) {
+                    m_waittime.store(max_waittime);
+                } else if (waittime > 1) {
+                    waittime--;
+                    m_waittime.store(waittime);
+                }
+                break;
+            }
+
+            bool timeout = !m_cv.wait_for(queue_lock, std::chrono::milliseconds(waittime),
+                                              [maxbatch, this](){ return !m_thread_running ||
+                                                                         !(m_forward_queue.size() < maxbatch); }
+                                          );
+            if (!m_forward_queue.empty()) {
+                // Only one evaluator may take the partial batch at a time.
+                if (timeout && m_narrow_pipe.exchange(true) == false) {
+                    if (waittime > 1) {
+                        waittime--;
+                        m_waittime.store(waittime);
+                    }
+                    break;
+                }
+            } else {
+                if (waittime < 20 * max_waittime) {
+                   waittime += 2;
+                }
+                m_waittime.store(waittime);
+            }
+        }
+
+        auto count = m_forward_queue.size();
+        if (count > maxbatch) {
+            count = maxbatch;
+        }
+
+        auto end = std::begin(m_forward_queue);
+        std::advance(end, count);
+        std::move(std::begin(m_forward_queue), end, std::back_inserter(inputs));
+        m_forward_queue.erase(std::begin(m_forward_queue), end);
+
+        return inputs;
+    };
+
+    auto context = ForwardContext{};
+    if (const auto weights = std::atomic_load(&m_weights)) {
+        context.resize(*weights, option<int>("batchsize"));
+    }
+
+    while (true) {
+        if (!m_thread_running) return;
+
+        auto gather_entry = gather_batches();
+        const auto batch_size = gather_entry.size();
+
+        if (batch_size == 0) {
+            continue;
+        }
+
+        const auto first = *std::begin(gather_entry);
+
+        const auto in_p_size = first->in_p.size();
+        const auto in_f_size = first->in_f.size();
+        const auto out_pol_size = first->out_pol.size();
+        const auto out_val_size = first->out_val.size();
+
+        auto &batch_input_planes = context.batch_planes;
+        auto &batch_input_features = context.batch_features;
+        auto &batch_out_pol = context.batch_pol;
+        auto &batch_out_val = context.batch_val;
+
+        // Hold the weights until the batch is done. The reload() may
+        // replace them at any time.
+        const auto weights = std::atomic_load(&m_weights);
+        if (weights != nullptr) {
+            context.resize(*weights, batch_size);
+
+            auto index = size_t{0};
+            for (auto &x : gather_entry) {
+                std::copy(std::begin(x->in_p),
+                          std::end(x->in_p),
+                          std::begin(batch_input_planes) + index * in_p_size);
+                std::copy(std::begin(x->in_f),
+                          std::end(x->in_f),
+                          std::begin(batch_input_features) + index * in_f_size);
+                index++;
+            }
+
+            batch_forward(context,
+                          *weights,
+                          batch_size,
+                          batch_input_planes,
+                          batch_input_features,
+                          batch_out_pol,
+                          batch_out_val);
+        } else {
+            // The weights are released, output the empty result.
+            batch_out_pol.assign(batch_size * out_pol_size, 0.0f);
+            batch_out_val.assign(batch_size * out_val_size, 0.0f);
+        }
+
+        auto index = size_t{0};
+        for (auto &x : gather_entry) {
+            std::copy(std::begin(batch_out_pol) + index * out_pol_size,
+                      std::begin(batch_out_pol) + (index+1) * out_pol_size,
+                      std::begin(x->out_pol));
+            std::copy(std::begin(batch_out_val) + index * out_val_size,
+                      std::begin(batch_out_val) + (index+1) * out_val_size,
+                      std::begin(x->out_val));
+            {
+                std::lock_guard<std::mutex> lock(x->mutex);
+                x->done = true;
+            }
+            x->cv.notify_one();
+            index++;
+        }
+
+        m_narrow_pipe.store(false);
+    }
+}
+
+void CPUBackend::prepare_worker() {
+    const auto batchsize = option<int>("batchsize");
+    if (batchsize <= 1) {
+        return;
+    }
+
+    // One evaluator serves a full batch of search threads.
+    const auto threads = option<int>("threads") * option<int>("num_games");
+    const auto evaluators = std::max(1, threads / batchsize + (threads % batchsize != 0));
+
+    m_thread_running = true;
+    if (m_threads.size() == 0) {
+        for (int i = 0; i < evaluators; ++i) {
+            m_threads.emplace_back([this](){ worker(); });
+        }
+    }
+}
+
+void CPUBackend::quit_worker() {
+    {
+        std::unique_lock<std::mutex> queue_lock(m_queue_mutex);
+        m_thread_running = false;
+    }
+    m_cv.notify_all();
+    for (auto &t : m_threads) {
+        t.join();
+    }
+    m_threads.clear();
 }
@@ -22,6 +22,15 @@
 #include "config.h"
 #include "Blas.h"
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <list>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
 class CPUBackend : public Model::NNPipe {
 public:
     virtual void initialize(std::shared_ptr<Model::NNWeights> weights);
@@ -30,14 +39,97 @@ public:
                          std::vector<float> &output_pol,
                          std::vector<float> &output_val);
 
+    // The batch is computed on the calling thread, not by the evaluators.
+    virtual void forward_batch(const int batch_size,
+                               const std::vector<float> &planes,
+                               const std::vector<float> &features,
+                               std::vector<float> &output_pol,
+                               std::vector<float> &output_val);
+
     virtual void reload(std::shared_ptr<Model::NNWeights> weights);
     virtual void release();
     virtual void destroy();
     virtual bool valid();
 
+    // Compute the network on the current thread.
+    void batch_forward(const int batch_size,
+                       const std::vector<float> &planes,
+                       const std::vector<float> &features,
+                       std::vector<float> &output_pol,
+                       std::vector<float> &output_val);
+
 private:
+    // All scratch buffers of one inference thread. They only grow, so
+    // after the first full batch the forward pass does not allocate.
+    struct ForwardContext {
+        std::vector<float> workspace;
+        std::vector<std::int32_t> int8_workspace;
+
+        std::vector<float> conv_in;
+        std::vector<float> conv_out;
+        std::vector<float> res;
+
+        std::vector<float> pool_fc1;
+        std::vector<float> pool_fc2;
+        std::vector<float> se_pool;
+        std::vector<float> se_fc;
+        std::vector<float> se_scale;
+
+        std::vector<float> policy_conv;
+        std::vector<float> value_conv;
+        std::vector<float> value_fc;
+
+        // The gathered inputs and outputs of the evaluator.
+        std::vector<float> batch_planes;
+        std::vector<float> batch_features;
+        std::vector<float> batch_pol;
+        std::vector<float> batch_val;
+
+        void resize(const Model::NNWeights &weights, const int batch_size);
+    };
+
+    void batch_forward(ForwardContext &context,
+                       const Model::NNWeights &weights,
+                       const int batch_size,
+                       const std::vector<float> &planes,
+                       const std::vector<float> &features,
+                       std::vector<float> &output_pol,
+                       std::vector<float> &output_val);
+
+    struct ForwardEntry {
+        const std::vector<float> &in_p;
+        const std::vector<float> &in_f;
+        std::vector<float> &out_pol;
+        std::vector<float> &out_val;
+
+        std::condition_variable cv;
+        std::mutex mutex;
+        bool done{false};
+
+        ForwardEntry(const std::vector<float> &planes,
+                      const std::vector<float> &features,
+                      std::vector<float> &output_pol,
+                      std::vector<float> &output_val) :
+                      in_p(planes), in_f(features), out_pol(output_pol), out_val(output_val) {}
+    };
+
+    std::list<std::shared_ptr<ForwardEntry>> m_forward_queue;
+
+    // Only accessed with std::atomic_load() and std::atomic_store(). Every
+    // batch takes its own copy, so reload() and release() never free the
+    // weights under a running batch.
     std::shared_ptr<Model::NNWeights> m_weights{nullptr};
+    std::mutex m_queue_mutex;
+    std::condition_variable m_cv;
+    std::atomic<int> m_waittime{0};
+    std::atomic<bool> m_narrow_pipe{false};
+    std::atomic<bool> m_thread_running{false};
+
+    std::vector<std::thread> m_threads;
 
+    void prepare_worker();
+    void worker();
+    void quit_worker();
 };
 
 #endif
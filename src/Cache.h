@@ -20,19 +20,27 @@
 #define CACHE_H_INCLUDE
 
 #include <array>
-#include <deque>
 #include <memory>
-#include <unordered_map>
 #include <atomic>
 #include <cassert>
+#include <cstring>
+#include <type_traits>
 
 #include "Utils.h"
-#include "SharedMutex.h"
 
+/*
+ * A fixed-size, open-addressed table. It is split into shards and every
+ * bucket is protected by its own sequence lock, so lookup never blocks and
+ * insert only touches one bucket. When the probe window is full, it uses a
+ * clock (second chance) policy to choose the replaced bucket.
+ *
+ * The resize() and clear() are not thread-safe. Only call them while nobody
+ * is searching.
+ */
 template <typename EntryType>
 class Cache {
 public:
-    Cache() : m_hits(0), m_lookups(0), m_inserts(0) {}
+    Cache() : m_size(0), m_hits(0), m_lookups(0), m_inserts(0), m_entries(0) {}
 
     bool lookup(std::uint64_t hash, EntryType &result);
     void insert(std::uint64_t hash, const EntryType &result);
@@ -46,115 +54,188 @@ public:
     void clear_stats();
 
 private:
+    static_assert(std::is_trivially_copyable<EntryType>::value,
+                      "The cache entry must be trivially copyable.");
+
     static constexpr size_t MAX_CACHE_COUNT = 150000;
 
     static constexpr size_t MIN_CACHE_COUNT = 6000;
 
-    static constexpr size_t ENTRY_SIZE = sizeof(EntryType) +
-                                             sizeof(std::uint64_t) +
-                                             sizeof(std::unique_ptr<EntryType>);
+    static constexpr size_t NUM_SHARDS = 16;
 
-    SharedMutex m_sm;
-    size_t m_size;
+    static constexpr size_t PROBE_LENGTH = 4;
 
-    int m_hits;
-    int m_lookups;
-    int m_inserts;
-
-    struct Entry {
-        Entry(const EntryType &r) : result(r) {}
+    struct Bucket {
+        // Odd version means a writer is filling the bucket. Zero means
+        // the bucket is never used.
+        std::atomic<std::uint32_t> version{0};
+        std::atomic<bool> referenced{false};
+        std::uint64_t hash{0};
         EntryType result;
     };
 
-    std::unordered_map<std::uint64_t, std::unique_ptr<const Entry>> m_cache;
-    std::deque<std::uint64_t> m_order;
+    struct Shard {
+        std::unique_ptr<Bucket[]> buckets{nullptr};
+        size_t size{0};
+    };
+
+    static constexpr size_t ENTRY_SIZE = sizeof(Bucket);
+
+    Shard &get_shard(std::uint64_t hash);
+
+    std::array<Shard, NUM_SHARDS> m_shards;
+    size_t m_size;
+
+    std::atomic<int> m_hits;
+    std::atomic<int> m_lookups;
+    std::atomic<int> m_inserts;
+    std::atomic<int> m_entries;
 };
 
+template <typename EntryType>
+typename Cache<EntryType>::Shard &Cache<EntryType>::get_shard(std::uint64_t hash) {
+    return m_shards[(hash >> 32) % NUM_SHARDS];
+}
+
 template <typename EntryType>
 bool Cache<EntryType>::lookup(std::uint64_t hash, EntryType &result) {
-    LockGuard<lock_t::S_LOCK> lock(m_sm);
-    
-    bool success = true;
-    ++m_lookups;
-
-    const auto iter = m_cache.find(hash);
-    if (iter == m_cache.end()) {
-        success = false;
-    } else {
-        const auto &entry = iter->second;
-        ++m_hits;
-        result = entry->result;
+    m_lookups.fetch_add(1, std::memory_order_relaxed);
+
+    auto &shard = get_shard(hash);
+    if (shard.size == 0) {
+        return false;
+    }
+
+    const auto start = hash % shard.size;
+    for (auto i = size_t{0}; i < PROBE_LENGTH; ++i) {
+        auto &bucket = shard.buckets[(start + i) % shard.size];
+        const auto version = bucket.version.load(std::memory_order_acquire);
+        if (version == 0 || (version & 1) || bucket.hash != hash) {
+            continue;
+        }
+
+        std::memcpy(&result, &bucket.result, sizeof(EntryType));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (bucket.version.load(std::memory_order_relaxed) != version) {
+            // A writer replaced it while we were reading.
+            return false;
+        }
+        bucket.referenced.store(true, std::memory_order_relaxed);
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
     }
-    return success;
+    return false;
 }
 
 template <typename EntryType>
 void Cache<EntryType>::insert(std::uint64_t hash, const EntryType &result) {
-    LockGuard<lock_t::X_LOCK> lock(m_sm);
-    
-    if (m_cache.find(hash) == m_cache.end()) {
-        m_cache.emplace(hash, std::make_unique<Entry>(result));
-        m_order.emplace_back(hash);
-        ++m_inserts;
-
-        if (m_order.size() > m_size) {
-            m_cache.erase(m_order.front());
-            m_order.pop_front();
+    auto &shard = get_shard(hash);
+    if (shard.size == 0) {
+        return;
+    }
+
+    const auto start = hash % shard.size;
+    Bucket *victim = nullptr;
+
+    for (auto i = size_t{0}; i < PROBE_LENGTH; ++i) {
+        auto &bucket = shard.buckets[(start + i) % shard.size];
+        const auto version = bucket.version.load(std::memory_order_acquire);
+        if (version == 0) {
+            victim = &bucket;
+            break;
         }
+        if (version & 1) {
+            continue;
+        }
+        if (bucket.hash == hash) {
+            // Replace the old result of the same position.
+            victim = &bucket;
+            break;
+        }
+        if (!bucket.referenced.exchange(false, std::memory_order_relaxed) &&
+                victim == nullptr) {
+            victim = &bucket;
+        }
+    }
+
+    if (victim == nullptr) {
+        victim = &shard.buckets[start];
+    }
+
+    auto version = victim->version.load(std::memory_order_relaxed);
+    if ((version & 1) ||
+            !victim->version.compare_exchange_strong(version, version + 1,
+                                                     std::memory_order_acquire)) {
+        // Other thread is writing this bucket, give up.
+        return;
     }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    victim->hash = hash;
+    std::memcpy(&victim->result, &result, sizeof(EntryType));
+    victim->referenced.store(false, std::memory_order_relaxed);
+    victim->version.store(version + 2, std::memory_order_release);
+
+    if (version == 0) {
+        m_entries.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_inserts.fetch_add(1, std::memory_order_relaxed);
 }
 
 template <typename EntryType>
 void Cache<EntryType>::resize(size_t size) {
-    LockGuard<lock_t::X_LOCK> lock(m_sm);
-
     m_size = size > Cache::MAX_CACHE_COUNT ? Cache::MAX_CACHE_COUNT : 
                  size < Cache::MIN_CACHE_COUNT ? Cache::MIN_CACHE_COUNT : size;
 
-    while (m_order.size() > m_size) {
-        m_cache.erase(m_order.front());
-        m_order.pop_front();
+    const auto shard_size = m_size / NUM_SHARDS + (m_size % NUM_SHARDS != 0);
+    for (auto &shard : m_shards) {
+        if (shard.size != shard_size) {
+            shard.buckets.reset(new Bucket[shard_size]);
+            shard.size = shard_size;
+        }
     }
+    clear();
 }
 
 template <typename EntryType> 
 void Cache<EntryType>::clear() {
-    LockGuard<lock_t::X_LOCK> lock(m_sm);
-    
-    if (!m_order.empty()) {
-        m_cache.clear();
-        m_order.clear();
+    for (auto &shard : m_shards) {
+        for (auto i = size_t{0}; i < shard.size; ++i) {
+            shard.buckets[i].version.store(0, std::memory_order_relaxed);
+            shard.buckets[i].referenced.store(false, std::memory_order_relaxed);
+        }
     }
+    m_entries.store(0);
 }
 
 template <typename EntryType>
 size_t Cache<EntryType>::get_estimated_size() {
-    return m_order.size() * Cache::ENTRY_SIZE;
+    return m_entries.load() * Cache::ENTRY_SIZE;
 }
 
 template <typename EntryType>
 void Cache<EntryType>::clear_stats() {
-    LockGuard<lock_t::X_LOCK> lock(m_sm);
-    m_hits = 0;
-    m_lookups = 0;
-    m_inserts = 0;
+    m_hits.store(0);
+    m_lookups.store(0);
+    m_inserts.store(0);
 }
 
 template <typename EntryType>
 void Cache<EntryType>::dump_capacity() {
-    LockGuard<lock_t::S_LOCK> lock(m_sm);
     Utils::printf<Utils::AUTO>("Cach memory used : %.4f(Mib)\n",
                                (float)(m_size * Cache::ENTRY_SIZE) / (1024.f * 1024.f));
 }
 
 template <typename EntryType> 
 void Cache<EntryType>::dump_stats() {
-    LockGuard<lock_t::S_LOCK> lock(m_sm);
-    Utils::printf<Utils::AUTO>("Cache: %d/%d hits/lookups = %.2f, hitrate, %d inserts, %lu size, memory used : %zu\n",
-                                   m_hits, m_lookups,
-                                   100.f * m_hits / (m_lookups + 1),
-                                   m_inserts,
-                                   m_cache.size(),
+    const int hits = m_hits.load();
+    const int lookups = m_lookups.load();
+    Utils::printf<Utils::AUTO>("Cache: %d/%d hits/lookups = %.2f, hitrate, %d inserts, %d size, memory used : %zu\n",
+                                   hits, lookups,
+                                   100.f * hits / (lookups + 1),
+                                   m_inserts.load(),
+                                   m_entries.load(),
                                    get_estimated_size());
 }
 #endif
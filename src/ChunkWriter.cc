@@ -0,0 +1,141 @@
+/*
+    This file is part of ElephantArt.
+    Copyright (C) 2021 Hung-Zhe Lin
+
+    ElephantArt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ElephantArt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChunkWriter.h"
+#include "Train.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <fstream>
+
+constexpr char ChunkWriter::MAGIC[8];
+
+ChunkWriter::ChunkWriter(std::string prefix, const int games_per_chunk) :
+                         m_prefix(prefix), m_games_per_chunk(std::max(1, games_per_chunk)) {
+    m_thread = std::thread([this](){ worker(); });
+}
+
+ChunkWriter::~ChunkWriter() {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+    close_chunk();
+}
+
+void ChunkWriter::push(std::string &&records) {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_queue.emplace(std::move(records));
+    }
+    m_cv.notify_one();
+}
+
+void ChunkWriter::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_empty_cv.wait(lock, [this](){ return m_queue.empty() && !m_writing; });
+    close_chunk();
+}
+
+void ChunkWriter::worker() {
+    while (true) {
+        auto buffer = std::string{};
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this](){ return !m_queue.empty() || !m_running; });
+            if (m_queue.empty()) {
+                // Not running and nothing left to write.
+                return;
+            }
+            buffer = std::move(m_queue.front());
+            m_queue.pop();
+            m_writing = true;
+        }
+
+        write(buffer);
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_writing = false;
+        }
+        m_empty_cv.notify_all();
+    }
+}
+
+bool ChunkWriter::open_chunk() {
+#ifdef USE_ZLIB
+    const auto suffix = std::string{".bin.gz"};
+#else
+    const auto suffix = std::string{".bin"};
+#endif
+
+    // Never overwrite the chunks of the former runs.
+    auto filename = std::string{};
+    do {
+        filename = m_prefix + "_" + std::to_string(m_chunk_index++) + suffix;
+    } while (std::ifstream(filename).good());
+
+#ifdef USE_ZLIB
+    m_file = gzopen(filename.c_str(), "wb");
+#else
+    m_file = std::fopen(filename.c_str(), "wb");
+#endif
+    if (m_file == nullptr) {
+        Utils::printf<Utils::SYNC>("Could not open chunk file : %s!\n", filename.c_str());
+        return false;
+    }
+
+    const auto version = static_cast<std::uint32_t>(DataCollection::BINARY_VERSION);
+    auto header = std::string(MAGIC, sizeof(MAGIC));
+    header.append(reinterpret_cast<const char *>(&version), sizeof(version));
+#ifdef USE_ZLIB
+    gzwrite(m_file, header.data(), header.size());
+#else
+    std::fwrite(header.data(), 1, header.size(), m_file);
+#endif
+    return true;
+}
+
+void ChunkWriter::close_chunk() {
+    if (m_file == nullptr) {
+        return;
+    }
+#ifdef USE_ZLIB
+    gzclose(m_file);
+#else
+    std::fclose(m_file);
+#endif
+    m_file = nullptr;
+    m_games_in_chunk = 0;
+}
+
+void ChunkWriter::write(const std::string &buffer) {
+    if (m_file == nullptr && !open_chunk()) {
+        return;
+    }
+#ifdef USE_ZLIB
+    gzwrite(m_file, buffer.data(), buffer.size());
+#else
+    std::fwrite(buffer.data(), 1, buffer.size(), m_file);
+#endif
+    if (++m_games_in_chunk >= m_games_per_chunk) {
+        close_chunk();
+    }
+}
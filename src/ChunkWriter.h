@@ -0,0 +1,88 @@
+/*
+    This file is part of ElephantArt.
+    Copyright (C) 2021 Hung-Zhe Lin
+
+    ElephantArt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ElephantArt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKWRITER_H_INCLUDE
+#define CHUNKWRITER_H_INCLUDE
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+/*
+ * Write the binary training records to the rotating chunk files. The
+ * games are queued by the search threads and written by one background
+ * thread, so the self-play never waits for the disk.
+ *
+ * The chunks are named <prefix>_<index>.bin, with the suffix .gz if
+ * they are compressed with zlib. Every chunk begins with the magic
+ * "ELEPHTRN" and the 32 bits record version, followed by the records
+ * of DataCollection::out_binary(). A new chunk is opened after the
+ * given number of games.
+ */
+class ChunkWriter {
+public:
+    static constexpr char MAGIC[8] = {'E', 'L', 'E', 'P', 'H', 'T', 'R', 'N'};
+
+    ChunkWriter(std::string prefix, const int games_per_chunk);
+    ~ChunkWriter();
+
+    ChunkWriter(const ChunkWriter &) = delete;
+    ChunkWriter& operator=(const ChunkWriter &) = delete;
+
+    // Queue the records of one game.
+    void push(std::string &&records);
+
+    // Wait until the queue is written and close the current chunk.
+    void flush();
+
+private:
+    void worker();
+    bool open_chunk();
+    void close_chunk();
+    void write(const std::string &buffer);
+
+    std::string m_prefix;
+    int m_games_per_chunk;
+    int m_games_in_chunk{0};
+    int m_chunk_index{0};
+
+#ifdef USE_ZLIB
+    gzFile m_file{nullptr};
+#else
+    std::FILE *m_file{nullptr};
+#endif
+
+    std::queue<std::string> m_queue;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::condition_variable m_empty_cv;
+    bool m_writing{false};
+    bool m_running{true};
+
+    std::thread m_thread;
+};
+
+#endif
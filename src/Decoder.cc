@@ -22,170 +22,86 @@
 #include <cassert>
 #include <sstream>
 
-std::array<Move, POLICYMAP * Board::INTERSECTIONS> Decoder::policymaps_moves;
-std::array<bool, POLICYMAP * Board::INTERSECTIONS> Decoder::policymaps_valid;
-std::unordered_map<std::uint16_t, int> Decoder::moves_map;
-
-void Decoder::initialize() {
-    const auto in_boundary = [](const int x, const int y) -> bool {
-        if (x < 0 || x >= Board::WIDTH) {
-            return false;
-        }
-        if (y < 0 || y >= Board::HEIGHT) {
-            return false;
-        }
-        return true;
-    };
-
-    const auto fill_maps = [&](const int m_offset,
-                               const Types::Vertices from_vtx,
-                               const int to_x,
-                               const int to_y) -> void {
-        auto& move = policymaps_moves[m_offset];
-        if (in_boundary(to_x, to_y)) {
-            const auto to_vtx = Board::get_vertex(to_x, to_y);
-            move = Move(from_vtx, to_vtx);
-            assert(move.is_ok());
-        } else {
-            policymaps_valid[m_offset] = false;
-            assert(!move.valid());
-        }
-    };
-
-    std::fill(std::begin(policymaps_moves), std::end(policymaps_moves), Move{});
-    std::fill(std::begin(policymaps_valid), std::end(policymaps_valid), true);
- 
-    // planes 1 - 18: file moves
-    for (int p = 0; p < 18; ++p) {
-        for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
-            const auto x = Board::get_x(v);
-            const auto y = Board::get_y(v);
-            
-            if (!in_boundary(x,y)) {
-                continue;
-            }
-            
-            const auto idx = Board::get_index(x, y);
-            const auto m_offset = idx + p * Board::INTERSECTIONS;
-
-            const int ms[18] = {
-                1, 2, 3, 4, 5, 6, 7, 8, 9,
-                -1, -2, -3, -4, -5, -6, -7, -8, -9
-            };
-            const auto to_x = x;
-            const auto to_y = y + ms[p];
-            fill_maps(m_offset, v, to_x, to_y);
-        }
+namespace {
+
+struct DecoderTables {
+    Decoder::MovesTable moves;
+    Decoder::ValidTable valid;
+    Decoder::MapsTable maps;
+};
+
+constexpr DecoderTables generate_tables() {
+    auto tables = DecoderTables{};
+    for (auto &maps : tables.maps) {
+        maps = -1;
     }
 
+    // The offsets of the planes, and the steps of every plane.
+    // planes 1 - 18: file moves
     // planes 19 - 34: rank moves
-    for (int p = 0; p < 16; ++p) {
-        for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
-            const auto x = Board::get_x(v);
-            const auto y = Board::get_y(v);
-            
-            if (!in_boundary(x,y)) {
-                continue;
-            }
-            const auto idx = Board::get_index(x, y);
-            const auto m_offset = idx + (p + 18) * Board::INTERSECTIONS;
-
-            const int ms[16] = {
-                1, 2, 3, 4, 5, 6, 7, 8,
-                -1, -2, -3, -4, -5, -6, -7, -8
-            };
-            const auto to_x = x + ms[p];
-            const auto to_y = y;
-            fill_maps(m_offset, v, to_x, to_y);
-        }
-    }
-    
     // planes 35 - 42: horse moves
-    for (int p = 0; p < 8; ++p) {
-        for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
-            const auto x = Board::get_x(v);
-            const auto y = Board::get_y(v);
-            
-            if (!in_boundary(x,y)) {
-                continue;
-            }
-            const auto idx = Board::get_index(x, y);
-            const auto m_offset = idx + (p + 34) * Board::INTERSECTIONS;
-
-            const int ms[8][2] = {
-                {2,1}, {2,-1}, {-2,1}, {-2,-1},
-                {1,2}, {1,-2}, {-1,2}, {-1,-2}
-            };
-            const auto to_x = x + ms[p][0];
-            const auto to_y = y + ms[p][1];
-            fill_maps(m_offset, v, to_x, to_y);
-        }
-    }
-    
     // planes 43 - 46: advisor moves
-    for (int p = 0; p < 4; ++p) {
-        for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
-            const auto x = Board::get_x(v);
-            const auto y = Board::get_y(v);
-            
-            if (!in_boundary(x,y)) {
-                continue;
-            }
-            const auto idx = Board::get_index(x, y);
-            const auto m_offset = idx + (p + 42) * Board::INTERSECTIONS;
-
-            const int ms[4][2] = {
-                {1,1}, {1,-1}, {-1,1}, {-1,-1}
-            };
-            const auto to_x = x + ms[p][0];
-            const auto to_y = y + ms[p][1];
-            fill_maps(m_offset, v, to_x, to_y);
-        }
-    }
-    
     // planes 47 - 50: elephant moves
-    for (int p = 0; p < 4; ++p) {
-        for (auto v = Types::VTX_BEGIN; v < Types::VTX_END; ++v) {
-            const auto x = Board::get_x(v);
-            const auto y = Board::get_y(v);
-            
-            if (!in_boundary(x,y)) {
-                continue;
-            }
-            const auto idx = Board::get_index(x, y);
-            const auto m_offset = idx + (p + 46) * Board::INTERSECTIONS;
-
-            const int ms[4][2] = {
-                {2,2}, {2,-2}, {-2,2}, {-2,-2}
-            };
-            const auto to_x = x + ms[p][0];
-            const auto to_y = y + ms[p][1];
-            fill_maps(m_offset, v, to_x, to_y);
-        }
-    }
+    constexpr int steps[POLICYMAP][2] = {
+        {0,1}, {0,2}, {0,3}, {0,4}, {0,5}, {0,6}, {0,7}, {0,8}, {0,9},
+        {0,-1}, {0,-2}, {0,-3}, {0,-4}, {0,-5}, {0,-6}, {0,-7}, {0,-8}, {0,-9},
+
+        {1,0}, {2,0}, {3,0}, {4,0}, {5,0}, {6,0}, {7,0}, {8,0},
+        {-1,0}, {-2,0}, {-3,0}, {-4,0}, {-5,0}, {-6,0}, {-7,0}, {-8,0},
+
+        {2,1}, {2,-1}, {-2,1}, {-2,-1},
+        {1,2}, {1,-2}, {-1,2}, {-1,-2},
+
+        {1,1}, {1,-1}, {-1,1}, {-1,-1},
+
+        {2,2}, {2,-2}, {-2,2}, {-2,-2}
+    };
 
-    for (int idx = 0; idx < POLICYMAP * Board::INTERSECTIONS; ++idx) {
-        const auto &move = policymaps_moves[idx];
-        if (move.valid()) {
-            assert(moves_map.find(move.get_data()) == std::end(moves_map));
-            moves_map.emplace(move.get_data(), idx);
+    for (int p = 0; p < POLICYMAP; ++p) {
+        for (int y = 0; y < Board::HEIGHT; ++y) {
+            for (int x = 0; x < Board::WIDTH; ++x) {
+                const auto m_offset = x + y * Board::WIDTH + p * Board::INTERSECTIONS;
+                const auto to_x = x + steps[p][0];
+                const auto to_y = y + steps[p][1];
+
+                if (to_x < 0 || to_x >= Board::WIDTH ||
+                        to_y < 0 || to_y >= Board::HEIGHT) {
+                    tables.moves[m_offset] = Move{};
+                    tables.valid[m_offset] = false;
+                    continue;
+                }
+
+                const auto from_vtx = x + y * Board::SHIFT;
+                const auto to_vtx = to_x + to_y * Board::SHIFT;
+                tables.moves[m_offset] = Move(static_cast<Types::Vertices>(from_vtx),
+                                              static_cast<Types::Vertices>(to_vtx));
+                tables.valid[m_offset] = true;
+                tables.maps[from_vtx * Board::NUM_VERTICES + to_vtx] = m_offset;
+            }
         }
     }
+    return tables;
 }
 
+} // namespace
+
+constexpr Decoder::MovesTable Decoder::policymaps_moves = generate_tables().moves;
+constexpr Decoder::ValidTable Decoder::policymaps_valid = generate_tables().valid;
+constexpr Decoder::MapsTable Decoder::moves_map = generate_tables().maps;
+
 Move Decoder::maps2move(const int idx) {
     assert(idx >= 0 && idx < POLICYMAP * Board::INTERSECTIONS);
     return policymaps_moves[idx];
 }
 
 bool Decoder::maps_valid(const int idx) {
+    assert(idx >= 0 && idx < MAPS_SIZE);
     return policymaps_valid[idx];
 }
 
 int Decoder::move2maps(const Move &move) {
-    const auto iter = moves_map.find(move.get_data());
-    assert(iter != std::end(moves_map));
-    const auto maps = iter->second;
+    const auto maps = moves_map[move.get_from() * Board::NUM_VERTICES + move.get_to()];
+    assert(maps >= 0);
     return maps;
 }
 
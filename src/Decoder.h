@@ -19,28 +19,37 @@
 #ifndef DECODER_H_INCLUDE
 #define DECODER_H_INCLUDE
 
-#include <array>
+#include <cstdint>
 #include <string>
-#include <unordered_map>
 
 #include "Model.h"
 #include "Types.h"
 #include "BitBoard.h"
 #include "Board.h"
+#include "StaticArray.h"
 
 class Decoder {
 public:
-    static void initialize();
     static Move maps2move(const int idx);
     static bool maps_valid(const int idx);
     static int move2maps(const Move &move);
 
     static std::string get_mapstring();
 
+    static constexpr auto MAPS_SIZE = POLICYMAP * Board::INTERSECTIONS;
+    static constexpr auto MOVES_SIZE = Board::NUM_VERTICES * Board::NUM_VERTICES;
+
+    using MovesTable = StaticArray<Move, MAPS_SIZE>;
+    using ValidTable = StaticArray<bool, MAPS_SIZE>;
+
+    // The maps index of every (from, to) pair, -1 if there is none.
+    using MapsTable = StaticArray<std::int16_t, MOVES_SIZE>;
+
 private:
-    static std::unordered_map<std::uint16_t, int> moves_map;
-    static std::array<Move, POLICYMAP * Board::INTERSECTIONS> policymaps_moves;
-    static std::array<bool, POLICYMAP * Board::INTERSECTIONS> policymaps_valid;
+    // All the tables are generated at compile time.
+    static const MovesTable policymaps_moves;
+    static const ValidTable policymaps_valid;
+    static const MapsTable moves_map;
 };
 
 #endif
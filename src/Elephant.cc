@@ -18,8 +18,11 @@
 
 #include "ASCII.h"
 #include "UCCI.h"
+#include "Engine.h"
 #include "config.h"
 #include "Utils.h"
+#include "Perft.h"
+#include "NNBench.h"
 
 #include <iostream>
 #include <string>
@@ -45,6 +48,30 @@ static void ucci_loop() {
     auto ucci = std::make_shared<UCCI>();
 }
 
+static void selfplay_loop() {
+    auto engine = std::make_unique<Engine>();
+    engine->initialize();
+
+    const auto res = engine->selfplay_games(option<int>("selfplay_games"),
+                                            option<std::string>("selfplay_file"));
+    Utils::printf<Utils::SYNC>("%s\n", res.c_str());
+}
+
+static int perft_bench() {
+    // Only the move generator is tested. No network is loaded.
+    auto out = std::ostringstream{};
+    const auto success = Perft::bench(out, 4);
+    Utils::printf<Utils::SYNC>(out);
+    return success ? 0 : 1;
+}
+
+static int nn_bench() {
+    auto out = std::ostringstream{};
+    const auto success = NNBench::compare_int8(out, option<std::string>("weights_file"), 1000);
+    Utils::printf<Utils::SYNC>(out);
+    return success ? 0 : 1;
+}
+
 int main(int argc, char **argv) {
     const auto args = ArgsParser(argc, argv);
     const auto license = get_license();
@@ -58,6 +85,12 @@ int main(int argc, char **argv) {
         ascii_loop();
     } else if (option<std::string>("mode") == "ucci") {
         ucci_loop();
+    } else if (option<std::string>("mode") == "selfplay") {
+        selfplay_loop();
+    } else if (option<std::string>("mode") == "perft") {
+        return perft_bench();
+    } else if (option<std::string>("mode") == "nnbench") {
+        return nn_bench();
     }
 
     return 0;
@@ -17,14 +17,22 @@
 */
 
 #include "Engine.h"
+#include "ChunkWriter.h"
 #include "config.h"
 #include "Model.h"
 #include "Decoder.h"
 #include "Utils.h"
 #include "PGNParser.h"
+#include "Perft.h"
+#include "Random.h"
 
+#include <array>
+#include <atomic>
 #include <iomanip>
+#include <mutex>
+#include <random>
 #include <sstream>
+#include <thread>
 
 void Engine::initialize() {
 
@@ -166,7 +174,7 @@ Engine::Response Engine::raw_nn(const int g) {
     auto max_index = 0;
     auto timer = Utils::Timer{};
     auto &p = *get_position(g);
-    auto nnout = m_network->get_output(&p);
+    auto nnout = m_network->get_output(&p, false, false);
     auto microsecond = timer.get_duration_microseconds();
     for (int p = 0; p < POLICYMAP; ++p) {
         rep << "map probabilities: " << p+1 << std::endl;
@@ -239,6 +247,26 @@ Engine::Response Engine::history_board(const int g) {
     return rep.str();
 }
 
+Engine::Response Engine::perft(const int depth, const int g) {
+    auto rep = std::ostringstream{};
+    if (depth < 1) {
+        rep << "Illegal depth";
+        return rep.str();
+    }
+    rep << Perft::divide(get_position(g)->board, depth);
+    return rep.str();
+}
+
+Engine::Response Engine::perft_bench(const int depth) {
+    auto rep = std::ostringstream{};
+    if (depth < 1) {
+        rep << "Illegal depth";
+        return rep.str();
+    }
+    Perft::bench(rep, depth);
+    return rep.str();
+}
+
 Engine::Response Engine::rand_move(const int g) {
     auto rep = std::ostringstream{};
     const auto p = get_position(g); 
@@ -315,6 +343,113 @@ Engine::Response Engine::selfplay(const int g) {
     return rep.str();
 }
 
+Types::Color Engine::play_selfplay_game(const int g, bool &resigned) {
+    auto p = get_position(g);
+    auto s = get_search(g);
+    auto t = get_train(g);
+
+    const auto resign_threshold = option<float>("resign_threshold");
+    const auto reduced_playouts = option<int>("reduced_playouts");
+    const auto reduced_prob = option<float>("reduced_playouts_prob");
+    auto dist = std::uniform_real_distribution<float>(0.0f, 1.0f);
+
+    reset_game(g);
+    t->clear_buffer();
+    resigned = false;
+
+    while (!p->gameover(true)) {
+        auto setting = SearchSetting{};
+        if (reduced_playouts > 0 &&
+                dist(Random<random_t::XoroShiro128Plus>::get_Rng()) < reduced_prob) {
+            setting.playouts = reduced_playouts;
+            setting.collect = false;
+        }
+
+        auto info = SearchInformation{};
+        const auto move = s->uct_move(setting, info);
+        if (resign_threshold > 0.0f && info.winrate < resign_threshold) {
+            resigned = true;
+            return Board::swap_color(p->get_to_move());
+        }
+        const auto success = p->do_move(move);
+        assert(success);
+        (void) success;
+    }
+    return p->get_winner(false);
+}
+
+Engine::Response Engine::selfplay_games(const int games, std::string filename) {
+    auto rep = std::ostringstream{};
+    const auto concurrency = std::min(games, option<int>("num_games"));
+
+    std::atomic<int> next_game{0};
+    auto results = std::array<int, Types::COLOR_NB + 1>{};
+    auto resigns = 0;
+    auto finished = 0;
+    std::mutex mutex;
+    auto timer = Utils::Timer{};
+
+    // The binary records are written to the chunks by the background thread.
+    auto chunk_writer = std::unique_ptr<ChunkWriter>{nullptr};
+    if (filename != "NO_FILE_NAME" && option<bool>("binary_data")) {
+        chunk_writer = std::make_unique<ChunkWriter>(filename, option<int>("chunk_games"));
+    }
+
+    const auto worker = [&](const int g) {
+        while (next_game.fetch_add(1) < games) {
+            auto resigned = false;
+            const auto winner = play_selfplay_game(g, resigned);
+            assert(winner != Types::INVALID_COLOR);
+
+            auto t = get_train(g);
+            t->gather_winner(winner);
+
+            if (chunk_writer) {
+                auto records = std::ostringstream{};
+                t->binary_stream(records);
+                chunk_writer->push(records.str());
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!chunk_writer && filename != "NO_FILE_NAME") {
+                t->save_data(filename);
+            }
+            t->clear_buffer();
+
+            results[winner]++;
+            resigns += resigned;
+            finished++;
+            Utils::printf<Utils::SYNC>("Game %d finished on slot %d, %s%s, %d plies, %.2f second(s)\n",
+                                           finished, g,
+                                           winner == Types::RED ? "red wins" :
+                                               winner == Types::BLACK ? "black wins" : "draw",
+                                           resigned ? " by resignation" : "",
+                                           get_position(g)->get_gameply(),
+                                           timer.get_duration());
+        }
+    };
+
+    auto threads = std::vector<std::thread>{};
+    for (int g = 0; g < concurrency; ++g) {
+        threads.emplace_back(worker, g);
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    if (chunk_writer) {
+        chunk_writer->flush();
+    }
+
+    const auto elapsed = timer.get_duration();
+    rep << finished << " game(s) in " << elapsed << " second(s)"
+        << ", red " << results[Types::RED]
+        << ", black " << results[Types::BLACK]
+        << ", draw " << results[Types::EMPTY_COLOR]
+        << ", resigned " << resigns;
+    return rep.str();
+}
+
 Engine::Response Engine::get_maps() {
     return Decoder::get_mapstring();
 }
@@ -331,10 +466,20 @@ Engine::Response Engine::printf_pgn(std::string filename, const int g) {
     return rep.str();
 }
 
+Engine::Response Engine::convert_weights(std::string filename, std::string outname) {
+    auto rep = std::ostringstream{};
+    if (Model::convert_weights(filename, outname)) {
+        rep << "Converted " << filename << " to " << outname;
+    } else {
+        rep << "Fail to convert " << filename;
+    }
+    return rep.str();
+}
+
 Engine::Response Engine::supervised(std::string filename, std::string outname, const int g) {
     auto rep = std::ostringstream{};
     auto t = get_train(g);
-    t->supervised(filename, outname);
+    rep << t->supervised(filename, outname);
     return rep.str();
 }
 
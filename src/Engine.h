@@ -56,12 +56,22 @@ public:
     Response interrupt(const int g = DEFUALT_POSITION);
     Response ponderhit(const int g = DEFUALT_POSITION);
     Response selfplay(const int g = DEFUALT_POSITION);
+
+    // Play the games on all positions at the same time. The searches share
+    // the network, so their leaves are computed in the same batches. Every
+    // finished game is appended to the data file.
+    Response selfplay_games(const int games, std::string filename = "NO_FILE_NAME");
     Response printf_pgn(std::string filename = "NO_FILE_NAME", const int g = DEFUALT_POSITION);
     Response load_pgn(std::string filename, const int g = DEFUALT_POSITION);
     Response supervised(std::string filename, std::string outname,  const int g = DEFUALT_POSITION);
+    Response perft(const int depth, const int g = DEFUALT_POSITION);
+    Response perft_bench(const int depth);
+    Response convert_weights(std::string filename, std::string outname);
 private:
     int clamp(const int g) const;
 
+    Types::Color play_selfplay_game(const int g, bool &resigned);
+
     std::shared_ptr<Position> get_position(const int g) const;
     std::shared_ptr<Search> get_search(const int g) const;
     std::shared_ptr<Train> get_train(const int g) const;
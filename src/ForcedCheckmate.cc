@@ -16,17 +16,63 @@
     along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <memory>
 #include <algorithm>
 
 #include "ForcedCheckmate.h"
 #include "Board.h"
 
-ForcedCheckmate::ForcedCheckmate(Position &position) : m_rootpos(position) {
+ForcedCheckmate::ForcedCheckmate(Position &position, Table *table) :
+    m_rootpos(position), m_table(table) {
     m_relaxed_move = 0; // unused
     m_maxdepth = 16;
     m_factor = 50.f;
     m_color = m_rootpos.get_to_move();
+    m_store_failures = m_rootpos.get_repetitions() < 2;
+}
+
+std::uint64_t ForcedCheckmate::get_table_hash(const Position &currentpos, bool attacker) {
+    // The same position is a different question for the attacker and
+    // the defender.
+    constexpr auto DEFENDER_KEY = std::uint64_t{0x9e3779b97f4a7c15};
+    return currentpos.get_hash() ^ (attacker ? 0 : DEFENDER_KEY);
+}
+
+bool ForcedCheckmate::probe_table(const Position &currentpos, bool attacker,
+                                  int depth, bool &mate) const {
+    if (!m_table) {
+        return false;
+    }
+    const auto hash = get_table_hash(currentpos, attacker);
+
+    auto entry = MateEntry{};
+    if (!m_table->lookup(hash, entry)) {
+        return false;
+    }
+
+    const auto rule50_ply_left = currentpos.get_rule50_ply_left();
+    if (entry.mate) {
+        if (rule50_ply_left < entry.rule50_ply_left) {
+            return false;
+        }
+    } else if (depth < entry.depth || rule50_ply_left > entry.rule50_ply_left) {
+        return false;
+    }
+    mate = entry.mate;
+    return true;
+}
+
+void ForcedCheckmate::store_table(const Position &currentpos, bool attacker,
+                                  int depth, bool mate) const {
+    if (!m_table || (!mate && !m_store_failures)) {
+        return;
+    }
+    const auto hash = get_table_hash(currentpos, attacker);
+
+    auto entry = MateEntry{};
+    entry.mate = mate;
+    entry.depth = static_cast<std::int16_t>(depth);
+    entry.rule50_ply_left = static_cast<std::int16_t>(currentpos.get_rule50_ply_left());
+    m_table->insert(hash, entry);
 }
 
 Move ForcedCheckmate::find_checkmate() {
@@ -34,13 +80,17 @@ Move ForcedCheckmate::find_checkmate() {
     return find_checkmate(movelist);
 }
 
-Move ForcedCheckmate::find_checkmate(std::vector<Move> &movelist) {
-    if (m_rootpos.gameover(true)) {
+Move ForcedCheckmate::find_checkmate(const MoveList &movelist) {
+    // Don't call gameover() here. The repetition judgement searches the
+    // checkmate on the same position, it would never return.
+    const auto kings = m_rootpos.get_kings();
+    if (kings[Types::RED] == Types::NO_VERTEX ||
+            kings[Types::BLACK] == Types::NO_VERTEX ||
+            m_rootpos.get_rule50_ply_left() <= 0) {
         return Move{};
     }
 
     auto hashbuf = std::vector<std::uint64_t>(10);
-    const auto kings = m_rootpos.get_kings();
     auto cnt = size_t{0};
 
     for (const auto &move: movelist) {
@@ -55,17 +105,19 @@ Move ForcedCheckmate::find_checkmate(std::vector<Move> &movelist) {
             continue;
         }
 
-        auto nextpos = std::make_shared<Position>(m_rootpos);
-        nextpos->do_move_assume_legal(move);
-        if (nextpos->is_check(m_color)) {
+        // Test the check on the bitboards first, only copy the position
+        // for the checking moves.
+        if (m_rootpos.board.gives_check(move)) {
             const auto repetitions = m_rootpos.get_repetitions();
             if (repetitions >= 2) {
                 // This may cause the perpetual check. We may lose the game.
                 // Or the other best result is draw. We don't want these results.
                 continue;
             }
-            hashbuf[0] = nextpos->get_hash();
-            const auto success = !uncheckmate_search(*nextpos, hashbuf, 1, movelist.size() - cnt);
+            auto nextpos = m_rootpos;
+            nextpos.do_move_assume_legal(move);
+            hashbuf[0] = nextpos.get_hash();
+            const auto success = !uncheckmate_search(nextpos, hashbuf, 1, movelist.size() - cnt);
             if (success) {
                 return move;
             }
@@ -80,7 +132,7 @@ bool ForcedCheckmate::is_opp_checkmate() {
     return is_opp_checkmate(movelist);
 }
 
-bool ForcedCheckmate::is_opp_checkmate(std::vector<Move> &movelist) {
+bool ForcedCheckmate::is_opp_checkmate(const MoveList &movelist) {
     if (m_rootpos.get_winner(true) == Board::swap_color(m_color)) {
         return true;
     }
@@ -95,16 +147,15 @@ bool ForcedCheckmate::is_opp_checkmate(std::vector<Move> &movelist) {
             return false;
         }
 
-        auto nextpos = std::make_shared<Position>(m_rootpos);
-        nextpos->do_move_assume_legal(move);
-
-        if (nextpos->is_check(Board::swap_color(m_color))) {
+        if (!m_rootpos.board.is_safe_move(move)) {
             return true;
         }
 
-        hashbuf[0] = nextpos->get_hash();
+        auto nextpos = m_rootpos;
+        nextpos.do_move_assume_legal(move);
+        hashbuf[0] = nextpos.get_hash();
 
-        const auto success = checkmate_search(*nextpos, hashbuf, 1, movelist.size() - cnt);
+        const auto success = checkmate_search(nextpos, hashbuf, 1, movelist.size() - cnt);
         if (success) {
             return true;
         }
@@ -118,6 +169,11 @@ bool ForcedCheckmate::checkmate_search(Position &currentpos,
     if (currentpos.get_rule50_ply_left() == 0 || depth > m_maxdepth + bound) {
         return false;
     }
+    auto mate = false;
+    if (probe_table(currentpos, true, depth, mate)) {
+        return mate;
+    }
+
     const auto to_move = currentpos.get_to_move();
     const auto movelist = currentpos.get_movelist();
     const auto kings = currentpos.get_kings();
@@ -135,15 +191,19 @@ bool ForcedCheckmate::checkmate_search(Position &currentpos,
             continue;
         }
 
-        auto nextpos = std::make_shared<Position>(currentpos);
-        nextpos->do_move_assume_legal(move);
+        if (!currentpos.board.gives_check(move)) {
+            continue;
+        }
 
         const auto repetitions = m_rootpos.get_repetitions();
         if (repetitions >= 2) {
             continue;
         }
 
-        auto hash = nextpos->get_hash();
+        auto nextpos = currentpos;
+        nextpos.do_move_assume_legal(move);
+
+        auto hash = nextpos.get_hash();
         if ((int)buf.size() < depth+1) {
             buf.resize(depth+1);
         }
@@ -158,16 +218,14 @@ bool ForcedCheckmate::checkmate_search(Position &currentpos,
             continue;
         }
 
-        if (!nextpos->is_check(to_move)) {
-            continue;
-        }
-
-        const auto success = !uncheckmate_search(*nextpos, buf, depth+1, movelist.size() - cnt + nodes);
+        const auto success = !uncheckmate_search(nextpos, buf, depth+1, movelist.size() - cnt + nodes);
         if (success) {
+            store_table(currentpos, true, depth, true);
             return true;
         }
     }
     // We don't find a checkmate move.
+    store_table(currentpos, true, depth, false);
     return false;
 }
 
@@ -177,6 +235,11 @@ bool ForcedCheckmate::uncheckmate_search(Position &currentpos,
     if (currentpos.get_rule50_ply_left() == 0 || depth > m_maxdepth + bound) {
         return true;
     }
+    auto mate = false;
+    if (probe_table(currentpos, false, depth, mate)) {
+        return !mate;
+    }
+
     const auto to_move = currentpos.get_to_move();
     const auto movelist = currentpos.get_movelist();
     const auto kings = currentpos.get_kings();
@@ -188,24 +251,26 @@ bool ForcedCheckmate::uncheckmate_search(Position &currentpos,
             return true;
         }
 
-        auto nextpos = std::make_shared<Position>(currentpos);
-        nextpos->do_move_assume_legal(move);
-
-        if (nextpos->is_check(Board::swap_color(to_move))) {
+        if (!currentpos.board.is_safe_move(move)) {
             continue;
         }
 
+        auto nextpos = currentpos;
+        nextpos.do_move_assume_legal(move);
+
         if ((int)buf.size() < depth+1) {
             buf.resize(depth+1);
         }
-        buf[depth] = nextpos->get_hash();
+        buf[depth] = nextpos.get_hash();
 
-        const auto success = !checkmate_search(*nextpos, buf, depth+1, movelist.size() - cnt + nodes);
+        const auto success = !checkmate_search(nextpos, buf, depth+1, movelist.size() - cnt + nodes);
         if (success) {
+            store_table(currentpos, false, depth, false);
             return true;
         }
     }
 
     // We don't find a uncheckmate move.
+    store_table(currentpos, false, depth, true);
     return false;
 }
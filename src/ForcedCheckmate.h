@@ -19,20 +19,43 @@
 #ifndef FORCEDCHECKMATE_H_INCLUDE
 #define FORCEDCHECKMATE_H_INCLUDE
 
+#include <cstdint>
+
 #include "Position.h"
 #include "BitBoard.h"
 #include "Types.h"
+#include "Cache.h"
 
 class ForcedCheckmate {
 public:
-    ForcedCheckmate(Position &position);
+    // Whether the attacker forces the checkmate from the position. A proven
+    // checkmate holds while we have as many rule50 plies. A failed search
+    // only holds for the searches which start at the same or deeper depth.
+    struct MateEntry {
+        bool mate;
+        std::int16_t depth;
+        std::int16_t rule50_ply_left;
+    };
+
+    // The results of the sub-searches. Every search owns one table, so the
+    // expansions and the repetition judgements do not prove the same
+    // positions again. No table means nothing is stored.
+    using Table = Cache<MateEntry>;
+
+    ForcedCheckmate(Position &position, Table *table = nullptr);
 
     Move find_checkmate();
-    Move find_checkmate(std::vector<Move> &movelist);
+    Move find_checkmate(const MoveList &movelist);
     bool is_opp_checkmate();
-    bool is_opp_checkmate(std::vector<Move> &movelist);
+    bool is_opp_checkmate(const MoveList &movelist);
 
 private:
+    static std::uint64_t get_table_hash(const Position &currentpos, bool attacker);
+    bool probe_table(const Position &currentpos, bool attacker,
+                     int depth, bool &mate) const;
+    void store_table(const Position &currentpos, bool attacker,
+                     int depth, bool mate) const;
+
     bool checkmate_search(Position &currentpos,
                           std::vector<std::uint64_t> &buf, int depth, int nodes) const;
     bool uncheckmate_search(Position &currentpos,
@@ -42,6 +65,12 @@ private:
     int m_relaxed_move;
     int m_maxdepth;
     float m_factor;
+
+    Table *m_table;
+
+    // The checking moves are all skipped if the root is repeated, so the
+    // failed searches depend on the root. Don't store them.
+    bool m_store_failures;
 };
 
 #endif
@@ -17,6 +17,8 @@
 */
 
 #include <cassert>
+#include <cstring>
+#include <fstream>
 #include <unordered_map>
 
 #include "Blas.h"
@@ -38,13 +40,13 @@ void process_bn_var(container &weights) {
 }
 
 void Desc::ConvLayer::load_weights(std::vector<float> &loadweights) {
+    loadweights.shrink_to_fit();
     weights = std::move(loadweights);
-    weights.shrink_to_fit();
 }
 
 void Desc::ConvLayer::load_biases(std::vector<float> &loadweights) {
+    loadweights.shrink_to_fit();
     biases = std::move(loadweights);
-    biases.shrink_to_fit();
 }
 
 void Desc::ConvLayer::load_size(int ic, int oc, int ks, bool check) {
@@ -60,14 +62,14 @@ void Desc::ConvLayer::load_size(int ic, int oc, int ks, bool check) {
 }
 
 void Desc::BatchNormLayer::load_means(std::vector<float> &loadweights) {
+    loadweights.shrink_to_fit();
     means = std::move(loadweights);
-    means.shrink_to_fit();
 }
 
 void Desc::BatchNormLayer::load_stddevs(std::vector<float> &loadweights) {
     process_bn_var(loadweights);
+    loadweights.shrink_to_fit();
     stddevs = std::move(loadweights);
-    stddevs.shrink_to_fit();
 }
 
 void Desc::BatchNormLayer::load_size(int c, bool check) {
@@ -81,13 +83,13 @@ void Desc::BatchNormLayer::load_size(int c, bool check) {
 }
 
 void Desc::LinearLayer::load_weights(std::vector<float> &loadweights) {
+    loadweights.shrink_to_fit();
     weights = std::move(loadweights);
-    weights.shrink_to_fit();
 }
 
 void Desc::LinearLayer::load_biases(std::vector<float> &loadweights) {
+    loadweights.shrink_to_fit();
     biases = std::move(loadweights);
-    biases.shrink_to_fit();
 }
 
 void Desc::LinearLayer::load_size(int is, int os, bool check) {
@@ -101,7 +103,7 @@ void Desc::LinearLayer::load_size(int is, int os, bool check) {
     }
 }
 
-void fill_piece_planes(const std::shared_ptr<const Board> board,
+void fill_piece_planes(const Board &board,
                        std::vector<float>::iterator red,
                        std::vector<float>::iterator black) {
     
@@ -109,7 +111,7 @@ void fill_piece_planes(const std::shared_ptr<const Board> board,
         const auto x = idx % Board::WIDTH;
         const auto y = idx / Board::WIDTH;
         const auto vtx = Board::get_vertex(x, y);
-        const auto pis = board->get_piece(vtx);
+        const auto pis = board.get_piece(vtx);
         
         if (static_cast<int>(pis) <  7) {
             red[static_cast<int>(pis) * Board::INTERSECTIONS + idx] = static_cast<float>(true);
@@ -120,7 +122,43 @@ void fill_piece_planes(const std::shared_ptr<const Board> board,
     }
 }
 
+void Model::NNPipe::forward_batch(const int batch_size,
+                                  const std::vector<float> &planes,
+                                  const std::vector<float> &features,
+                                  std::vector<float> &output_pol,
+                                  std::vector<float> &output_val) {
+    const auto planes_size = planes.size() / batch_size;
+    const auto features_size = features.size() / batch_size;
+    const auto pol_size = output_pol.size() / batch_size;
+    const auto val_size = output_val.size() / batch_size;
+
+    auto in_p = std::vector<float>(planes_size);
+    auto in_f = std::vector<float>(features_size);
+    auto out_pol = std::vector<float>(pol_size);
+    auto out_val = std::vector<float>(val_size);
+
+    for (int b = 0; b < batch_size; ++b) {
+        std::copy(std::begin(planes) + b * planes_size,
+                  std::begin(planes) + (b+1) * planes_size,
+                  std::begin(in_p));
+        std::copy(std::begin(features) + b * features_size,
+                  std::begin(features) + (b+1) * features_size,
+                  std::begin(in_f));
+        forward(in_p, in_f, out_pol, out_val);
+        std::copy(std::begin(out_pol), std::end(out_pol),
+                  std::begin(output_pol) + b * pol_size);
+        std::copy(std::begin(out_val), std::end(out_val),
+                  std::begin(output_val) + b * val_size);
+    }
+}
+
 std::vector<float> Model::gather_planes(const Position *const pos) {
+    auto input_data = std::vector<float>{};
+    gather_planes(pos, input_data);
+    return input_data;
+}
+
+void Model::gather_planes(const Position *const pos, std::vector<float> &input_data) {
     static constexpr auto MOVES_PLANES = INPUT_MOVES * 14;
     static constexpr auto STATUS_PLANES = INPUT_STATUS;
 
@@ -131,7 +169,9 @@ std::vector<float> Model::gather_planes(const Position *const pos) {
     // planes |  8 - 14 | Next player picee position.
     // planes | 15 - 16 | Is red or not.
 
-    auto input_data = std::vector<float>(INPUT_CHANNELS * Board::INTERSECTIONS, 0.0f);
+    input_data.resize(INPUT_CHANNELS * Board::INTERSECTIONS);
+    std::fill(std::begin(input_data), std::end(input_data), 0.0f);
+
     auto color = pos->get_to_move();
     auto blk_iterator = std::begin(input_data);
     auto red_iterator = std::begin(input_data);
@@ -147,7 +187,7 @@ std::vector<float> Model::gather_planes(const Position *const pos) {
     // plane 1-7 and 8-14
     for (auto p = 0; p < INPUT_MOVES; ++p) {
         if (p < past_moves) {
-            const auto board = pos->get_past_board(p);
+            const auto &board = pos->get_past_board(p);
             fill_piece_planes(board,
                               red_iterator,
                               blk_iterator);
@@ -167,17 +207,22 @@ std::vector<float> Model::gather_planes(const Position *const pos) {
     }
     std::advance(status_iterator, 2 * Board::INTERSECTIONS);
     assert(status_iterator == std::end(input_data));
-
-    return input_data;
 }
 
 std::vector<float> Model::gather_features(const Position *const pos) {
+    auto input_features = std::vector<float>{};
+    gather_features(pos, input_features);
+    return input_features;
+}
+
+void Model::gather_features(const Position *const pos, std::vector<float> &input_features) {
     // feature 1 : Game plies.
     // feature 2 : Fifty-Rule ply left.
     // feature 3 : repetitions one.
     // feature 4 : repetitions two.
 
-    auto input_features = std::vector<float>(INPUT_FEATURES, 0.0f);
+    input_features.resize(INPUT_FEATURES);
+    std::fill(std::begin(input_features), std::end(input_features), 0.0f);
     const auto ply = pos->get_gameply();
     const auto rpt = pos->get_repetitions();
     const auto r50_left = pos->get_rule50_ply_left();
@@ -189,30 +234,41 @@ std::vector<float> Model::gather_features(const Position *const pos) {
     if (rpt >= 2) {
         input_features[3] = static_cast<float>(true);
     }
-
-    return input_features;
 }
 
-void Model::load_weights(const std::string &filename,
-                         std::shared_ptr<NNWeights> &nn_weight) {
+static bool read_text_file(const std::string &filename, std::stringstream &buffer) {
     auto file = std::ifstream{};
-    auto buffer = std::stringstream{};
     auto line = std::string{};
 
     file.open(filename.c_str());
 
     if (!file.is_open()) {
         Utils::printf<Utils::AUTO>("Could not opne file : %s!\n", filename.c_str());
-        return;
+        return false;
     }
 
     while(std::getline(file, line)) {
         buffer << line << std::endl;
     }
     file.close();
-    
+    return true;
+}
+
+void Model::load_weights(const std::string &filename,
+                         std::shared_ptr<NNWeights> &nn_weight) {
+    auto timer = Utils::Timer{};
+
     try {
-        fill_weights(buffer, nn_weight);
+        if (is_binary_weights(filename)) {
+            load_binary_weights(filename, nn_weight, timer);
+        } else {
+            auto buffer = std::stringstream{};
+            if (!read_text_file(filename, buffer)) {
+                return;
+            }
+            fill_weights(buffer, nn_weight, timer);
+            transform_weights(nn_weight);
+        }
     } catch (const char* err) {
         // Should not happned.
         Utils::printf<Utils::AUTO>("Loading network file warning!\n", err);
@@ -220,14 +276,15 @@ void Model::load_weights(const std::string &filename,
     }
     
     if (nn_weight->loaded && option<bool>("stats_verbose")) {
+        dump_nn_info(nn_weight, timer);
         Utils::printf<Utils::AUTO>("Loading is successful!\n");
     }
 }
 
 
 void Model::fill_weights(std::istream &weights_file,
-                         std::shared_ptr<NNWeights> &nn_weight) {
-    auto timer = Utils::Timer{};
+                         std::shared_ptr<NNWeights> &nn_weight,
+                         Utils::Timer &timer) {
     auto counter = size_t{0};
 
     // Part 1.
@@ -563,9 +620,6 @@ void Model::fill_weights(std::istream &weights_file,
             }
         }
     }
-    if (option<bool>("stats_verbose")) {
-        dump_nn_info(nn_weight, timer);
-    }
 }
 
 NNResult Model::get_result(std::vector<float> &policy,
@@ -573,26 +627,30 @@ NNResult Model::get_result(std::vector<float> &policy,
                            const float p_softmax_temp,
                            const float v_softmax_temp) {
     NNResult result;
+    get_result(policy, value, p_softmax_temp, v_softmax_temp, result);
+    return result;
+}
+
+void Model::get_result(const std::vector<float> &policy,
+                       const std::vector<float> &value,
+                       const float p_softmax_temp,
+                       const float v_softmax_temp,
+                       NNResult &result) {
+    assert(policy.size() >= result.policy.size());
+    assert(value.size() >= result.winrate_misc.size());
 
     // Probabilities
-    const auto probabilities = Activation::Softmax(policy, p_softmax_temp);
-    for (auto p = size_t{0}; p < POLICYMAP; ++p) {
-        for (auto idx = size_t{0}; idx < Board::INTERSECTIONS; ++idx) {
-            result.policy[idx + p * Board::INTERSECTIONS] =
-                probabilities[idx + p * Board::INTERSECTIONS];
-        }
-    }
+    Activation::Softmax(policy.data(), result.policy.size(),
+                        result.policy.data(), p_softmax_temp);
 
     // Winrate
-    const auto wdl_raw = std::vector<float>{value[0], value[1], value[2]}; 
-    const auto wdl = Activation::Softmax(wdl_raw, v_softmax_temp);
+    auto wdl = std::array<float, 3>{};
+    Activation::Softmax(value.data(), wdl.size(), wdl.data(), v_softmax_temp);
 
     result.winrate_misc[0] = wdl[0];                  // wdl head win probability
     result.winrate_misc[1] = wdl[1];                  // wdl head draw probability
     result.winrate_misc[2] = wdl[2];                  // wdl head loss probability
     result.winrate_misc[3] = std::tanh(value[3]);     // stm head winrate
-
-    return result;
 }
 
 void Model::process_weights(std::shared_ptr<NNWeights> &nn_weight) {
@@ -628,6 +686,39 @@ void Model::process_weights(std::shared_ptr<NNWeights> &nn_weight) {
         nn_weight->v_ex_conv.biases[idx] = 0.0f;
     }
 
+    // Fold the batchnorm layers into the convolutions. The CPU backend
+    // only adds the biases. The batchnorm layers are left as the identity
+    // plus the biases, so the backends which still run them separately
+    // get the same result.
+    const auto fold_batchnorm = [](Desc::ConvLayer &conv, Desc::BatchNormLayer &bn) {
+        const auto filter_dim = conv.in_channels * conv.kernel_size * conv.kernel_size;
+        for (auto o = 0; o < conv.out_channels; ++o) {
+            const auto scale = bn.stddevs[o];
+            for (auto i = 0; i < filter_dim; ++i) {
+                conv.weights[o * filter_dim + i] *= scale;
+            }
+            conv.biases[o] = -bn.means[o] * scale;
+            bn.means[o] = -conv.biases[o];
+            bn.stddevs[o] = 1.0f;
+        }
+    };
+
+    fold_batchnorm(nn_weight->input_conv, nn_weight->input_bn);
+    for (auto &residual : nn_weight->residual_tower) {
+        fold_batchnorm(residual.conv_1, residual.bn_1);
+        fold_batchnorm(residual.conv_2, residual.bn_2);
+    }
+    fold_batchnorm(nn_weight->p_ex_conv, nn_weight->p_ex_bn);
+    fold_batchnorm(nn_weight->v_ex_conv, nn_weight->v_ex_bn);
+}
+
+void Model::transform_weights(std::shared_ptr<NNWeights> &nn_weight) {
+    // The int8 weights are from the original fp32 weights, not the
+    // Winograd ones.
+    if (option<bool>("int8")) {
+        quantize_weights(nn_weight);
+    }
+
     if (option<bool>("winograd")) {
         nn_weight->winograd = true;
     } else {
@@ -677,6 +768,360 @@ void Model::process_weights(std::shared_ptr<NNWeights> &nn_weight) {
 
 }
 
+void Model::quantize_weights(std::shared_ptr<NNWeights> &nn_weight) {
+    const auto quantize_conv = [](Desc::ConvLayer &layer) {
+        const auto inputs = layer.in_channels * layer.kernel_size * layer.kernel_size;
+        layer.int8_weights = Int8::quantize_weights(layer.out_channels, inputs,
+                                                    Int8::GEMM_ALIGNMENT, layer.weights);
+    };
+    const auto quantize_linear = [](Desc::LinearLayer &layer) {
+        layer.int8_weights = Int8::quantize_weights(layer.out_size, layer.in_size,
+                                                    Int8::DENSE_ALIGNMENT, layer.weights);
+    };
+
+    quantize_conv(nn_weight->input_conv);
+    for (auto &residual : nn_weight->residual_tower) {
+        quantize_conv(residual.conv_1);
+        quantize_conv(residual.conv_2);
+        if (residual.apply_se) {
+            quantize_linear(residual.extend);
+            quantize_linear(residual.squeeze);
+        }
+    }
+    quantize_conv(nn_weight->p_ex_conv);
+    quantize_linear(nn_weight->v_fc1);
+
+    nn_weight->int8 = true;
+}
+
+// The binary weights file. It begins with the header and the SE size of
+// every residual block (zero if the block has no SE unit). Then come the
+// blobs of the layers, in the same order as the text file. A blob is the
+// 64 bits number of floats and the floats, both aligned to 64 bytes. The
+// batchnorm layers are already folded, and every convolution has one more
+// blob, its Winograd U matrix, which is empty if the kernel is not 3x3.
+// The numbers are in the native byte order.
+static constexpr char BINARY_MAGIC[8] = {'E', 'L', 'E', 'P', 'H', 'B', 'I', 'N'};
+static constexpr std::uint32_t BINARY_VERSION = 1;
+static constexpr size_t BINARY_ALIGNMENT = 64;
+
+struct BinaryHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::int32_t residual_blocks;
+    std::int32_t residual_channels;
+    std::int32_t policy_extract_channels;
+    std::int32_t value_extract_channels;
+    std::int32_t input_channels;
+    std::int32_t input_features;
+    std::int32_t policy_map;
+};
+
+static size_t align_binary(const size_t offset) {
+    return (offset + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT;
+}
+
+bool Model::is_binary_weights(const std::string &filename) {
+    auto file = std::ifstream(filename, std::ios::binary);
+    char magic[sizeof(BINARY_MAGIC)];
+    if (!file.read(magic, sizeof(magic))) {
+        return false;
+    }
+    return std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0;
+}
+
+void Model::load_binary_weights(const std::string &filename,
+                                std::shared_ptr<NNWeights> &nn_weight,
+                                Utils::Timer &timer) {
+    auto file = std::make_shared<Utils::MappedFile>();
+    if (!file->open(filename)) {
+        Utils::printf<Utils::AUTO>("Could not opne file : %s!\n", filename.c_str());
+        return;
+    }
+    nn_weight->mapped_file = file;
+
+    const auto data = file->data();
+    const auto size = file->size();
+
+    auto header = BinaryHeader{};
+    if (size < sizeof(header)) {
+        throw "The binary weights file is truncated";
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0) {
+        throw "Weights file format is not acceptable";
+    }
+    if (header.version != BINARY_VERSION) {
+        throw "The binary weights version is not supported";
+    }
+
+    nn_weight->residual_blocks = header.residual_blocks;
+    nn_weight->residual_channels = header.residual_channels;
+    nn_weight->policy_extract_channels = header.policy_extract_channels;
+    nn_weight->value_extract_channels = header.value_extract_channels;
+    nn_weight->input_channels = header.input_channels;
+    nn_weight->input_features = header.input_features;
+    nn_weight->policy_map = header.policy_map;
+
+    if (nn_weight->input_channels != INPUT_CHANNELS) {
+        throw "The number of input channels is wrong.";
+    }
+    if (nn_weight->input_features != INPUT_FEATURES) {
+        throw "The number of features is wrong.";
+    }
+    if (nn_weight->policy_map != POLICYMAP) {
+        throw "The number of policy map channels is wrong.";
+    }
+    if (nn_weight->residual_blocks < 0 || nn_weight->residual_channels <= 0) {
+        throw "The binary weights header is wrong";
+    }
+
+    const auto residuals = nn_weight->residual_blocks;
+    auto offset = sizeof(header) + residuals * sizeof(std::int32_t);
+    if (size < offset) {
+        throw "The binary weights file is truncated";
+    }
+
+    const auto next_blob = [&](const size_t expected) -> const float * {
+        auto count = std::uint64_t{0};
+        offset = align_binary(offset);
+        if (offset + sizeof(count) > size) {
+            throw "The binary weights file is truncated";
+        }
+        std::memcpy(&count, data + offset, sizeof(count));
+        if (count != expected) {
+            throw "The binary weights layer size is wrong";
+        }
+        offset = align_binary(offset + sizeof(count));
+        if (offset + count * sizeof(float) > size) {
+            throw "The binary weights file is truncated";
+        }
+        const auto blob = reinterpret_cast<const float *>(data + offset);
+        offset += count * sizeof(float);
+        return blob;
+    };
+
+    // The layers refer to the mapping, nothing is copied.
+    const auto read_blob = [&](FloatWeights &weights, const size_t expected) {
+        weights.refer(next_blob(expected), expected);
+    };
+
+    // The Winograd matrices replace the weights if they are used.
+    auto winograd_blobs = std::vector<std::pair<Desc::ConvLayer *, const float *>>{};
+
+    const auto read_convolution = [&](Desc::ConvLayer &layer,
+                                      const int in_channels,
+                                      const int out_channels,
+                                      const int kernel_size) {
+        read_blob(layer.weights, in_channels * out_channels * kernel_size * kernel_size);
+        read_blob(layer.biases, out_channels);
+        layer.load_size(in_channels, out_channels, kernel_size);
+
+        const auto U_size = kernel_size == 3 ? WINOGRAD_TILE * in_channels * out_channels : 0;
+        const auto U = next_blob(U_size);
+        if (U_size != 0) {
+            winograd_blobs.emplace_back(&layer, U);
+        }
+    };
+
+    const auto read_batchnorm = [&](Desc::BatchNormLayer &layer, const int channels) {
+        read_blob(layer.means, channels);
+        read_blob(layer.stddevs, channels);
+        layer.load_size(channels);
+    };
+
+    const auto read_fullyconnect = [&](Desc::LinearLayer &layer,
+                                       const int in_size,
+                                       const int out_size) {
+        read_blob(layer.weights, in_size * out_size);
+        read_blob(layer.biases, out_size);
+        layer.load_size(in_size, out_size);
+    };
+    timer.record();
+
+    // input layer
+    const auto channels = nn_weight->residual_channels;
+    read_convolution(nn_weight->input_conv, INPUT_CHANNELS, channels, 3);
+    read_batchnorm(nn_weight->input_bn, channels);
+    read_fullyconnect(nn_weight->input_fc1, INPUT_FEATURES, 2 * channels);
+    read_fullyconnect(nn_weight->input_fc2, 2 * channels, channels);
+    timer.record();
+
+    // residual tower, the Winograd blobs point to its layers
+    nn_weight->residual_tower.reserve(residuals);
+    for (int b = 0; b < residuals; ++b) {
+        auto se_size = std::int32_t{0};
+        std::memcpy(&se_size, data + sizeof(header) + b * sizeof(se_size), sizeof(se_size));
+
+        nn_weight->residual_tower.emplace_back(NNWeights::ResidualBlock{});
+        auto tower_ptr = nn_weight->residual_tower.data() + b;
+
+        read_convolution(tower_ptr->conv_1, channels, channels, 3);
+        read_batchnorm(tower_ptr->bn_1, channels);
+        read_convolution(tower_ptr->conv_2, channels, channels, 3);
+        read_batchnorm(tower_ptr->bn_2, channels);
+
+        tower_ptr->apply_se = se_size > 0;
+        if (tower_ptr->apply_se) {
+            read_fullyconnect(tower_ptr->extend, channels, se_size);
+            read_fullyconnect(tower_ptr->squeeze, se_size, 2 * channels);
+            tower_ptr->se_size = se_size;
+        }
+    }
+    timer.record();
+
+    // policy head
+    const auto policy_channels = nn_weight->policy_extract_channels;
+    read_convolution(nn_weight->p_ex_conv, channels, policy_channels, 3);
+    read_batchnorm(nn_weight->p_ex_bn, policy_channels);
+    read_convolution(nn_weight->p_map, policy_channels, POLICYMAP, 3);
+
+    // value head
+    const auto value_channels = nn_weight->value_extract_channels;
+    read_convolution(nn_weight->v_ex_conv, channels, value_channels, 1);
+    read_batchnorm(nn_weight->v_ex_bn, value_channels);
+    read_fullyconnect(nn_weight->v_fc1, value_channels * Board::INTERSECTIONS, VALUELAYER);
+    read_fullyconnect(nn_weight->v_fc2, VALUELAYER, WINRATELAYER);
+
+    if (offset != size) {
+        throw "The binary weights file has extra data";
+    }
+
+    nn_weight->loaded = true;
+    timer.record();
+
+    // The layers are already processed, only the runtime transforms are
+    // left. The Winograd ones are from the file.
+    if (option<bool>("int8")) {
+        quantize_weights(nn_weight);
+    }
+    if (option<bool>("winograd")) {
+        for (auto &blob : winograd_blobs) {
+            auto &layer = *blob.first;
+            const auto U_size = WINOGRAD_TILE * layer.in_channels * layer.out_channels;
+            layer.weights.refer(blob.second, U_size);
+        }
+        nn_weight->winograd = true;
+    }
+}
+
+void Model::save_binary_weights(const std::string &filename,
+                                std::shared_ptr<NNWeights> &nn_weight) {
+    if (!nn_weight->loaded || nn_weight->winograd || nn_weight->int8) {
+        throw "Only the processed fp32 weights can be saved";
+    }
+
+    auto file = std::ofstream(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw "Could not open the output file";
+    }
+
+    auto offset = size_t{0};
+    const auto write_bytes = [&](const void *ptr, const size_t size) {
+        file.write(static_cast<const char *>(ptr), size);
+        offset += size;
+    };
+    const auto write_padding = [&]() {
+        static const char zeros[BINARY_ALIGNMENT] = {0};
+        write_bytes(zeros, align_binary(offset) - offset);
+    };
+    const auto write_blob = [&](const FloatWeights &weights) {
+        const auto count = static_cast<std::uint64_t>(weights.size());
+        write_padding();
+        write_bytes(&count, sizeof(count));
+        write_padding();
+        write_bytes(weights.data(), weights.size() * sizeof(float));
+    };
+
+    const auto write_convolution = [&](const Desc::ConvLayer &layer) {
+        write_blob(layer.weights);
+        write_blob(layer.biases);
+        if (layer.kernel_size == 3) {
+            write_blob(FloatWeights(Winograd::transform_f(layer.weights, layer.out_channels, layer.in_channels)));
+        } else {
+            write_blob(FloatWeights{});
+        }
+    };
+    const auto write_batchnorm = [&](const Desc::BatchNormLayer &layer) {
+        write_blob(layer.means);
+        write_blob(layer.stddevs);
+    };
+    const auto write_fullyconnect = [&](const Desc::LinearLayer &layer) {
+        write_blob(layer.weights);
+        write_blob(layer.biases);
+    };
+
+    auto header = BinaryHeader{};
+    std::memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.version = BINARY_VERSION;
+    header.residual_blocks = nn_weight->residual_blocks;
+    header.residual_channels = nn_weight->residual_channels;
+    header.policy_extract_channels = nn_weight->policy_extract_channels;
+    header.value_extract_channels = nn_weight->value_extract_channels;
+    header.input_channels = nn_weight->input_channels;
+    header.input_features = nn_weight->input_features;
+    header.policy_map = nn_weight->policy_map;
+    write_bytes(&header, sizeof(header));
+
+    for (const auto &residual : nn_weight->residual_tower) {
+        const auto se_size = static_cast<std::int32_t>(residual.apply_se ? residual.se_size : 0);
+        write_bytes(&se_size, sizeof(se_size));
+    }
+
+    write_convolution(nn_weight->input_conv);
+    write_batchnorm(nn_weight->input_bn);
+    write_fullyconnect(nn_weight->input_fc1);
+    write_fullyconnect(nn_weight->input_fc2);
+
+    for (const auto &residual : nn_weight->residual_tower) {
+        write_convolution(residual.conv_1);
+        write_batchnorm(residual.bn_1);
+        write_convolution(residual.conv_2);
+        write_batchnorm(residual.bn_2);
+        if (residual.apply_se) {
+            write_fullyconnect(residual.extend);
+            write_fullyconnect(residual.squeeze);
+        }
+    }
+
+    write_convolution(nn_weight->p_ex_conv);
+    write_batchnorm(nn_weight->p_ex_bn);
+    write_convolution(nn_weight->p_map);
+
+    write_convolution(nn_weight->v_ex_conv);
+    write_batchnorm(nn_weight->v_ex_bn);
+    write_fullyconnect(nn_weight->v_fc1);
+    write_fullyconnect(nn_weight->v_fc2);
+
+    if (!file) {
+        throw "Could not write the output file";
+    }
+}
+
+bool Model::convert_weights(const std::string &input, const std::string &output) {
+    if (is_binary_weights(input)) {
+        Utils::printf<Utils::AUTO>("The weights file is already binary : %s!\n", input.c_str());
+        return false;
+    }
+
+    auto buffer = std::stringstream{};
+    if (!read_text_file(input, buffer)) {
+        return false;
+    }
+
+    auto timer = Utils::Timer{};
+    auto nn_weight = std::make_shared<NNWeights>();
+    try {
+        fill_weights(buffer, nn_weight, timer);
+        save_binary_weights(output, nn_weight);
+    } catch (const char* err) {
+        Utils::printf<Utils::AUTO>("Converting network file fail!\n");
+        Utils::printf<Utils::AUTO>("    Cause : %s.\n", err);
+        return false;
+    }
+    return true;
+}
+
 void Model::dump_nn_info(std::shared_ptr<NNWeights> &nn_weight, Utils::Timer &timer) {
     const auto duration = [](Utils::Timer &timer, int t) -> float {
         auto cnt = timer.get_record_count();
@@ -706,6 +1151,12 @@ void Model::dump_nn_info(std::shared_ptr<NNWeights> &nn_weight, Utils::Timer &ti
     }
     Utils::printf<Utils::AUTO>("Policy Channels : %d\n", nn_weight->policy_extract_channels);
     Utils::printf<Utils::AUTO>("Value Channels : %d\n", nn_weight->value_extract_channels);
+    if (nn_weight->int8) {
+        Utils::printf<Utils::AUTO>("Precision : int8, %s kernel\n", Int8::get_kernel_name());
+    }
+    if (nn_weight->winograd) {
+        Utils::printf<Utils::AUTO>("Winograd : F(4x4, 3x3), %s\n", Winograd::get_isa_name());
+    }
 }
 
 void get_weights_from_file(std::istream &weights_file, std::vector<float> &weights) {
@@ -27,6 +27,7 @@
 
 #include "Position.h"
 #include "Utils.h"
+#include "Blas.h"
 
 static constexpr auto INPUT_FEATURES = 4;
 static constexpr auto INPUT_STATUS = 2;
@@ -55,8 +56,11 @@ struct Desc {
         int in_channels;
         int out_channels;
         int kernel_size;
-        std::vector<float> weights;
-        std::vector<float> biases;
+        FloatWeights weights;
+        FloatWeights biases;
+
+        // Only filled in the int8 mode.
+        Int8Weights int8_weights;
     };
 
     struct BatchNormLayer {
@@ -65,8 +69,8 @@ struct Desc {
         void load_size(int c, bool check = true);
         
         int channels;
-        std::vector<float> means;
-        std::vector<float> stddevs;
+        FloatWeights means;
+        FloatWeights stddevs;
     };
 
     struct LinearLayer {
@@ -76,8 +80,11 @@ struct Desc {
         
         int in_size;
         int out_size;
-        std::vector<float> weights;
-        std::vector<float> biases;
+        FloatWeights weights;
+        FloatWeights biases;
+
+        // Only filled in the int8 mode.
+        Int8Weights int8_weights;
     };
 };
 
@@ -96,6 +103,7 @@ struct Model {
         };
         bool loaded{false};
         bool winograd{false};
+        bool int8{false};
         int input_channels{0};
         int input_features{0};
         int residual_blocks{0};
@@ -124,16 +132,31 @@ struct Model {
         Desc::BatchNormLayer v_ex_bn;
         Desc::LinearLayer v_fc1;
         Desc::LinearLayer v_fc2;
+
+        // The layers of the binary weights refer to this mapping, so it
+        // lives as long as the weights.
+        std::shared_ptr<Utils::MappedFile> mapped_file{nullptr};
     };
 
     class NNPipe {
     public:
+        // The network deletes the backend through this class.
+        virtual ~NNPipe() = default;
+
         virtual void initialize(std::shared_ptr<NNWeights> weights) = 0;
         virtual void forward(const std::vector<float> &planes,
                              const std::vector<float> &features,
                              std::vector<float> &output_pol,
                              std::vector<float> &output_val) = 0;
 
+        // Compute the batch of the inputs, which are packed one after
+        // the other. The default computes them one by one.
+        virtual void forward_batch(const int batch_size,
+                                   const std::vector<float> &planes,
+                                   const std::vector<float> &features,
+                                   std::vector<float> &output_pol,
+                                   std::vector<float> &output_val);
+
         virtual void reload(std::shared_ptr<Model::NNWeights> weights) = 0;
         virtual void release() = 0;
         
@@ -144,15 +167,43 @@ struct Model {
     static std::vector<float> gather_planes(const Position *const pos);
     static std::vector<float> gather_features(const Position *const pos);
 
+    // Fill the inputs in the given buffers, they are reused between the
+    // evaluations.
+    static void gather_planes(const Position *const pos, std::vector<float> &planes);
+    static void gather_features(const Position *const pos, std::vector<float> &features);
+
     static void load_weights(const std::string &filename,
                              std::shared_ptr<NNWeights> &nn_weight);
-    
+
+    // The binary weights are processed in advance and mapped read-only,
+    // so the loading does not parse or transform anything.
+    static bool is_binary_weights(const std::string &filename);
+
+    static void load_binary_weights(const std::string &filename,
+                                    std::shared_ptr<NNWeights> &nn_weight,
+                                    Utils::Timer &timer);
+
+    static void save_binary_weights(const std::string &filename,
+                                    std::shared_ptr<NNWeights> &nn_weight);
+
+    // Convert the text weights file to the binary one.
+    static bool convert_weights(const std::string &input, const std::string &output);
+
+    // Merge the biases and fold the batchnorm layers.
     static void process_weights(std::shared_ptr<NNWeights> &nn_weight);
 
+    // The int8 and Winograd transforms selected by the options.
+    static void transform_weights(std::shared_ptr<NNWeights> &nn_weight);
+
+    // Convert the hidden layers to int8. The input features, the policy
+    // map and the last value layer stay in fp32.
+    static void quantize_weights(std::shared_ptr<NNWeights> &nn_weight);
+
     static void dump_nn_info(std::shared_ptr<NNWeights> &nn_weight, Utils::Timer &timer);
 
     static void fill_weights(std::istream &weights_file,
-                             std::shared_ptr<NNWeights> &nn_weight);
+                             std::shared_ptr<NNWeights> &nn_weight,
+                             Utils::Timer &timer);
     
     static void fill_fullyconnect_layer(Desc::LinearLayer &layer,
                                         std::istream &weights_file,
@@ -173,5 +224,11 @@ struct Model {
                                std::vector<float> &value,
                                const float p_softmax_temp,
                                const float v_softmax_temp);
+
+    static void get_result(const std::vector<float> &policy,
+                           const std::vector<float> &value,
+                           const float p_softmax_temp,
+                           const float v_softmax_temp,
+                           NNResult &result);
 };
 #endif
@@ -0,0 +1,81 @@
+/*
+    This file is part of ElephantArt.
+    Copyright (C) 2021 Hung-Zhe Lin
+
+    ElephantArt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ElephantArt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOVELIST_H_INCLUDE
+#define MOVELIST_H_INCLUDE
+
+#include "BitBoard.h"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+
+/*
+ * A fixed capacity move list living on the stack. The generators fill
+ * it without touching the heap.
+ *
+ * Board::fen2board() rejects the positions with more pieces than the
+ * start position, and the moves never add any. So one side has at most
+ *
+ *   rook     2 * 17 (8 on the rank, 9 on the file)
+ *   cannon   2 * 17 (the same lines, the capture replaces the screen)
+ *   horse    2 * 8
+ *   elephant 2 * 4
+ *   advisor  2 * 4
+ *   pawn     5 * 3
+ *   king     4 + 1 (the face to face capture)
+ *
+ * pseudo legal moves, 120 in all. 128 slots are enough.
+ */
+class MoveList {
+public:
+    static constexpr size_t MAX_MOVES = 128;
+
+    void emplace_back(const Move move) {
+        assert(m_size < MAX_MOVES);
+        m_moves[m_size++] = move;
+    }
+
+    void clear() { m_size = 0; }
+
+    Move *begin() { return m_moves.data(); }
+    Move *end() { return m_moves.data() + m_size; }
+    const Move *begin() const { return m_moves.data(); }
+    const Move *end() const { return m_moves.data() + m_size; }
+
+    Move &operator[](size_t idx) { return m_moves[idx]; }
+    const Move &operator[](size_t idx) const { return m_moves[idx]; }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    bool contains(const Move move) const {
+        for (const auto &m : *this) {
+            if (m.get_data() == move.get_data()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::array<Move, MAX_MOVES> m_moves;
+    size_t m_size{0};
+};
+
+#endif
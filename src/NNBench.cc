@@ -0,0 +1,229 @@
+/*
+    This file is part of ElephantArt.
+    Copyright (C) 2021 Hung-Zhe Lin
+
+    ElephantArt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ElephantArt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "NNBench.h"
+#include "CPUBackend.h"
+#include "Decoder.h"
+#include "Model.h"
+#include "Position.h"
+#include "Random.h"
+#include "Utils.h"
+#include "config.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <vector>
+
+struct BenchInputs {
+    std::vector<float> planes;
+    std::vector<float> features;
+    std::vector<std::vector<int>> maps;
+};
+
+// Play the random legal moves from the start position. Every position
+// is at the random ply of its game.
+static BenchInputs gather_positions(const int positions) {
+    auto inputs = BenchInputs{};
+    auto rng = Random<random_t::XoroShiro128Plus>(positions);
+    auto pos = Position{};
+
+    while ((int)inputs.maps.size() < positions) {
+        pos.init_game(0);
+        const auto plies = rng.randfix<80>();
+        auto movelist = MoveList{};
+        for (auto p = size_t{0}; p <= plies; ++p) {
+            movelist.clear();
+            pos.board.generate_legal_moves(movelist);
+            if (movelist.empty() || p == plies) {
+                break;
+            }
+            pos.do_move_assume_legal(movelist[rng.randuint64() % movelist.size()]);
+        }
+        if (movelist.empty()) {
+            continue;
+        }
+
+        const auto planes = Model::gather_planes(&pos);
+        const auto features = Model::gather_features(&pos);
+        inputs.planes.insert(std::end(inputs.planes), std::begin(planes), std::end(planes));
+        inputs.features.insert(std::end(inputs.features), std::begin(features), std::end(features));
+
+        auto maps = std::vector<int>{};
+        for (const auto &move : movelist) {
+            maps.emplace_back(Decoder::move2maps(move));
+        }
+        inputs.maps.emplace_back(maps);
+    }
+    return inputs;
+}
+
+static void evaluate(CPUBackend &backend,
+                     const BenchInputs &inputs,
+                     const int batch_size,
+                     std::vector<float> &output_pol,
+                     std::vector<float> &output_val) {
+    const auto positions = (int)inputs.maps.size();
+    const auto planes_size = inputs.planes.size() / positions;
+    const auto features_size = inputs.features.size() / positions;
+    const auto pol_size = size_t{POLICYMAP * Board::INTERSECTIONS};
+    const auto val_size = size_t{WINRATELAYER};
+
+    output_pol.resize(positions * pol_size);
+    output_val.resize(positions * val_size);
+
+    for (int i = 0; i < positions; i += batch_size) {
+        const auto batch = std::min(batch_size, positions - i);
+        const auto planes = std::vector<float>(std::begin(inputs.planes) + i * planes_size,
+                                               std::begin(inputs.planes) + (i + batch) * planes_size);
+        const auto features = std::vector<float>(std::begin(inputs.features) + i * features_size,
+                                                 std::begin(inputs.features) + (i + batch) * features_size);
+        auto pol = std::vector<float>(batch * pol_size);
+        auto val = std::vector<float>(batch * val_size);
+
+        backend.batch_forward(batch, planes, features, pol, val);
+
+        std::copy(std::begin(pol), std::end(pol), std::begin(output_pol) + i * pol_size);
+        std::copy(std::begin(val), std::end(val), std::begin(output_val) + i * val_size);
+    }
+}
+
+bool NNBench::compare_int8(std::ostream &out,
+                           const std::string &weightsfile,
+                           const int positions) {
+    // Load the same file twice, with and without the int8 mode.
+    const auto int8_option = option<bool>("int8");
+    auto fp32_weights = std::make_shared<Model::NNWeights>();
+    auto int8_weights = std::make_shared<Model::NNWeights>();
+    set_option("int8", false);
+    Model::load_weights(weightsfile, fp32_weights);
+    set_option("int8", true);
+    Model::load_weights(weightsfile, int8_weights);
+    set_option("int8", int8_option);
+
+    if (!fp32_weights->loaded || !int8_weights->loaded) {
+        out << "Can not load the network." << std::endl;
+        return false;
+    }
+
+    CPUBackend fp32_backend;
+    CPUBackend int8_backend;
+    fp32_backend.reload(fp32_weights);
+    int8_backend.reload(int8_weights);
+
+    const auto inputs = gather_positions(positions);
+    out << "Network: " << fp32_weights->residual_blocks << " blocks, "
+        << fp32_weights->residual_channels << " channels" << std::endl;
+    out << "Int8 kernel: " << Int8::get_kernel_name() << std::endl;
+    out << "Positions: " << positions << std::endl;
+    out << std::endl;
+
+    // The accuracy. The policy only counts the legal moves.
+    auto fp32_pol = std::vector<float>{};
+    auto fp32_val = std::vector<float>{};
+    auto int8_pol = std::vector<float>{};
+    auto int8_val = std::vector<float>{};
+    evaluate(fp32_backend, inputs, 1, fp32_pol, fp32_val);
+    evaluate(int8_backend, inputs, 1, int8_pol, int8_val);
+
+    auto compared = 0;
+    auto same_best = 0;
+    auto policy_diff = 0.0;
+    auto wdl_diff = 0.0;
+    auto winrate_diff = 0.0;
+    auto max_winrate_diff = 0.0;
+    const auto pol_size = size_t{POLICYMAP * Board::INTERSECTIONS};
+    const auto val_size = size_t{WINRATELAYER};
+    for (int i = 0; i < positions; ++i) {
+        auto pol_a = std::vector<float>(std::begin(fp32_pol) + i * pol_size,
+                                        std::begin(fp32_pol) + (i+1) * pol_size);
+        auto val_a = std::vector<float>(std::begin(fp32_val) + i * val_size,
+                                        std::begin(fp32_val) + (i+1) * val_size);
+        auto pol_b = std::vector<float>(std::begin(int8_pol) + i * pol_size,
+                                        std::begin(int8_pol) + (i+1) * pol_size);
+        auto val_b = std::vector<float>(std::begin(int8_val) + i * val_size,
+                                        std::begin(int8_val) + (i+1) * val_size);
+
+        const auto result_a = Model::get_result(pol_a, val_a, 1.0f, 1.0f);
+        const auto result_b = Model::get_result(pol_b, val_b, 1.0f, 1.0f);
+
+        const auto wdl_a = result_a.winrate_misc[0] - result_a.winrate_misc[2];
+        const auto wdl_b = result_b.winrate_misc[0] - result_b.winrate_misc[2];
+        wdl_diff += std::abs(wdl_a - wdl_b);
+
+        const auto winrate = std::abs(result_a.winrate_misc[3] - result_b.winrate_misc[3]);
+        winrate_diff += winrate;
+        max_winrate_diff = std::max(max_winrate_diff, (double)winrate);
+
+        auto sum_a = 0.0f;
+        auto sum_b = 0.0f;
+        for (const auto maps : inputs.maps[i]) {
+            sum_a += result_a.policy[maps];
+            sum_b += result_b.policy[maps];
+        }
+        if (sum_a <= 0.0f || sum_b <= 0.0f) {
+            // All the probabilities are out of the legal moves.
+            continue;
+        }
+
+        auto best_a = inputs.maps[i][0];
+        auto best_b = inputs.maps[i][0];
+        auto diff = 0.0f;
+        for (const auto maps : inputs.maps[i]) {
+            if (result_a.policy[maps] > result_a.policy[best_a]) {
+                best_a = maps;
+            }
+            if (result_b.policy[maps] > result_b.policy[best_b]) {
+                best_b = maps;
+            }
+            diff += std::abs(result_a.policy[maps] / sum_a - result_b.policy[maps] / sum_b);
+        }
+        compared++;
+        same_best += (best_a == best_b);
+        policy_diff += 0.5f * diff;
+    }
+
+    out << std::fixed << std::setprecision(4);
+    out << "Accuracy (int8 vs fp32):" << std::endl;
+    out << "  same best move : " << 100.0 * same_best / std::max(1, compared) << " %" << std::endl;
+    out << "  policy distance : " << policy_diff / std::max(1, compared) << std::endl;
+    out << "  wdl error : " << wdl_diff / positions << std::endl;
+    out << "  winrate error : " << winrate_diff / positions
+        << " (max " << max_winrate_diff << ")" << std::endl;
+    out << std::endl;
+
+    // The speed, the batched evaluations are from the forward queue.
+    out << "Speed (evaluations per second):" << std::endl;
+    for (const auto batch_size : {1, 8, 32}) {
+        auto timer = Utils::Timer{};
+        evaluate(fp32_backend, inputs, batch_size, fp32_pol, fp32_val);
+        const auto fp32_time = std::max(1, timer.get_duration_microseconds());
+
+        timer.clock();
+        evaluate(int8_backend, inputs, batch_size, int8_pol, int8_val);
+        const auto int8_time = std::max(1, timer.get_duration_microseconds());
+
+        out << "  batch " << std::setw(2) << batch_size
+            << " : fp32 " << std::setprecision(1) << 1e6 * positions / fp32_time
+            << ", int8 " << 1e6 * positions / int8_time
+            << ", speedup " << std::setprecision(2) << (double)fp32_time / int8_time << "x"
+            << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+/*
+    This file is part of ElephantArt.
+    Copyright (C) 2021 Hung-Zhe Lin
+
+    ElephantArt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ElephantArt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NNBENCH_H_INCLUDE
+#define NNBENCH_H_INCLUDE
+
+#include <ostream>
+#include <string>
+
+/*
+ * Compare the int8 network with the fp32 network. Both networks
+ * evaluate the same random positions, then we report how far the
+ * int8 outputs are from the fp32 ones and the evaluation speed of
+ * both.
+ */
+class NNBench {
+public:
+    // Return false if the network can not be loaded.
+    static bool compare_int8(std::ostream &out,
+                             const std::string &weightsfile,
+                             const int positions);
+};
+
+#endif
@@ -24,6 +24,7 @@
 
 #include "CPUBackend.h"
 #include "Board.h"
+#include "Decoder.h"
 #include "Position.h"
 #include "Random.h"
 #include "Utils.h"
@@ -132,7 +133,39 @@ void Network::set_playouts(const int playouts) {
 
 bool Network::probe_cache(const Position *const position,
                           Network::Netresult &result) {
-    return m_cache.lookup(position->get_hash(), result);
+    auto entry = CacheEntry{};
+    if (!m_cache.lookup(position->get_hash(), entry)) {
+        return false;
+    }
+
+    // The result may be reused, only the moves in the entry have policy.
+    result.policy.fill(0.0f);
+    for (int i = 0; i < entry.count; ++i) {
+        result.policy[entry.maps[i]] = entry.policy[i];
+    }
+    result.winrate_misc = entry.winrate_misc;
+    return true;
+}
+
+void Network::insert_cache(const Position *const position,
+                           const Network::Netresult &result) {
+    auto movelist = MoveList{};
+    position->board.generate_movelist(position->get_to_move(), movelist);
+
+    // Every move list fits in the entry.
+    static_assert(CacheEntry::MAX_MOVES >= MoveList::MAX_MOVES, "");
+
+    auto entry = CacheEntry{};
+    entry.count = 0;
+    for (const auto &move : movelist) {
+        const auto maps = Decoder::move2maps(move);
+        entry.maps[entry.count] = maps;
+        entry.policy[entry.count] = result.policy[maps];
+        entry.count++;
+    }
+    entry.winrate_misc = result.winrate_misc;
+
+    m_cache.insert(position->get_hash(), entry);
 }
 
 void dummy_forward(std::vector<float> &policy,
@@ -161,12 +194,16 @@ void dummy_forward(std::vector<float> &policy,
     }
 }
 
-Network::Netresult Network::get_output_internal(const Position *const position) {
-    auto policy_out = std::vector<float>(POLICYMAP * INTERSECTIONS);
-    auto winrate_out = std::vector<float>(WINRATELAYER);
+void Network::get_output_internal(const Position *const position, Netresult &result) {
+    // The input and output buffers of the search thread, they are reused
+    // for every evaluation.
+    thread_local auto input_planes = std::vector<float>{};
+    thread_local auto input_features = std::vector<float>{};
+    thread_local auto policy_out = std::vector<float>(POLICYMAP * INTERSECTIONS);
+    thread_local auto winrate_out = std::vector<float>(WINRATELAYER);
 
-    auto input_planes = Model::gather_planes(position);
-    auto input_features = Model::gather_features(position) ;
+    Model::gather_planes(position, input_planes);
+    Model::gather_features(position, input_features);
     if (m_forward->valid()) {
         m_forward->forward(input_planes, input_features, policy_out, winrate_out);
     } else {
@@ -174,34 +211,103 @@ Network::Netresult Network::get_output_internal(const Position *const position)
         dummy_forward(policy_out, winrate_out);
     }
 
-
-    const auto result = Model::get_result(policy_out,
-                                          winrate_out,
-                                          option<float>("softmax_pol_temp"),
-                                          option<float>("softmax_wdl_temp"));
-
-    return result;
+    Model::get_result(policy_out,
+                      winrate_out,
+                      option<float>("softmax_pol_temp"),
+                      option<float>("softmax_wdl_temp"),
+                      result);
 }
 
 Network::Netresult
 Network::get_output(const Position *const position,
                     const bool read_cache,
                     const bool write_cache) {
-
     Netresult result;
+    get_output(position, result, read_cache, write_cache);
+    return result;
+}
 
+void Network::get_output(const Position *const position,
+                         Netresult &result,
+                         const bool read_cache,
+                         const bool write_cache) {
     if (read_cache) {
         if (probe_cache(position, result)) {
-            return result;
+            return;
         }
     }
 
-    result = get_output_internal(position);
+    get_output_internal(position, result);
 
     if (write_cache) {
-        m_cache.insert(position->get_hash(), result);
+        insert_cache(position, result);
+    }
+}
+
+void Network::get_output_batch(const std::vector<const Position *> &positions,
+                               std::vector<Netresult> &results) {
+    thread_local auto input_planes = std::vector<float>{};
+    thread_local auto input_features = std::vector<float>{};
+    thread_local auto batch_planes = std::vector<float>{};
+    thread_local auto batch_features = std::vector<float>{};
+    thread_local auto policy_out = std::vector<float>{};
+    thread_local auto winrate_out = std::vector<float>{};
+    thread_local auto misses = std::vector<size_t>{};
+
+    results.resize(positions.size());
+    misses.clear();
+    for (auto i = size_t{0}; i < positions.size(); ++i) {
+        if (!probe_cache(positions[i], results[i])) {
+            misses.emplace_back(i);
+        }
+    }
+    if (misses.empty()) {
+        return;
+    }
+
+    const auto batch_size = static_cast<int>(misses.size());
+    batch_planes.clear();
+    batch_features.clear();
+    for (const auto i : misses) {
+        Model::gather_planes(positions[i], input_planes);
+        Model::gather_features(positions[i], input_features);
+        batch_planes.insert(std::end(batch_planes),
+                            std::begin(input_planes), std::end(input_planes));
+        batch_features.insert(std::end(batch_features),
+                              std::begin(input_features), std::end(input_features));
+    }
+
+    const auto pol_size = size_t{POLICYMAP * INTERSECTIONS};
+    const auto val_size = size_t{WINRATELAYER};
+    policy_out.resize(batch_size * pol_size);
+    winrate_out.resize(batch_size * val_size);
+
+    if (m_forward->valid()) {
+        m_forward->forward_batch(batch_size, batch_planes, batch_features,
+                                 policy_out, winrate_out);
+    }
+
+    thread_local auto pol = std::vector<float>(pol_size);
+    thread_local auto val = std::vector<float>(val_size);
+    for (int b = 0; b < batch_size; ++b) {
+        if (m_forward->valid()) {
+            std::copy(std::begin(policy_out) + b * pol_size,
+                      std::begin(policy_out) + (b+1) * pol_size,
+                      std::begin(pol));
+            std::copy(std::begin(winrate_out) + b * val_size,
+                      std::begin(winrate_out) + (b+1) * val_size,
+                      std::begin(val));
+        } else {
+            dummy_forward(pol, val);
+        }
+
+        const auto i = misses[b];
+        Model::get_result(pol, val,
+                          option<float>("softmax_pol_temp"),
+                          option<float>("softmax_wdl_temp"),
+                          results[i]);
+        insert_cache(positions[i], results[i]);
     }
-    return result;
 }
 
 void Network::release_nn() {
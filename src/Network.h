@@ -41,6 +41,17 @@ public:
                          const bool read_cache = true,
                          const bool write_cache = true);
 
+    // Write the result in place, it does not allocate.
+    void get_output(const Position *const position,
+                    Netresult &result,
+                    const bool read_cache = true,
+                    const bool write_cache = true);
+
+    // Evaluate many positions in one forward pass. The positions hit
+    // in the cache are not computed again.
+    void get_output_batch(const std::vector<const Position *> &positions,
+                          std::vector<Netresult> &results);
+
     void clear_cache();
 
     void release_nn();
@@ -51,14 +62,28 @@ public:
 private:
     static constexpr auto INTERSECTIONS = Board::INTERSECTIONS;
 
+    // The compact form of Netresult which is stored in the cache. We
+    // only keep the policy of the moves in the movelist.
+    struct CacheEntry {
+        static constexpr auto MAX_MOVES = 128;
+
+        int count;
+        std::array<std::uint16_t, MAX_MOVES> maps;
+        std::array<float, MAX_MOVES> policy;
+        std::array<float, WINRATELAYER> winrate_misc;
+    };
+
     bool probe_cache(const Position *const position,
                      Network::Netresult &result);
 
-    Netresult get_output_internal(const Position *const position);
+    void insert_cache(const Position *const position,
+                      const Network::Netresult &result);
+
+    void get_output_internal(const Position *const position, Netresult &result);
   
     Netresult get_output_form_cache(const Position *const position);
 
-    Cache<Netresult> m_cache;
+    Cache<CacheEntry> m_cache;
 
     std::unique_ptr<Model::NNPipe> m_forward;
     std::shared_ptr<Model::NNWeights> m_weights;
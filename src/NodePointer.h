@@ -32,12 +32,10 @@ template<typename Node, typename Data>
 class NodePointer {
 public:
     NodePointer() = default;
-    NodePointer(std::shared_ptr<Data> data);
+    NodePointer(const Data &data);
     NodePointer(const NodePointer &) = delete;
     NodePointer& operator=(const NodePointer&);
 
-    ~NodePointer();
-
     bool is_pointer() const;
     bool is_inflating() const;
     bool is_uninflated() const;
@@ -45,15 +43,26 @@ public:
     Node *read_ptr(uint64_t v) const;
     Node *get() const;
 
-    bool inflate();
-    bool release();
+    // The node is created by the allocator and owned by it. We never
+    // delete it here.
+    template<typename Allocator>
+    bool inflate(Allocator &allocator);
+
+    // Point to the node which is already built. The pointer must
+    // be uninflated.
+    void assign(Node *node);
 
-    std::shared_ptr<Data> data() const;
+    // Point to the other node, the old one is left to its allocator.
+    // No one may inflate the pointer while replacing it.
+    void replace(Node *node);
+
+    Data *data();
+    const Data *data() const;
 
 private:
     bool acquire_inflating();
 
-    std::shared_ptr<Data> m_data{nullptr};
+    Data m_data;
     std::atomic<std::uint64_t> m_pointer{UNINFLATED};
 
     bool is_pointer(std::uint64_t v) const;
@@ -62,15 +71,10 @@ private:
 };
 
 template<typename Node, typename Data>
-inline NodePointer<Node, Data>::NodePointer(std::shared_ptr<Data> data) {
+inline NodePointer<Node, Data>::NodePointer(const Data &data) {
     m_data = data;
 }
 
-template<typename Node, typename Data>
-inline NodePointer<Node, Data>::~NodePointer() {
-    release();
-}
-
 template<typename Node, typename Data>
 inline bool NodePointer<Node, Data>::is_pointer(std::uint64_t v) const {
     return (v & POINTER_MASK) == POINTER;
@@ -123,7 +127,8 @@ inline bool NodePointer<Node, Data>::acquire_inflating() {
 }
 
 template<typename Node, typename Data>
-inline bool NodePointer<Node, Data>::inflate() {
+template<typename Allocator>
+inline bool NodePointer<Node, Data>::inflate(Allocator &allocator) {
     while (true) {
         auto v = m_pointer.load();
         if (is_pointer(v)) {
@@ -134,7 +139,7 @@ inline bool NodePointer<Node, Data>::inflate() {
             continue;
         }
         auto new_pointer =
-            reinterpret_cast<std::uint64_t>(new Node(m_data)) |
+            reinterpret_cast<std::uint64_t>(allocator.new_node(&m_data)) |
             POINTER;
         auto old_pointer = m_pointer.exchange(new_pointer);
         assert(is_inflating(old_pointer));
@@ -143,18 +148,27 @@ inline bool NodePointer<Node, Data>::inflate() {
 }
 
 template<typename Node, typename Data>
-inline bool NodePointer<Node, Data>::release() {
-    auto v = m_pointer.load();
-    if (is_pointer(v)) {
-        delete read_ptr(v);
-        auto pointer = m_pointer.exchange(UNINFLATED);
-        assert(pointer == v);
-        return true;
-    }
-    return false;
+inline void NodePointer<Node, Data>::assign(Node *node) {
+    auto new_pointer = reinterpret_cast<std::uint64_t>(node) | POINTER;
+    auto old_pointer = m_pointer.exchange(new_pointer);
+    assert(is_uninflated(old_pointer));
+    (void) old_pointer;
+}
+
+template<typename Node, typename Data>
+inline void NodePointer<Node, Data>::replace(Node *node) {
+    auto new_pointer = reinterpret_cast<std::uint64_t>(node) | POINTER;
+    auto old_pointer = m_pointer.exchange(new_pointer);
+    assert(!is_inflating(old_pointer));
+    (void) old_pointer;
+}
+
+template<typename Node, typename Data>
+inline Data *NodePointer<Node, Data>::data() {
+    return &m_data;
 }
 
 template<typename Node, typename Data>
-inline std::shared_ptr<Data> NodePointer<Node, Data>::data() const {
-    return m_data;
+inline const Data *NodePointer<Node, Data>::data() const {
+    return &m_data;
 }
@@ -20,10 +20,12 @@
 #include "Utils.h"
 #include "config.h"
 
-#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cctype>
 #include <iostream>
 #include <sstream>
-#include <cassert>
+#include <vector>
 
 void PGNParser::savepgn(std::string filename, Position &pos, PGNRecorder::Format_t fmt) const {
     auto pgn = from_position(pos, fmt);
@@ -44,27 +46,15 @@ void PGNParser::pgn_stream(std::ostream &out, Position &pos, PGNRecorder::Format
 }
 
 void PGNParser::loadpgn(std::string filename, Position &pos) const {
-    auto file = std::ifstream{};
-    auto buffer = std::stringstream{};
-    auto line = std::string{};
-
-    file.open(filename);
-    if (!file.is_open()) {
+    PGNReader reader;
+    if (!reader.open(filename)) {
         Utils::printf<Utils::STATIC>("Could not opne file : %s!\n", filename.c_str());
         return;
     }
 
-    while(std::getline(file, line)) {
-        // We remove all the line break.
-        buffer << line << " ";
-    }
-    file.close();
-
-    auto pgns = std::vector<PGNRecorder>{};
-    from_pgnfile(buffer, pgns);
-
-    if (!pgns.empty()) {
-        auto &pgn = pgns[0];
+    // Only the first game is needed.
+    auto pgn = PGNRecorder{};
+    if (reader.next(pgn)) {
         pos.fen(pgn.start_fen);
 
         for (const auto &m: pgn.moves) {
@@ -74,22 +64,16 @@ void PGNParser::loadpgn(std::string filename, Position &pos) const {
 }
 
 void PGNParser::gather_pgnlist(std::string filename, std::vector<PGNRecorder> &pgns) const {
-    auto file = std::ifstream{};
-    auto buffer = std::stringstream{};
-    auto line = std::string{};
-
-    file.open(filename);
-    if (!file.is_open()) {
+    PGNReader reader;
+    if (!reader.open(filename)) {
         Utils::printf<Utils::STATIC>("Could not opne file : %s!\n", filename.c_str());
         return;
     }
 
-    while(std::getline(file, line)) {
-        // We remove all the line break.
-        buffer << line << " ";
+    auto pgn = PGNRecorder{};
+    while (reader.next(pgn)) {
+        pgns.emplace_back(pgn);
     }
-    file.close();
-    from_pgnfile(buffer, pgns);
 }
 
 std::string PGNParser::get_pgnstring(PGNRecorder pgn) const {
@@ -180,18 +164,16 @@ PGNRecorder PGNParser::from_position(Position &pos, PGNRecorder::Format_t fmt) c
 
     auto pgn = PGNRecorder{};
 
-    auto &history = pos.get_history();
-    assert(!history.empty());
+    const auto size = pos.get_historysize();
+    assert(size >= 1);
 
-    pgn.start_fen = history[0]->get_fenstring();
+    pgn.start_fen = pos.get_history_board(0).get_fenstring();
     pgn.result = pos.get_winner(false);
 
-    if (history.size() >= 2) {
-        for (auto idx = size_t{1}; idx < history.size(); ++idx) {
-            const auto to_move = history[idx-1]->get_to_move();
-            const auto last_move = history[idx]->get_last_move();
-            pgn.moves.emplace_back(to_move, last_move);
-        }
+    for (int idx = 1; idx < size; ++idx) {
+        const auto to_move = pos.get_history_board(idx-1).get_to_move();
+        const auto last_move = pos.get_history_board(idx).get_last_move();
+        pgn.moves.emplace_back(to_move, last_move);
     }
 
     pgn.properties.insert({"Game", "Chinese Chess"});
@@ -215,168 +197,293 @@ PGNRecorder PGNParser::from_position(Position &pos, PGNRecorder::Format_t fmt) c
     return pgn;
 }
 
-void PGNParser::from_pgnfile(std::istream &buffer, std::vector<PGNRecorder> &pgns) const {
-    const auto lambda_property = [](std::istream &buf) -> auto {
-        char c;
-        auto name = std::ostringstream{};
-        auto data = std::ostringstream{};
-        auto quotation = false;
-        while(buf.get(c)) {
-            if (c == ']') {
+PGNReader::PGNReader() {
+    m_pos.init_game(0);
+}
+
+bool PGNReader::open(const std::string &filename) {
+    m_offset = 0;
+    m_games = 0;
+    m_errors = 0;
+    return m_file.open(filename);
+}
+
+void PGNReader::set_properties(std::vector<std::string> names) {
+    m_all_properties = false;
+    m_properties = std::move(names);
+}
+
+bool PGNReader::next(PGNRecorder &pgn) {
+    const char *begin;
+    const char *end;
+    auto cause = std::string{};
+    while (find_game(begin, end)) {
+        ++m_games;
+        if (parse_game(begin, end, pgn, cause)) {
+            return true;
+        }
+        ++m_errors;
+        Utils::printf<Utils::STATIC>("The PGN format is wrong! Game: %zu, Cause: %s.\n",
+                                     m_games, cause.c_str());
+    }
+    return false;
+}
+
+bool PGNReader::next_text(std::string &text) {
+    const char *begin;
+    const char *end;
+    if (!find_game(begin, end)) {
+        return false;
+    }
+    ++m_games;
+    text.assign(begin, end);
+    return true;
+}
+
+bool PGNReader::parse(const std::string &text, PGNRecorder &pgn) {
+    auto cause = std::string{};
+    if (parse_game(text.data(), text.data() + text.size(), pgn, cause)) {
+        return true;
+    }
+    ++m_errors;
+    Utils::printf<Utils::STATIC>("The PGN format is wrong! Cause: %s.\n", cause.c_str());
+    return false;
+}
+
+size_t PGNReader::get_offset() const {
+    return m_offset;
+}
+
+size_t PGNReader::get_size() const {
+    return m_file.size();
+}
+
+size_t PGNReader::get_errors() const {
+    return m_errors;
+}
+
+bool PGNReader::wanted(const char *name, size_t length) const {
+    if (m_all_properties) {
+        return true;
+    }
+    for (const auto &p : m_properties) {
+        if (p.size() == length && std::equal(std::begin(p), std::end(p), name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PGNReader::find_game(const char *&begin, const char *&end) {
+    const auto data = m_file.data();
+    const auto size = m_file.size();
+    auto ptr = data + m_offset;
+    const auto last = data + size;
+
+    while (ptr < last && std::isspace(static_cast<unsigned char>(*ptr))) {
+        ++ptr;
+    }
+    if (ptr >= last) {
+        m_offset = size;
+        return false;
+    }
+
+    // A game begins with its properties. The property after the moves is
+    // the beginning of the next game. The comments may cross the lines,
+    // nothing in them begins a game.
+    begin = ptr;
+    auto in_moves = false;
+    auto comment = 0;
+    while (ptr < last) {
+        const auto line = ptr;
+        while (ptr < last && (*ptr == ' ' || *ptr == '\t' || *ptr == '\r')) {
+            ++ptr;
+        }
+        if (ptr < last && *ptr == '[' && comment == 0) {
+            if (in_moves) {
+                ptr = line;
                 break;
-            } else if (isspace(c) && !quotation) {
-                continue;
-            } else if (c == '"') {
-                quotation = !(quotation);
-                continue;
             }
-
-            if (quotation) {
-                data << c;
-            } else {
-                name << c;
+        } else if (ptr < last && *ptr != '\n') {
+            in_moves = true;
+        }
+        while (ptr < last && *ptr != '\n') {
+            if (*ptr == '{') {
+                ++comment;
+            } else if (*ptr == '}' && comment > 0) {
+                --comment;
             }
+            ++ptr;
+        }
+        if (ptr < last) {
+            ++ptr;
+        }
+    }
+    end = ptr;
+    m_offset = ptr - data;
+    return true;
+}
+
+bool PGNReader::parse_game(const char *begin, const char *end,
+                           PGNRecorder &pgn, std::string &cause) {
+    const auto lambda_skip_spaces = [end](const char *ptr) {
+        while (ptr < end && std::isspace(static_cast<unsigned char>(*ptr))) {
+            ++ptr;
+        }
+        return ptr;
+    };
+    const auto lambda_find = [end](const char *ptr, const char c) {
+        while (ptr < end && *ptr != c) {
+            ++ptr;
         }
-        return std::make_pair<std::string, std::string>(name.str(), data.str());
+        return ptr;
     };
 
-    const auto lambda_commit = [](std::istream &buf) -> auto {
-        char c;
-        auto commit = std::ostringstream{};
-        while(buf.get(c)) {
-            if (c == '}') {
-                break;
+    pgn.properties.clear();
+    pgn.moves.clear();
+    pgn.start_fen.clear();
+    pgn.result = Types::INVALID_COLOR;
+
+    auto ptr = lambda_skip_spaces(begin);
+
+    // The properties, like [Name "Value"].
+    while (ptr < end && (*ptr == '[' || *ptr == '{')) {
+        if (*ptr == '{') {
+            const auto close = lambda_find(ptr, '}');
+            if (close >= end) {
+                cause = "Unterminated Comment";
+                return false;
             }
-            commit << c;
+            ptr = lambda_skip_spaces(close + 1);
+            continue;
+        }
+        ptr = lambda_skip_spaces(ptr + 1);
+        const auto name = ptr;
+        while (ptr < end && !std::isspace(static_cast<unsigned char>(*ptr)) &&
+                   *ptr != '"' && *ptr != ']') {
+            ++ptr;
+        }
+        const auto name_size = static_cast<size_t>(ptr - name);
+        const auto close = lambda_find(ptr, ']');
+        if (close >= end) {
+            cause = "Unterminated Property";
+            return false;
         }
-        return commit.str();
-    };
 
-    const auto lambda_move = [](std::string &move, size_t size, PGNRecorder::Format_t fmt) -> auto {
-        auto m = Move{};
-        if (fmt == PGNRecorder::WXF) {
-            // Not complete.
-        } else if (fmt == PGNRecorder::ICCS && size == 5) {
-            int f_x = int(move[0]) - 65;
-            int f_y = int(move[1]) - 48;
-            int t_x = int(move[3]) - 65;
-            int t_y = int(move[4]) - 48;
-            auto fvtx = Board::get_vertex(f_x, f_y);
-            auto tvtx = Board::get_vertex(t_x, t_y);
-            m = Move(fvtx, tvtx);
+        const auto required = (name_size == 3 && std::equal(name, name + 3, "FEN")) ||
+                              (name_size == 6 && std::equal(name, name + 6, "Format")) ||
+                              (name_size == 6 && std::equal(name, name + 6, "Result"));
+        if (required || wanted(name, name_size)) {
+            const auto quote = lambda_find(ptr, '"');
+            auto value = std::string{};
+            if (quote < close) {
+                const auto value_end = std::min(lambda_find(quote + 1, '"'), close);
+                value.assign(quote + 1, value_end);
+            }
+            pgn.properties[std::string(name, name_size)] = std::move(value);
         }
-        return m;
-    };
+        ptr = lambda_skip_spaces(close + 1);
+    }
 
-    auto error = false;
-    auto not_support = false;
-    auto cause = std::string{};
+    const auto format = pgn.properties.find("Format");
+    const auto fen = pgn.properties.find("FEN");
+    const auto result = pgn.properties.find("Result");
+    if (format == std::end(pgn.properties)) {
+        cause = "Lack of Format Lable";
+        return false;
+    }
+    if (fen == std::end(pgn.properties)) {
+        cause = "Lack of FEN Lable";
+        return false;
+    }
+    if (result == std::end(pgn.properties)) {
+        cause = "Lack of Result Lable";
+        return false;
+    }
 
-#define ERROR_HANDLE(proposition, why) \
-    if (!(proposition)) {              \
-        cause = why;                   \
-        error = true;                  \
-        break;                         \
+    if (format->second == "WXF") {
+        pgn.format = PGNRecorder::WXF;
+        cause = "WXF Format Not Support";
+        return false;
+    } else if (format->second == "ICCS") {
+        pgn.format = PGNRecorder::ICCS;
+    } else {
+        cause = "Illegal Format";
+        return false;
     }
 
-#define NOT_SUPPORT_HANDLE(proposition, why) \
-    if (!(proposition)) {                    \
-        cause = why;                         \
-        not_support = true;                  \
-        break;                               \
+    pgn.start_fen = fen->second;
+    m_pos.init_game(0);
+    if (!m_pos.fen(pgn.start_fen)) {
+        cause = "Illegal FEN Format";
+        return false;
     }
 
-    char c;
-    auto cnt = size_t{0};
-    auto property_step = false;
-    auto pgn = std::make_shared<PGNRecorder>();
-    auto temp_stream = std::ostringstream{};
-    auto pos = std::make_shared<Position>();
-    pgn = nullptr;
+    if (result->second == "1-0") {
+        pgn.result = Types::RED;
+    } else if (result->second == "0-1") {
+        pgn.result = Types::BLACK;
+    } else if (result->second == "1/2-1/2") {
+        pgn.result = Types::EMPTY_COLOR;
+    } else if (result->second == "*") {
+        pgn.result = Types::INVALID_COLOR;
+    } else {
+        cause = "Illegal Result Format";
+        return false;
+    }
 
-    while(buffer.get(c)) {
-        if (c == '[') {
-            if (!property_step) {
-                if (pgn) {
-                    pgns.emplace_back(*pgn);
-                }
-                pos->init_game(0);
-                pgn = std::make_shared<PGNRecorder>();
-                property_step = true;
-            }
-            pgn->properties.insert(lambda_property(buffer));
-        } else if (c == '{') {
-            lambda_commit(buffer); // unused
-        } else if (isspace(c)) {
-            if (cnt > 0) {
-                auto temp = temp_stream.str();
-                if (temp.find(".") != std::string::npos) {
-                    // Do nothing.
-                } else if (cnt == 4 || cnt == 5) {
-                    auto move = lambda_move(temp, cnt, pgn->format);
-                    auto to_move = pos->get_to_move();
-
-                    ERROR_HANDLE(move.valid(), "Invalid Move List")
-                    ERROR_HANDLE(pos->do_move(move), "Illegal Move List")
-
-                    pgn->moves.emplace_back(to_move, move);
-                } else if (cnt == 1 || cnt == 3 || cnt == 5) {
-                    ERROR_HANDLE((pgn->properties["Result"] == temp), "Wrong Result");
-                }
-                temp_stream = std::ostringstream{};
-                cnt = 0;
+    // The moves, like "1. H2-E2 H9-G7". The comments are skipped.
+    while (ptr < end) {
+        ptr = lambda_skip_spaces(ptr);
+        if (ptr >= end) {
+            break;
+        }
+        if (*ptr == '{') {
+            const auto close = lambda_find(ptr, '}');
+            if (close >= end) {
+                cause = "Unterminated Comment";
+                return false;
             }
-        } else {
-            if (property_step) {
-                property_step = false;
-
-                ERROR_HANDLE(pgn->properties.find("Format") != std::end(pgn->properties), "Lack of Format Lable");
-                ERROR_HANDLE(pgn->properties.find("FEN") != std::end(pgn->properties), "Lack of FEN Lable");
-                ERROR_HANDLE(pgn->properties.find("Result") != std::end(pgn->properties), "Lack of Result Lable");
-
-                if (pgn->properties["Format"] == "WXF") {
-                    pgn->format = PGNRecorder::WXF;
-                    NOT_SUPPORT_HANDLE(false, "WXF Format Not Support");
-                } else if (pgn->properties["Format"] == "ICCS") {
-                    pgn->format = PGNRecorder::ICCS;
-                } else {
-                    ERROR_HANDLE(pos->fen(pgn->start_fen), "Illegal Format")
-                }
+            ptr = close + 1;
+            continue;
+        }
 
-                pgn->start_fen = pgn->properties["FEN"];
-                ERROR_HANDLE(pos->fen(pgn->start_fen), "Illegal FEN Format")
-
-                if (pgn->properties["Result"] == "1-0") {
-                    pgn->result = Types::RED;
-                } else if (pgn->properties["Result"] == "0-1") {
-                    pgn->result = Types::BLACK;
-                } else if (pgn->properties["Result"] == "1/2-1/2") {
-                    pgn->result = Types::EMPTY_COLOR;
-                } else if (pgn->properties["Result"] == "*") {
-                    pgn->result = Types::INVALID_COLOR;
-                } else {
-                    ERROR_HANDLE(false, "Illegal Result Format")
+        const auto token = ptr;
+        while (ptr < end && !std::isspace(static_cast<unsigned char>(*ptr)) && *ptr != '{') {
+            ++ptr;
+        }
+        const auto size = static_cast<size_t>(ptr - token);
+
+        if (std::find(token, ptr, '.') != ptr) {
+            // The move number.
+        } else if (size == 4 || size == 5) {
+            auto move = Move{};
+            if (size == 5) {
+                const auto f_x = int(token[0]) - 65;
+                const auto f_y = int(token[1]) - 48;
+                const auto t_x = int(token[3]) - 65;
+                const auto t_y = int(token[4]) - 48;
+                if (f_x >= 0 && f_x < Board::WIDTH && f_y >= 0 && f_y < Board::HEIGHT &&
+                        t_x >= 0 && t_x < Board::WIDTH && t_y >= 0 && t_y < Board::HEIGHT) {
+                    move = Move(Board::get_vertex(f_x, f_y), Board::get_vertex(t_x, t_y));
                 }
             }
-            temp_stream << c;
-            cnt++;
+            const auto to_move = m_pos.get_to_move();
+            if (!move.valid()) {
+                cause = "Invalid Move List";
+                return false;
+            }
+            if (!m_pos.do_move(move)) {
+                cause = "Illegal Move List";
+                return false;
+            }
+            pgn.moves.emplace_back(to_move, move);
+        } else if (size == 1 || size == 3) {
+            if (result->second.compare(0, std::string::npos, token, size) != 0) {
+                cause = "Wrong Result";
+                return false;
+            }
         }
     }
-
-#undef NOT_SUPPORT_HANDLE
-#undef ERROR_HANDLE
-
-    if (pgn) {
-        pgns.emplace_back(*pgn);
-    }
-    if (error) {
-        Utils::printf<Utils::STATIC>("The PGN format is wrong! Games: %zu, Cause: %s.\n",
-                                     pgns.size(), cause.c_str());
-        pgns.clear();
-    }
-    if (not_support) {
-        Utils::printf<Utils::STATIC>("The PGN format is not support! Games: %zu, Cause: %s.\n",
-                                     pgns.size(), cause.c_str());
-        pgns.clear();
-    }
+    return true;
 }
@@ -16,13 +16,19 @@
     along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#ifndef PGNPARSER_H_INCLUDE
+#define PGNPARSER_H_INCLUDE
+
 #include "Position.h"
 #include "BitBoard.h"
 #include "Types.h"
+#include "Utils.h"
 
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 struct PGNRecorder {
     enum Format_t { WXF, ICCS };
@@ -39,6 +45,63 @@ struct PGNRecorder {
     Format_t format;
 };
 
+/*
+ * Read the games one by one from the mapped PGN file. Nothing is parsed
+ * before it is asked for, so the first game is ready immediately and the
+ * memory does not grow with the file.
+ *
+ *     auto reader = PGNReader{};
+ *     reader.open(filename);
+ *     auto pgn = PGNRecorder{};
+ *     while (reader.next(pgn)) { ... }
+ *
+ * The wrong games are reported and skipped. The FEN, Format and Result
+ * properties are always read, the other ones are only kept if they are
+ * wanted, see set_properties().
+ */
+class PGNReader {
+public:
+    PGNReader();
+
+    bool open(const std::string &filename);
+
+    // Only keep these properties. Keep all of them by default.
+    void set_properties(std::vector<std::string> names);
+
+    // Read the next correct game. Return false at the end of the file.
+    bool next(PGNRecorder &pgn);
+
+    // Get the text of the next game without parsing it. Return false
+    // at the end of the file.
+    bool next_text(std::string &text);
+
+    // Parse the game from the text of next_text().
+    bool parse(const std::string &text, PGNRecorder &pgn);
+
+    // The bytes of the file we have passed, for the progress.
+    size_t get_offset() const;
+    size_t get_size() const;
+
+    size_t get_errors() const;
+
+private:
+    bool find_game(const char *&begin, const char *&end);
+    bool parse_game(const char *begin, const char *end,
+                    PGNRecorder &pgn, std::string &cause);
+    bool wanted(const char *name, size_t length) const;
+
+    Utils::MappedFile m_file;
+    size_t m_offset{0};
+    size_t m_games{0};
+    size_t m_errors{0};
+
+    bool m_all_properties{true};
+    std::vector<std::string> m_properties;
+
+    // Check the moves are legal.
+    Position m_pos;
+};
+
 class PGNParser {
 public:
     void savepgn(std::string filename, Position &pos, PGNRecorder::Format_t fmt = PGNRecorder::ICCS) const;
@@ -50,6 +113,6 @@ public:
 private:
     std::string get_pgnstring(PGNRecorder pgn) const;
     PGNRecorder from_position(Position &pos, PGNRecorder::Format_t fmt) const;
-
-    void from_pgnfile(std::istream &buffer, std::vector<PGNRecorder> &pgns) const;
 };
+
+#endif
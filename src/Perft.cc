@@ -0,0 +1,203 @@
+/*
+    This file is part of ElephantArt.
+    Copyright (C) 2021 Hung-Zhe Lin
+
+    ElephantArt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ElephantArt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Perft.h"
+#include "Utils.h"
+
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+struct PerftPosition {
+    const char *fen;
+
+    // The known legal node counts, from depth 1.
+    std::vector<std::uint64_t> nodes;
+};
+
+static const std::vector<PerftPosition> perft_positions = {
+    {"rnbakabnr/9/1c5c1/p1p1p1p1p/9/9/P1P1P1P1P/1C5C1/9/RNBAKABNR w - - 0 1",
+        {44, 1920, 79666, 3290240, 133312995}},
+    {"r1ba1a3/4kn3/2n1b4/pNp1p1p1p/4c4/6P2/P1P2R2P/1CcC5/9/2BAKAB2 w - - 0 1",
+        {38, 1128, 43929, 1339047}},
+    {"1cbak4/9/n2a5/2p1p3p/5cp2/2n2N3/6PCP/3AB4/2C6/3A1K1N1 w - - 0 1",
+        {7, 281, 8620, 326201}},
+    {"5a3/3k5/3aR4/9/5r3/5n3/9/3A1A3/5K3/2BC2B2 w - - 0 1",
+        {25, 424, 9850, 202884}},
+    {"CRN1k1b2/3ca4/4ba3/9/2nr5/9/9/4B4/4A4/4KA3 w - - 0 1",
+        {28, 516, 14808, 395483}},
+    {"R1N1k1b2/9/3aba3/9/2nr5/2B6/9/4B4/4A4/4KA3 w - - 0 1",
+        {21, 364, 7626, 162837}},
+    {"C1nNk4/9/9/9/9/9/n1pp5/B3C4/9/3A1K3 w - - 0 1",
+        {28, 222, 6241, 64971}},
+    {"4ka3/4a4/9/9/4N4/p8/9/4C3c/7n1/2BK5 w - - 0 1",
+        {23, 345, 8124, 149272}},
+    {"2b1ka3/9/b3N4/4n4/9/9/9/4C4/2p6/2BK5 w - - 0 1",
+        {21, 195, 3883, 48060}},
+    {"1C2ka3/9/C1Nab1n2/p3p3p/6p2/9/P3P3P/3AB4/3p2c2/c1BAK4 w - - 0 1",
+        {30, 830, 22787, 649866}},
+    {"CnN1k1b2/c3a4/4ba3/9/2nr5/9/9/4C4/4A4/4KA3 w - - 0 1",
+        {19, 583, 11714, 376467}},
+};
+
+Perft::Result Perft::legal(const Board &board, const int depth) {
+    auto result = Result{};
+    if (depth <= 0) {
+        result.nodes = 1;
+        return result;
+    }
+
+    auto movelist = MoveList{};
+    board.generate_legal_moves(movelist);
+
+    for (const auto &move : movelist) {
+        if (depth == 1) {
+            const auto pt = board.get_piece_type(move.get_from());
+            result.nodes++;
+            result.piece_nodes[pt]++;
+        } else {
+            auto next = board;
+            next.do_move_assume_legal(move);
+            const auto sub = legal(next, depth-1);
+            result.nodes += sub.nodes;
+            for (auto pt = size_t{0}; pt < result.piece_nodes.size(); ++pt) {
+                result.piece_nodes[pt] += sub.piece_nodes[pt];
+            }
+        }
+    }
+    return result;
+}
+
+std::uint64_t Perft::pseudo(const Board &board, const int depth) {
+    if (depth <= 0) {
+        return 1;
+    }
+
+    const auto kings = board.get_kings();
+    if (kings[Types::RED] == Types::NO_VERTEX ||
+            kings[Types::BLACK] == Types::NO_VERTEX) {
+        return 1;
+    }
+
+    auto movelist = MoveList{};
+    board.generate_movelist(board.get_to_move(), movelist);
+    if (depth == 1) {
+        return movelist.size();
+    }
+
+    auto nodes = std::uint64_t{0};
+    for (const auto &move : movelist) {
+        auto next = board;
+        next.do_move_assume_legal(move);
+        nodes += pseudo(next, depth-1);
+    }
+    return nodes;
+}
+
+std::string Perft::divide(const Board &board, const int depth) {
+    auto out = std::ostringstream{};
+    auto movelist = MoveList{};
+    board.generate_legal_moves(movelist);
+
+    auto timer = Utils::Timer{};
+    auto total = std::uint64_t{0};
+    for (const auto &move : movelist) {
+        auto next = board;
+        next.do_move_assume_legal(move);
+        const auto nodes = legal(next, depth-1).nodes;
+        total += nodes;
+        out << move.to_string() << ": " << nodes << std::endl;
+    }
+
+    const auto elapsed = timer.get_duration_microseconds();
+    out << std::endl;
+    out << "Nodes searched: " << total << std::endl;
+    out << "Time: " << elapsed / 1000 << " ms" << std::endl;
+    if (elapsed > 0) {
+        out << "Nodes/second: " << total * 1000000 / elapsed << std::endl;
+    }
+    return out.str();
+}
+
+bool Perft::bench(std::ostream &out, const int max_depth) {
+    const auto lambda_nps = [](std::uint64_t nodes, int microseconds) -> std::uint64_t {
+        return microseconds > 0 ? nodes * 1000000 / microseconds : 0;
+    };
+    const char *piece_names[] = {"pawn", "cannon", "rook", "horse", "elephant", "advisor", "king"};
+
+    auto all_correct = true;
+    auto total_legal = std::uint64_t{0};
+    auto total_pseudo = std::uint64_t{0};
+    auto legal_time = 0;
+    auto pseudo_time = 0;
+    auto piece_total = std::array<std::uint64_t, Types::PIECE_T_NB>{};
+
+    auto idx = 0;
+    for (const auto &test : perft_positions) {
+        auto board = Board{};
+        auto fen = std::string{test.fen};
+        board.reset_board();
+        board.fen2board(fen);
+
+        const auto depth = std::min(max_depth, static_cast<int>(test.nodes.size()));
+        const auto expected = test.nodes[depth-1];
+
+        auto timer = Utils::Timer{};
+        const auto result = legal(board, depth);
+        const auto l_time = timer.get_duration_microseconds();
+
+        timer.clock();
+        const auto pseudo_nodes = pseudo(board, depth);
+        const auto p_time = timer.get_duration_microseconds();
+
+        const auto correct = result.nodes == expected;
+        all_correct &= correct;
+
+        out << "Position " << ++idx << ": " << test.fen << std::endl;
+        out << "  depth " << depth
+            << ", legal " << result.nodes
+            << " (expected " << expected << ", " << (correct ? "OK" : "FAIL") << ")"
+            << ", " << lambda_nps(result.nodes, l_time) << " nps"
+            << std::endl;
+        out << "  pseudo " << pseudo_nodes
+            << ", " << lambda_nps(pseudo_nodes, p_time) << " nps"
+            << std::endl;
+
+        total_legal += result.nodes;
+        total_pseudo += pseudo_nodes;
+        legal_time += l_time;
+        pseudo_time += p_time;
+        for (auto pt = size_t{0}; pt < piece_total.size(); ++pt) {
+            piece_total[pt] += result.piece_nodes[pt];
+        }
+    }
+
+    out << std::endl;
+    out << "Leaf nodes by piece:" << std::endl;
+    for (auto pt = size_t{0}; pt < piece_total.size(); ++pt) {
+        out << "  " << std::setw(8) << std::left << piece_names[pt]
+            << " " << piece_total[pt] << std::endl;
+    }
+    out << "Total legal: " << total_legal
+        << ", " << lambda_nps(total_legal, legal_time) << " nps" << std::endl;
+    out << "Total pseudo: " << total_pseudo
+        << ", " << lambda_nps(total_pseudo, pseudo_time) << " nps" << std::endl;
+    out << (all_correct ? "All node counts are correct." : "Some node counts are WRONG!") << std::endl;
+
+    return all_correct;
+}
@@ -0,0 +1,60 @@
+/*
+    This file is part of ElephantArt.
+    Copyright (C) 2021 Hung-Zhe Lin
+
+    ElephantArt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ElephantArt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PERFT_H_INCLUDE
+#define PERFT_H_INCLUDE
+
+#include "Board.h"
+#include "Types.h"
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*
+ * Counting the leaf nodes of the move generation tree. It is the
+ * correctness and speed harness of the move generator.
+ *
+ * The legal perft removes the moves which leave the own king being
+ * captured, including the flying king. It is the same as the common
+ * Xiangqi perft, so the node counts can be compared with other engines.
+ * The pseudo perft counts every move the generator produces. It stops
+ * at the positions where one king is already captured.
+ */
+class Perft {
+public:
+    struct Result {
+        std::uint64_t nodes{0};
+
+        // Leaf nodes split by the moving piece.
+        std::array<std::uint64_t, Types::PIECE_T_NB> piece_nodes{};
+    };
+
+    static Result legal(const Board &board, const int depth);
+    static std::uint64_t pseudo(const Board &board, const int depth);
+
+    // The legal node count of each root move.
+    static std::string divide(const Board &board, const int depth);
+
+    // Run the test positions and check the known node counts.
+    // Return false if any count is wrong.
+    static bool bench(std::ostream &out, const int max_depth);
+};
+
+#endif
@@ -27,6 +27,8 @@
 void Position::init_game(const int tag) {
     m_startboard = 0;
     position_hash = Zobrist::zobrist_positions[tag];
+    m_shared_history.reset();
+    m_shared_size = 0;
     m_history.clear();
     board.reset_board();
     push_board();
@@ -48,7 +50,7 @@ void Position::do_resigned() {
 }
 
 void Position::push_board() {
-    m_history.emplace_back(std::make_shared<const Board>(board));
+    m_history.emplace_back(board);
 }
 
 bool Position::fen(std::string &fen) {
@@ -59,6 +61,8 @@ bool Position::fen(std::string &fen) {
         return false;
     }
 
+    m_shared_history.reset();
+    m_shared_size = 0;
     m_history.clear();
     m_startboard = 0;
 
@@ -77,7 +81,7 @@ void Position::do_move_assume_legal(Move move) {
     compute_repetitions();
     push_board();
     if (is_capture()) {
-        m_startboard = m_history.size() - 1;
+        m_startboard = get_historysize() - 1;
     }
 }
 
@@ -100,13 +104,18 @@ bool Position::do_textmove(std::string smove) {
 }
 
 bool Position::undo_move() {
-    const auto size = m_history.size();
+    const auto size = get_historysize();
     assert(size >= 1);
     if (size == 1) {
         return false;
     }
-    m_history.resize(size-1);
-    board = *m_history[size-2];
+    if (m_history.empty()) {
+        // Just shrink the visible part, the shared boards are never changed.
+        m_shared_size--;
+    } else {
+        m_history.pop_back();
+    }
+    board = get_history_board(size-2);
     return true;
 }
 
@@ -119,8 +128,8 @@ bool Position::undo_move(int moves_age) {
 }
 
 
-std::vector<Move> Position::get_movelist() {
-    auto movelist = std::vector<Move>{};
+MoveList Position::get_movelist() const {
+    auto movelist = MoveList{};
     const auto color = get_to_move();
     board.generate_movelist(color, movelist);
 
@@ -167,7 +176,7 @@ bool Position::position(std::string &fen, std::string &moves) {
             do_move_assume_legal(chain_moves.front());
             chain_moves.pop();
         }
-        assert(m_history.size() == move_cnt + 1);
+        assert(get_historysize() == (int)move_cnt + 1);
     }
 
     return moves_success;
@@ -252,10 +261,35 @@ Types::Piece Position::get_piece(const Types::Vertices vtx) const {
     return board.get_piece(vtx);
 }
 
-const std::shared_ptr<const Board> Position::get_past_board(const int p) const {
-    const auto size = m_history.size();
-    assert(0 <= p && p <= (int)size - 1);
-    return m_history[size - p - 1];
+const Board &Position::get_past_board(const int p) const {
+    const auto size = get_historysize();
+    assert(0 <= p && p <= size - 1);
+    return get_history_board(size - p - 1);
+}
+
+const Board &Position::get_history_board(const int idx) const {
+    assert(0 <= idx && idx < get_historysize());
+    if (idx < m_shared_size) {
+        return (*m_shared_history)[idx];
+    }
+    return m_history[idx - m_shared_size];
+}
+
+void Position::share_history() {
+    if (m_history.empty()) {
+        return;
+    }
+
+    const auto size = get_historysize();
+    auto shared = std::make_shared<std::vector<Board>>();
+    shared->reserve(size);
+    for (int idx = 0; idx < size; ++idx) {
+        shared->emplace_back(get_history_board(idx));
+    }
+
+    m_shared_history = shared;
+    m_shared_size = size;
+    m_history.clear();
 }
 
 void Position::compute_repetitions() {
@@ -265,16 +299,17 @@ void Position::compute_repetitions() {
     bool cutoff = false;
 
     const auto current_hash = board.get_hash();
-    const auto size = m_history.size();
+    const auto size = get_historysize();
 
     for (int idx = size - 2; idx >= m_startboard; idx -= 2) {
-        const auto hash = m_history[idx]->get_hash();
-        if (m_history[idx]->get_repetitions() == 0) {
+        const auto &past_board = get_history_board(idx);
+        const auto hash = past_board.get_hash();
+        if (past_board.get_repetitions() == 0) {
             cutoff = true;
         }
         if (hash == current_hash) {
             cycle_length = size - idx;
-            repetitions = 1 + m_history[idx]->get_repetitions();
+            repetitions = 1 + past_board.get_repetitions();
             if (cutoff) {
                 repetitions = 1;
             }
@@ -315,24 +350,21 @@ bool Position::is_check(const Types::Color color) const {
 
 std::string Position::history_board() const {
     auto out = std::ostringstream{};
-    auto idx = size_t{0};
-    for (const auto &board : m_history) {
-        const auto lastmove = board->get_last_move();
-        out << "Board Index : " << ++idx << std::endl;
+    const auto size = get_historysize();
+    for (int idx = 0; idx < size; ++idx) {
+        const auto &board = get_history_board(idx);
+        const auto lastmove = board.get_last_move();
+        out << "Board Index : " << idx + 1 << std::endl;
         if (option<bool>("using_chinese")) {
-            board->board_stream<Types::CHINESE>(out, lastmove);
+            board.board_stream<Types::CHINESE>(out, lastmove);
         } else {
-            board->board_stream<Types::ASCII>(out, lastmove);
+            board.board_stream<Types::ASCII>(out, lastmove);
         }
     }
     out << std::endl;
     return out.str();
 }
 
-std::vector<std::shared_ptr<const Board>>& Position::get_history() {
-    return m_history;
-}
-
 std::string Position::get_wxfstring(Move m) const {
     return get_wxfstring(m);
 }
@@ -344,5 +376,5 @@ std::string Position::get_fen() const {
 }
 
 int Position::get_historysize() const {
-    return static_cast<int>(m_history.size());
+    return m_shared_size + static_cast<int>(m_history.size());
 }
@@ -46,7 +46,7 @@ public:
     bool gameover(bool searching);
     bool position(std::string &fen, std::string &moves);
 
-    std::vector<Move> get_movelist();
+    MoveList get_movelist() const;
 
     Types::Color get_to_move() const;
     int get_movenum() const;
@@ -64,8 +64,15 @@ public:
     std::uint64_t get_hash() const;
     std::uint64_t calc_hash() const;
 
-    const std::shared_ptr<const Board> get_past_board(const int p) const;
-    std::vector<std::shared_ptr<const Board>>& get_history();
+    // The p-th board before the current one. The 0-th is current board.
+    const Board &get_past_board(const int p) const;
+
+    // The idx-th board from the start of the game.
+    const Board &get_history_board(const int idx) const;
+
+    // Move all boards into the shared history. The copies of this
+    // position share them instead of copying the whole history.
+    void share_history();
     
     bool is_capture() const;
     bool is_check(const Types::Color color) const;
@@ -85,7 +92,13 @@ private:
 
     std::uint64_t position_hash;
     int m_startboard;
-    std::vector<std::shared_ptr<const Board>> m_history;
+
+    // The history is the immutable shared game prefix plus the boards
+    // we played after it. Only the first m_shared_size boards of the
+    // shared history belong to this position.
+    std::shared_ptr<const std::vector<Board>> m_shared_history{nullptr};
+    int m_shared_size{0};
+    std::vector<Board> m_history;
 
 };
 
@@ -21,7 +21,8 @@
 
 #include <cassert>
 
-Repetition::Repetition(Position &position) : m_position(position) {}
+Repetition::Repetition(Position &position, ForcedCheckmate::Table *table) :
+    m_position(position), m_table(table) {}
 
 Repetition::Result Repetition::judge() {
     const auto repetitions = m_position.get_repetitions();
@@ -31,22 +32,20 @@ Repetition::Result Repetition::judge() {
         return NONE;
     }
 
-    auto &history = m_position.get_history();
-    const auto size = history.size();
     const auto last_move = m_position.get_last_move();
     const auto to_move = m_position.get_to_move();
 
     int my_ckecking_cnt = 0;
     int opp_ckecking_cnt = 0;
 
-    assert(history[size - 2]->get_repetitions() == 1);
+    assert(m_position.get_past_board(1).get_repetitions() == 1);
 
     if (m_position.is_check(to_move)) {
         ++my_ckecking_cnt;
         for (int i = 1; i < cycle_length; ++i) {
-            auto &board = history[history.size() - i - 1];
-            if (!board->is_check(board->get_to_move())) {
-                to_move == board->get_to_move() ? ++my_ckecking_cnt : ++opp_ckecking_cnt;
+            const auto &board = m_position.get_past_board(i);
+            if (!board.is_check(board.get_to_move())) {
+                to_move == board.get_to_move() ? ++my_ckecking_cnt : ++opp_ckecking_cnt;
             }
         }
         if (my_ckecking_cnt == cycle_length/2) {
@@ -58,7 +57,7 @@ Repetition::Result Repetition::judge() {
         }
     }
 
-    auto forced = ForcedCheckmate(m_position);
+    auto forced = ForcedCheckmate(m_position, m_table);
     auto ch_move = forced.find_checkmate();
 
     int forced_cnt = 0;
@@ -67,10 +66,9 @@ Repetition::Result Repetition::judge() {
         ++forced_cnt;
         for (int i = 1; i < cycle_length; i+=2) {
             pos_fork->undo_move(2);
-            auto &board = history[history.size() - i - 1];
-            assert(to_move == board->get_to_move());
+            assert(to_move == m_position.get_past_board(i).get_to_move());
 
-            auto pforced = ForcedCheckmate(*pos_fork);
+            auto pforced = ForcedCheckmate(*pos_fork, m_table);
             if (pforced.find_checkmate().valid()) {
                 ++forced_cnt;
             }
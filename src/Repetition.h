@@ -19,17 +19,19 @@
 #ifndef REPETITION_H_INCLUDE
 #define REPETITION_H_INCLUDE
 #include "Position.h"
+#include "ForcedCheckmate.h"
 
 class Repetition {
 public:
     enum Result { NONE = 0, DRAW, LOSE, UNKNOWN };
 
-    Repetition(Position &position);
+    Repetition(Position &position, ForcedCheckmate::Table *table = nullptr);
 
     Result judge();
 
 private:
     Position &m_position;
+    ForcedCheckmate::Table *m_table;
 };
 
 #endif
@@ -35,11 +35,14 @@ Search::Search(Position &position, Network &network, Train &train) :
     m_parameters = std::make_shared<SearchParameters>();
 
     const auto t = m_parameters->threads;
-    m_searchpool.initialize(t);
+    m_searchpool.initialize(t, m_parameters->thread_affinity);
     m_threadGroup = std::make_unique<ThreadGroup<void>>(m_searchpool);
 
     m_maxplayouts = m_parameters->playouts;
     m_maxvisits = m_parameters->visits;
+
+    m_mate_table.resize(option<int>("cache_moves") * m_maxplayouts);
+    m_arena = std::make_unique<UCTNodeArena>(m_parameters, &m_mate_table);
 }
 
 std::shared_ptr<SearchParameters> Search::parameters() {
@@ -102,12 +105,24 @@ void Search::play_simulation(Position &currpos, UCTNode *const node,
 
     if (node->has_children() && !search_result.valid()) {
         auto color = currpos.get_to_move();
-        auto next = node->uct_select_child(color, node == root_node);
-        auto maps = next->get_maps();
+        auto &child = node->uct_select_child(color, node == root_node);
+        auto maps = child.data()->maps;
         auto move = Decoder::maps2move(maps);
         currpos.do_move_assume_legal(move);
-        play_simulation(currpos, next, root_node, search_result, depth);
+
+        auto next = node->inflate_child(child, currpos);
+        if (node->can_borrow_evals(child)) {
+            // A transposition, searched from the other parents. Back up
+            // its evaluation instead of going deeper.
+            search_result.from_nn_evals(next->get_mean_evals());
+        } else {
+            play_simulation(currpos, next, root_node, search_result, depth);
+        }
         ++depth;
+
+        if (search_result.valid()) {
+            node->update_edge(child);
+        }
     }
 
     if (search_result.valid()) {
@@ -117,9 +132,117 @@ void Search::play_simulation(Position &currpos, UCTNode *const node,
     node->decrement_threads();
 }
 
+bool Search::select_leaf(BatchLeaf &leaf) {
+    leaf.position = m_rootposition;
+    leaf.path.clear();
+    leaf.result = SearchResult{};
+    leaf.evaluate = false;
+    leaf.depth = 0;
+
+    auto node = m_rootnode;
+    while (true) {
+        node->increment_threads();
+        leaf.path.emplace_back(node, nullptr);
+
+        if (node->expandable()) {
+            if (leaf.position.gameover(true)) {
+                leaf.result.from_gameover(leaf.position);
+                node->apply_evals(leaf.result.nn_evals());
+                return true;
+            }
+            if (node->begin_expanding()) {
+                // The node is ours. It is expanded after the batch is
+                // evaluated.
+                leaf.evaluate = true;
+                return true;
+            }
+        }
+
+        if (!node->has_children()) {
+            // The other playout is expanding it. Remove the virtual loss
+            // and give up the leaf.
+            for (auto &p : leaf.path) {
+                p.first->decrement_threads();
+            }
+            leaf.path.clear();
+            return false;
+        }
+
+        const auto color = leaf.position.get_to_move();
+        auto &child = node->uct_select_child(color, node == m_rootnode);
+        const auto move = Decoder::maps2move(child.data()->maps);
+        leaf.position.do_move_assume_legal(move);
+        leaf.path.back().second = &child;
+        ++leaf.depth;
+
+        auto next = node->inflate_child(child, leaf.position);
+        if (node->can_borrow_evals(child)) {
+            leaf.result.from_nn_evals(next->get_mean_evals());
+            return true;
+        }
+        node = next;
+    }
+}
+
+void Search::play_batch(std::vector<BatchLeaf> &batch, int &depth) {
+    thread_local auto positions = std::vector<const Position *>{};
+    thread_local auto results = std::vector<Network::Netresult>{};
+
+    const auto batch_size = m_parameters->leaf_batch;
+    if (static_cast<int>(batch.size()) < batch_size) {
+        batch.resize(batch_size);
+    }
+
+    // Too many collisions mean the tree is too narrow for the batch.
+    // Evaluate what we have.
+    auto leaves = 0;
+    auto collisions = 0;
+    while (leaves < batch_size && collisions < batch_size && is_running()) {
+        if (select_leaf(batch[leaves])) {
+            ++leaves;
+        } else {
+            ++collisions;
+        }
+    }
+
+    positions.clear();
+    for (int i = 0; i < leaves; ++i) {
+        if (batch[i].evaluate) {
+            positions.emplace_back(&batch[i].position);
+        }
+    }
+    if (!positions.empty()) {
+        m_network.get_output_batch(positions, results);
+    }
+
+    auto idx = size_t{0};
+    for (int i = 0; i < leaves; ++i) {
+        auto &leaf = batch[i];
+        if (leaf.evaluate) {
+            auto node = leaf.path.back().first;
+            node->expend_children(results[idx++], leaf.position, get_min_psa_ratio());
+            leaf.result.from_nn_evals(node->get_node_evals());
+        }
+
+        const auto evals = leaf.result.nn_evals();
+        for (auto it = std::rbegin(leaf.path); it != std::rend(leaf.path); ++it) {
+            if (it->second != nullptr) {
+                it->first->update_edge(*it->second);
+            }
+            it->first->update(evals);
+            it->first->decrement_threads();
+        }
+        depth = std::max(depth, leaf.depth);
+        increment_playouts();
+    }
+}
+
 Move Search::uct_move() {
     auto info = SearchInformation{};
-    auto setting = SearchSetting{};
+    return uct_move(SearchSetting{}, info);
+}
+
+Move Search::uct_move(SearchSetting setting, SearchInformation &info) {
     think(setting, &info);
     // Wait the thread running finish.
     m_threadGroup->wait_all();
@@ -128,16 +251,67 @@ Move Search::uct_move() {
 }
 
 Move Search::uct_best_move() const {
-    const auto maps = m_rootnode->get_best_move();
+    auto maps = m_rootnode->get_best_move();
+
+    // Play the first moves proportionally to the visits, so the
+    // self-play games are not all the same.
+    if (m_rootposition.get_gameply() < option<int>("random_move_cnt")) {
+        const auto random_maps = m_rootnode->randomize_first_proportionally(1.0f);
+        if (random_maps != -1) {
+            maps = random_maps;
+        }
+    }
     return Decoder::maps2move(maps);
 }
 
+UCTNode *Search::find_subtree() {
+    if (m_rootnode == nullptr) {
+        return nullptr;
+    }
+
+    const auto tree_size = m_treeposition.get_historysize();
+    const auto root_size = m_rootposition.get_historysize();
+    const auto distance = root_size - tree_size;
+    if (distance < 0) {
+        return nullptr;
+    }
+
+    // The position of the last tree must be in the history of
+    // the current position.
+    for (int p = 0; p < tree_size; ++p) {
+        const auto tree_hash = m_treeposition.get_past_board(p).get_hash();
+        const auto root_hash = m_rootposition.get_past_board(p + distance).get_hash();
+        if (tree_hash != root_hash) {
+            return nullptr;
+        }
+    }
+
+    // Follow the moves which were played after the last search.
+    auto node = m_rootnode;
+    for (int p = distance - 1; p >= 0 && node; --p) {
+        const auto move = m_rootposition.get_past_board(p).get_last_move();
+        node = node->find_child(Decoder::move2maps(move));
+    }
+    return node;
+}
+
 void Search::prepare_uct() {
-    auto data = std::make_shared<UCTNodeData>();
-    m_nodestats = std::make_shared<UCTNodeStats>();
-    data->parameters = m_parameters;
-    data->node_status = m_nodestats;
-    m_rootnode = new UCTNode(data);
+    const auto subtree = m_parameters->reuse_tree ? find_subtree() : nullptr;
+
+    if (m_release_thread.joinable()) {
+        m_release_thread.join();
+    }
+
+    // The reused nodes keep more and more old generations alive. Copy
+    // them into the new one once in a while, so all the old ones are
+    // released.
+    const auto compact = m_arena->get_generations() >= UCTNodeArena::MAX_GENERATIONS;
+
+    // The last tree stays in the old generations. We build the new
+    // tree in the new one.
+    m_arena->new_generation();
+    m_rootnode = m_arena->new_root();
+    m_treeposition = m_rootposition;
 
     set_playouts(0);
     set_running(true);
@@ -150,6 +324,18 @@ void Search::prepare_uct() {
     const auto nn_eval = m_rootnode->get_node_evals();
     m_rootnode->update(std::make_shared<UCTNodeEvals>(nn_eval));
 
+    // The root is always expanded again, so it gets the root only
+    // pruning and noise. Only the subtrees under it are reused.
+    auto reused_visits = 0;
+    if (subtree && compact) {
+        reused_visits = m_rootnode->copy_children(subtree);
+    } else if (subtree) {
+        reused_visits = m_rootnode->promote_children(subtree);
+    }
+
+    const auto root = m_rootnode;
+    m_release_thread = std::thread([this, root]() { m_arena->release(root); });
+
     const auto color = m_rootposition.get_to_move();
     const auto stm_eval = color == Types::RED ? nn_eval.red_stmeval : 1 - nn_eval.red_stmeval;
     const auto winloss = color == Types::RED ? nn_eval.red_winloss : 1 - nn_eval.red_winloss;
@@ -158,20 +344,20 @@ void Search::prepare_uct() {
         Utils::printf<Utils::STATIC>("  stm eval: %.2f%\n", stm_eval * 100.f);
         Utils::printf<Utils::STATIC>("  winloss: %.2f%\n", winloss * 100.f);
         Utils::printf<Utils::STATIC>("  draw probability: %.2f%\n", nn_eval.draw * 100.f);
+        Utils::printf<Utils::STATIC>("  reused visits: %d\n", reused_visits);
     }
 }
 
 void Search::clear_nodes() {
-    if (m_rootnode) {
-        delete m_rootnode;
-        m_rootnode = nullptr;
-    }
-    if (m_nodestats) {
-        assert(m_nodestats->nodes.load() == 0);
-        assert(m_nodestats->edges.load() == 0);
-        m_nodestats.reset();
-        m_nodestats = nullptr;
+    if (m_release_thread.joinable()) {
+        m_release_thread.join();
     }
+
+    // All nodes live in the arena. We drop the whole tree at once
+    // instead of walking it.
+    m_rootnode = nullptr;
+    m_arena->clear();
+    m_mate_table.clear();
 }
 
 Move Search::nn_direct_move() {
@@ -255,6 +441,10 @@ void Search::think(SearchSetting setting, SearchInformation *info) {
 
     m_threadGroup->wait_all();
     m_rootposition = m_position;
+
+    // The playouts copy the root position. Share the game history, so
+    // they only copy the boards played after the root.
+    m_rootposition.share_history();
     if (m_rootposition.gameover(true)) {
         return;
     }
@@ -265,13 +455,20 @@ void Search::think(SearchSetting setting, SearchInformation *info) {
             std::this_thread::yield();
         }
         increment_threads();
+        auto currpos = Position{};
+        auto batch = std::vector<BatchLeaf>{};
         while(is_running()) {
             auto depth = 0;
-            auto currpos = std::make_unique<Position>(m_rootposition);
-            auto result = SearchResult{};
-            play_simulation(*currpos, m_rootnode, m_rootnode, result, depth);
-            if (result.valid()) {
-                increment_playouts();
+            if (m_parameters->leaf_batch > 1) {
+                play_batch(batch, depth);
+            } else {
+                // Reuse the buffer of the last playout.
+                currpos = m_rootposition;
+                auto result = SearchResult{};
+                play_simulation(currpos, m_rootnode, m_rootnode, result, depth);
+                if (result.valid()) {
+                    increment_playouts();
+                }
             }
         };
         decrement_threads();
@@ -282,6 +479,7 @@ void Search::think(SearchSetting setting, SearchInformation *info) {
         auto maxdepth = 0;
         const auto limitnodes = set.nodes;
         const auto limitdepth = set.depth;
+        const auto limitplayouts = set.playouts;
         auto controller = TimeControl(set.milliseconds,
                                       set.movestogo,
                                       set.increment);
@@ -302,17 +500,25 @@ void Search::think(SearchSetting setting, SearchInformation *info) {
         }
 
         increment_threads();
+        auto currpos = Position{};
+        auto batch = std::vector<BatchLeaf>{};
         while(is_running()) {
             auto depth = 0;
-            auto currpos = std::make_unique<Position>(m_rootposition);
-            auto result = SearchResult{};
-            play_simulation(*currpos, m_rootnode, m_rootnode, result, depth);
-            if (result.valid()) {
-                increment_playouts();
+            if (m_parameters->leaf_batch > 1) {
+                play_batch(batch, depth);
+            } else {
+                // Reuse the buffer of the last playout.
+                currpos = m_rootposition;
+                auto result = SearchResult{};
+                play_simulation(currpos, m_rootnode, m_rootnode, result, depth);
+                if (result.valid()) {
+                    increment_playouts();
+                }
             }
             const auto color = m_rootposition.get_to_move();
             const auto score = (m_rootnode->get_meaneval(color, false) - 0.5f) * 200.0f;
-            const auto nodes = m_nodestats->nodes.load() + m_nodestats->edges.load();
+            const auto nodes = m_arena->node_status()->nodes.load() +
+                                   m_arena->node_status()->edges.load();
             const auto elapsed = timer.get_duration_milliseconds();
             controller.set_score(int(score));
             {
@@ -324,6 +530,7 @@ void Search::think(SearchSetting setting, SearchInformation *info) {
             keep_running &= (!stop_thinking(elapsed, limittime));
             keep_running &= (!(limitnodes < nodes));
             keep_running &= (!(limitdepth < depth));
+            keep_running &= (!(limitplayouts < m_playouts.load()));
             keep_running &= is_running();
             set_running(keep_running);
 
@@ -343,7 +550,9 @@ void Search::think(SearchSetting setting, SearchInformation *info) {
             std::this_thread::yield();
         }
 
-        m_train.gather_probabilities(*m_rootnode, m_rootposition);
+        if (set.collect) {
+            m_train.gather_probabilities(*m_rootnode, m_rootposition);
+        }
 
         const auto elapsed = timer.get_duration();
         const auto move = uct_best_move();
@@ -354,6 +563,7 @@ void Search::think(SearchSetting setting, SearchInformation *info) {
             info->move = move;
             info->seconds = elapsed;
             info->depth = maxdepth;
+            info->winrate = m_rootnode->get_meaneval(m_rootposition.get_to_move(), false);
         }
         if (option<bool>("analysis_verbose")) {
             UCT_Information::dump_stats(m_rootnode, m_rootposition);
@@ -361,7 +571,9 @@ void Search::think(SearchSetting setting, SearchInformation *info) {
             Utils::printf<Utils::STATIC>("  %.4f second(s), %d playout(s), %.2f p/s\n",
                                               elapsed, m_playouts.load(), m_playouts.load()/elapsed);
         }
-        clear_nodes();
+        if (!m_parameters->reuse_tree) {
+            clear_nodes();
+        }
     };
     set_running(true);
     m_threadGroup->add_task(main_worker);
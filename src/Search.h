@@ -23,6 +23,7 @@
 #include <mutex>
 #include <functional>
 #include <limits>
+#include <thread>
 
 #include "SearchParameters.h"
 #include "TimeControl.h"
@@ -31,6 +32,7 @@
 #include "Network.h"
 #include "Position.h"
 #include "UCTNode.h"
+#include "ForcedCheckmate.h"
 #include "Train.h"
 #include "Utils.h"
 #include "config.h"
@@ -75,6 +77,9 @@ public:
     Move move;
     int depth;
     float seconds;
+
+    // The root winrate of the side to move.
+    float winrate{0.5f};
 };
 
 class SearchSetting {
@@ -85,6 +90,11 @@ public:
     int milliseconds{std::numeric_limits<int>::max()};
     int movestogo{0};
     int increment{0};
+
+    // The self-play may search some moves with fewer playouts, they
+    // are not collected as the training data.
+    int playouts{std::numeric_limits<int>::max()};
+    bool collect{true};
 };
 
 class Search {
@@ -96,6 +106,7 @@ public:
     Move nn_direct_move();
     Move random_move();
     Move uct_move();
+    Move uct_move(SearchSetting setting, SearchInformation &info);
     void think(SearchSetting setting, SearchInformation *info);
     void interrupt();
     void ponderhit();
@@ -104,9 +115,28 @@ public:
 private:
     void prepare_uct();
     void clear_nodes();
+    UCTNode *find_subtree();
     void increment_playouts();
     void play_simulation(Position &currpos, UCTNode *const node,
                          UCTNode *const root_node, SearchResult &search_result, int &depth);
+
+    // One leaf of the batched search. The path keeps every node from
+    // the root and the child edge selected from it.
+    struct BatchLeaf {
+        Position position;
+        std::vector<std::pair<UCTNode *, UCTNodePointer *>> path;
+        SearchResult result;
+        bool evaluate{false};
+        int depth{0};
+    };
+
+    // Descend to one leaf with the virtual loss. Return false if the
+    // leaf is being expanded by the other playout.
+    bool select_leaf(BatchLeaf &leaf);
+
+    // Collect the leaves, evaluate them in one forward pass and back
+    // up all of them.
+    void play_batch(std::vector<BatchLeaf> &batch, int &depth);
     float get_min_psa_ratio();
     bool is_running();
     void set_running(bool is_running);
@@ -127,7 +157,12 @@ private:
 
     ThreadPool m_searchpool;
     std::unique_ptr<ThreadGroup<void>> m_threadGroup{nullptr};
-    std::shared_ptr<UCTNodeStats> m_nodestats{nullptr};
+    // The reused nodes of the last search stay in the old generations
+    // of the arena. We free the rest of them in the background.
+    std::unique_ptr<UCTNodeArena> m_arena{nullptr};
+    ForcedCheckmate::Table m_mate_table;
+    std::thread m_release_thread;
+    Position m_treeposition;
 
     int m_maxplayouts;
     int m_maxvisits;
@@ -27,9 +27,13 @@ void SearchParameters::reset() {
     visits             = option<int>("visits");
     playouts           = option<int>("playouts");
     random_min_visits  = option<int>("random_min_visits");
+    leaf_batch         = option<int>("leaf_batch");
 
     dirichlet_noise    = option<bool>("dirichlet_noise");
     ponder             = option<bool>("ponder");
+    reuse_tree         = option<bool>("reuse_tree");
+    transposition      = option<bool>("transposition");
+    thread_affinity    = option<bool>("thread_affinity");
     collect            = option<bool>("collect");
 
     fpu_root_reduction = option<float>("fpu_root_reduction");
@@ -31,9 +31,13 @@ public:
     int visits;
     int playouts;
     int random_min_visits;
+    int leaf_batch;
 
     bool dirichlet_noise;
     bool ponder;
+    bool reuse_tree;
+    bool transposition;
+    bool thread_affinity;
     bool collect;
 
     float fpu_root_reduction;
@@ -19,74 +19,246 @@
 #ifndef SHARED_MUTEX_H_INCLUDE
 #define SHARED_MUTEX_H_INCLUDE
 
+#include <algorithm>
+#include <array>
 #include <atomic>
-#include <thread>
-#include <chrono>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
 
+/*
+ * The reader-writer lock for the tables which are read much more often
+ * than they are written.
+ *
+ * The readers are counted in the per-thread slots, every slot is on its
+ * own cache line. So the readers never write the same line and the read
+ * lock scales with the threads. The writer raises the exclusive flag,
+ * then waits for all slots to drain. The new readers back off while the
+ * flag is up, so the writers are not starved.
+ *
+ * The waiters spin for a short while, then yield, and at last park on
+ * the condition variable until the writer leaves. They don't burn the
+ * CPU while waiting for the long writers.
+ *
+ * Every exclusive acquisition is counted, the writer writes the shared
+ * flag anyway. Only the contended acquisitions are timed, and the read
+ * fast path touches no shared statistics.
+ */
 class SharedMutex {
 public:
+    struct Stats {
+        std::uint64_t exclusive_locks{0};
+        std::uint64_t exclusive_contentions{0};
+        std::uint64_t shared_contentions{0};
+        std::uint64_t exclusive_wait_microseconds{0};
+        std::uint64_t shared_wait_microseconds{0};
+
+        Stats &operator+=(const Stats &other);
+    };
+
     SharedMutex() {};
 
+    SharedMutex(const SharedMutex &) = delete;
+    SharedMutex& operator=(const SharedMutex &) = delete;
+
     void lock();
     void unlock();
 
     void lock_shared();
     void unlock_shared();
 
+    Stats get_stats() const;
+    void clear_stats();
+
 private:
+    static constexpr size_t NUM_SLOTS = 32;
+    static constexpr size_t CACHE_LINE = 64;
+
+    // How many times we spin and yield before parking.
+    static constexpr int SPIN_COUNT = 64;
+    static constexpr int YIELD_COUNT = 16;
+
+    // Aligned, not only padded, so no slot straddles two lines. The
+    // mutex on the heap needs -faligned-new before C++17.
+    struct alignas(CACHE_LINE) Slot {
+        std::atomic<int> readers{0};
+    };
+    static_assert(sizeof(Slot) == CACHE_LINE, "");
+
+    static size_t get_slot_index();
+
     bool acquire_exclusive_lock();
-    int get_shared_counter();
+    bool has_readers() const;
+
+    // Wait until the exclusive flag is down.
+    void wait_exclusive_free();
 
-    void take_break();
+    // Wait until the readers leave.
+    void wait_readers_free();
 
-    std::atomic<int> m_shared_counter{0};
+    std::array<Slot, NUM_SLOTS> m_slots;
     std::atomic<bool> m_exclusive{false};
-    std::chrono::microseconds m_wait_microseconds{0};
+
+    std::atomic<int> m_parked{0};
+    std::mutex m_park_mutex;
+    std::condition_variable m_park_cv;
+
+    std::atomic<std::uint64_t> m_exclusive_locks{0};
+    std::atomic<std::uint64_t> m_exclusive_contentions{0};
+    std::atomic<std::uint64_t> m_shared_contentions{0};
+    std::atomic<std::uint64_t> m_exclusive_wait{0};
+    std::atomic<std::uint64_t> m_shared_wait{0};
 };
 
-inline void SharedMutex::take_break() {
-    std::this_thread::sleep_for(m_wait_microseconds);
+inline SharedMutex::Stats &SharedMutex::Stats::operator+=(const Stats &other) {
+    exclusive_locks += other.exclusive_locks;
+    exclusive_contentions += other.exclusive_contentions;
+    shared_contentions += other.shared_contentions;
+    exclusive_wait_microseconds += other.exclusive_wait_microseconds;
+    shared_wait_microseconds += other.shared_wait_microseconds;
+    return *this;
+}
+
+inline size_t SharedMutex::get_slot_index() {
+    // Hand out the slots to the threads in turn, so the first NUM_SLOTS
+    // threads never share one.
+    static std::atomic<size_t> next_index{0};
+    thread_local const auto index = next_index.fetch_add(1) % NUM_SLOTS;
+    return index;
 }
 
 inline bool SharedMutex::acquire_exclusive_lock() {
     bool expected = false;
-    return m_exclusive.compare_exchange_weak(expected, true);
+    return !m_exclusive.load(std::memory_order_relaxed) &&
+               m_exclusive.compare_exchange_strong(expected, true);
 }
 
-inline int SharedMutex::get_shared_counter() {
-    return m_shared_counter.load();
+inline bool SharedMutex::has_readers() const {
+    for (const auto &slot : m_slots) {
+        if (slot.readers.load() != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void SharedMutex::wait_exclusive_free() {
+    for (int i = 0; i < SPIN_COUNT + YIELD_COUNT; ++i) {
+        if (!m_exclusive.load()) {
+            return;
+        }
+        if (i >= SPIN_COUNT) {
+            std::this_thread::yield();
+        }
+    }
+
+    // The writer holds it for long, sleep until it unlocks. The parked
+    // counter is raised before the flag is checked again, so the writer
+    // either sees us or we see the flag down.
+    std::unique_lock<std::mutex> lock(m_park_mutex);
+    m_parked.fetch_add(1);
+    m_park_cv.wait(lock, [this](){ return !m_exclusive.load(); });
+    m_parked.fetch_sub(1);
+}
+
+inline void SharedMutex::wait_readers_free() {
+    // The readers hold the lock for short, we never park here.
+    auto sleep = std::chrono::microseconds{1};
+    for (int i = 0; has_readers(); ++i) {
+        if (i < SPIN_COUNT) {
+            continue;
+        } else if (i < SPIN_COUNT + YIELD_COUNT) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(sleep);
+            sleep = std::min(sleep * 2, std::chrono::microseconds{1000});
+        }
+    }
 }
 
 inline void SharedMutex::lock() {
+    m_exclusive_locks.fetch_add(1, std::memory_order_relaxed);
+
+    auto contended = false;
+    auto start = std::chrono::steady_clock::time_point{};
     while (!acquire_exclusive_lock()) {
-        take_break();
+        if (!contended) {
+            contended = true;
+            start = std::chrono::steady_clock::now();
+        }
+        wait_exclusive_free();
+    }
+
+    // We own the flag, no new reader comes in. Wait for the old ones.
+    if (has_readers()) {
+        if (!contended) {
+            contended = true;
+            start = std::chrono::steady_clock::now();
+        }
+        wait_readers_free();
     }
-    while (get_shared_counter() > 0) {
-        take_break();
+
+    if (contended) {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::now() - start).count();
+        m_exclusive_contentions.fetch_add(1, std::memory_order_relaxed);
+        m_exclusive_wait.fetch_add(elapsed, std::memory_order_relaxed);
     }
 }
 
 inline void SharedMutex::unlock() {
     m_exclusive.store(false);
+    if (m_parked.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_park_mutex);
+        m_park_cv.notify_all();
+    }
 }
 
 inline void SharedMutex::lock_shared() {
-    while (true) {
-        m_shared_counter.fetch_add(1);
-        if (m_exclusive.load()) {
-            m_shared_counter.fetch_sub(1);
-	    } else {
-		    break;
-        }
-        while (m_exclusive.load()) {
-            take_break();
-        }
+    auto &slot = m_slots[get_slot_index()];
+    slot.readers.fetch_add(1);
+    if (!m_exclusive.load()) {
+        return;
     }
+
+    // A writer is in. Leave the slot, so it is not blocked by us.
+    const auto start = std::chrono::steady_clock::now();
+    do {
+        slot.readers.fetch_sub(1);
+        wait_exclusive_free();
+        slot.readers.fetch_add(1);
+    } while (m_exclusive.load());
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - start).count();
+    m_shared_contentions.fetch_add(1, std::memory_order_relaxed);
+    m_shared_wait.fetch_add(elapsed, std::memory_order_relaxed);
 }
 
 inline void SharedMutex::unlock_shared() {
-    m_shared_counter.fetch_sub(1);
+    // The same thread takes the same slot.
+    m_slots[get_slot_index()].readers.fetch_sub(1);
+}
+
+inline SharedMutex::Stats SharedMutex::get_stats() const {
+    auto stats = Stats{};
+    stats.exclusive_locks = m_exclusive_locks.load(std::memory_order_relaxed);
+    stats.exclusive_contentions = m_exclusive_contentions.load(std::memory_order_relaxed);
+    stats.shared_contentions = m_shared_contentions.load(std::memory_order_relaxed);
+    stats.exclusive_wait_microseconds = m_exclusive_wait.load(std::memory_order_relaxed);
+    stats.shared_wait_microseconds = m_shared_wait.load(std::memory_order_relaxed);
+    return stats;
+}
+
+inline void SharedMutex::clear_stats() {
+    m_exclusive_locks.store(0, std::memory_order_relaxed);
+    m_exclusive_contentions.store(0, std::memory_order_relaxed);
+    m_shared_contentions.store(0, std::memory_order_relaxed);
+    m_exclusive_wait.store(0, std::memory_order_relaxed);
+    m_shared_wait.store(0, std::memory_order_relaxed);
 }
 
 enum class lock_t {
@@ -0,0 +1,56 @@
+/*
+    This file is part of ElephantArt.
+    Copyright (C) 2021 Hung-Zhe Lin
+
+    ElephantArt is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    ElephantArt is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef STATICARRAY_H_INCLUDE
+#define STATICARRAY_H_INCLUDE
+
+#include <cassert>
+#include <cstddef>
+
+/*
+ * Like std::array, but every member is constexpr in C++14, so a table
+ * can be filled by a constexpr function. The tables built this way are
+ * constant initialized into the read only data, they cost nothing at
+ * startup and are shared between the forked engine processes.
+ */
+template<typename T, size_t N>
+struct StaticArray {
+    T m_data[N];
+
+    constexpr T &operator[](size_t idx) {
+        assert(idx < N);
+        return m_data[idx];
+    }
+    constexpr const T &operator[](size_t idx) const {
+        assert(idx < N);
+        return m_data[idx];
+    }
+
+    constexpr T *begin() { return m_data; }
+    constexpr T *end() { return m_data + N; }
+    constexpr const T *begin() const { return m_data; }
+    constexpr const T *end() const { return m_data + N; }
+
+    constexpr T *data() { return m_data; }
+    constexpr const T *data() const { return m_data; }
+
+    static constexpr size_t size() { return N; }
+};
+
+#endif
@@ -31,8 +31,9 @@
 #define THREADPOOL_H_INCLUDE
 
 
+#include <algorithm>
 #include <vector>
-#include <queue>
+#include <deque>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -42,8 +43,27 @@
 #include <stdexcept>
 #include <atomic>
 #include <sstream>
+#include <fstream>
 #include <iostream>
+#include <string>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*
+ * Every worker owns a deque of tasks. The new tasks are spread over the
+ * deques, or go to the own deque if a worker adds them. A worker takes
+ * from the front of its deque, and steals from the back of the others
+ * when it runs out. The shared lock is only taken to sleep or to wake
+ * up the sleeping workers.
+ *
+ * With the affinity, every worker is pinned to one CPU. The CPUs are
+ * ordered node by node, and every pool takes the next free ones, so the
+ * threads of one pool stay on the same NUMA node and the pools of the
+ * concurrent games don't pile up on the same cores.
+ */
 class ThreadPool {
 public:
     ThreadPool() = default;
@@ -54,11 +74,14 @@ public:
     std::future<typename std::result_of<F(Args...)>::type>
     add_task(F&& f, Args&&... args);
 
-    ~ThreadPool();
+    // Add the same task many times, wake up the workers once.
+    template<typename F, typename... Args>
+    std::vector<std::future<typename std::result_of<F(Args...)>::type>>
+    add_tasks(size_t count, F&& f, Args&&... args);
 
-    void add_thread(std::function<void()> initializer);
+    ~ThreadPool();
 
-    void initialize(size_t t);
+    void initialize(size_t t, bool affinity = false);
 
     void quit_all();
 
@@ -74,9 +97,37 @@ private:
     ThreadPool(const ThreadPool&) = delete;
     ThreadPool& operator=(const ThreadPool&) = delete;
 
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    struct WorkerId {
+        const ThreadPool *pool{nullptr};
+        size_t index{0};
+    };
+
+    static WorkerId &current_worker();
+
+    // The CPUs in the NUMA node order.
+    static const std::vector<int> &get_cpu_order();
+    static void bind_cpu(int cpu);
+
+    void add_thread(size_t index, int cpu);
+    void worker_loop(size_t index);
+
+    void check_adding() const;
+    void push_tasks(std::vector<std::function<void()>> &tasks);
+    bool pop_task(size_t index, std::function<void()> &task);
+
     std::vector<std::thread> m_threads;
-    std::queue<std::function<void()>> m_tasks;
-    
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::atomic<size_t> m_next_queue{0};
+
+    // The tasks in the deques, not yet taken.
+    std::atomic<int> m_pending{0};
+    std::atomic<int> m_sleeping{0};
+
     std::mutex m_mutex;
     std::condition_variable m_cv;
 
@@ -89,15 +140,81 @@ inline ThreadPool::ThreadPool(size_t t) {
     initialize(t);
 }
 
-inline void ThreadPool::initialize(size_t threads) {
+inline ThreadPool::WorkerId &ThreadPool::current_worker() {
+    thread_local auto id = WorkerId{};
+    return id;
+}
+
+inline const std::vector<int> &ThreadPool::get_cpu_order() {
+    static const auto order = []() -> std::vector<int> {
+        auto cpus = std::vector<int>{};
+#ifdef __linux__
+        // Read the CPU list of every node, like "0-3,8-11".
+        for (int node = 0; ; ++node) {
+            auto file = std::ifstream("/sys/devices/system/node/node" +
+                                          std::to_string(node) + "/cpulist");
+            auto list = std::string{};
+            if (!file.is_open() || !std::getline(file, list)) {
+                break;
+            }
+            auto iss = std::istringstream{list};
+            auto range = std::string{};
+            while (std::getline(iss, range, ',')) {
+                const auto dash = range.find('-');
+                const auto first = std::stoi(range.substr(0, dash));
+                const auto last = dash == std::string::npos ?
+                                      first : std::stoi(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    cpus.emplace_back(cpu);
+                }
+            }
+        }
+#endif
+        if (cpus.empty()) {
+            const auto cores = std::max(1u, std::thread::hardware_concurrency());
+            for (auto cpu = 0u; cpu < cores; ++cpu) {
+                cpus.emplace_back(cpu);
+            }
+        }
+        return cpus;
+    }();
+    return order;
+}
+
+inline void ThreadPool::bind_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+#else
+    (void) cpu;
+#endif
+}
+
+inline void ThreadPool::initialize(size_t threads, bool affinity) {
+    if (!m_threads.empty()) {
+        throw std::runtime_error("The thread pool is already initialized");
+    }
+
+    // Build all the deques first, the workers steal from any of them.
     for (size_t i = 0; i < threads; i++) {
-        add_thread([](){} /* null function */);
+        m_queues.emplace_back(std::make_unique<WorkerQueue>());
+    }
+    m_fork_threads.store(threads);
+
+    static std::atomic<size_t> next_cpu{0};
+    const auto &order = get_cpu_order();
+    const auto first_cpu = affinity ? next_cpu.fetch_add(threads) : 0;
+    for (size_t i = 0; i < threads; i++) {
+        const auto cpu = affinity ? order[(first_cpu + i) % order.size()] : -1;
+        add_thread(i, cpu);
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(20));
 }
 
 inline void ThreadPool::wake_up() {
     m_idle.store(false);
+    std::lock_guard<std::mutex> lock(m_mutex);
     m_cv.notify_all();
 }
 
@@ -110,71 +227,139 @@ inline void  ThreadPool::dump_status() {
     std::cout << "Thread pool status"                           << std::endl;
     std::cout << " Running : "         << !m_quit.load()        << std::endl;
     std::cout << " Number threads : "  << m_fork_threads.load() << std::endl;
-    std::cout << " Remainning tasks: " << m_tasks.size()        << std::endl;
+    std::cout << " Remainning tasks: " << m_pending.load()      << std::endl;
     wake_up();
 }
 
-inline void ThreadPool::add_thread(std::function<void()> initializer) {
-    m_threads.emplace_back( [this, initializer]() -> void {
-
-        m_fork_threads++;
-        initializer();
-
-        while(true) {
-            std::function<void()> task;
-            {
-                std::unique_lock<std::mutex> lock(this->m_mutex);
-                this->m_cv.wait(lock,
-                    [this](){ return this->m_quit.load() || (!this->m_tasks.empty() && !this->m_idle.load()); });
+inline void ThreadPool::add_thread(size_t index, int cpu) {
+    m_threads.emplace_back([this, index, cpu]() -> void {
+        if (cpu >= 0) {
+            bind_cpu(cpu);
+        }
+        worker_loop(index);
+    });
+}
 
-                if (this->m_quit.load()) {
-                    return;
-                }
+inline bool ThreadPool::pop_task(size_t index, std::function<void()> &task) {
+    const auto size = m_queues.size();
+    for (size_t i = 0; i < size; ++i) {
+        auto &queue = *m_queues[(index + i) % size];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            // Steal the newest one of the other worker.
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        m_pending.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
 
-                if (this->m_idle.load() || this->m_tasks.empty()) {
-                    continue;
-                }
+inline void ThreadPool::worker_loop(size_t index) {
+    current_worker().pool = this;
+    current_worker().index = index;
 
-                task = std::move(this->m_tasks.front());
-                this->m_tasks.pop();
-            }
+    auto task = std::function<void()>{};
+    while (true) {
+        if (m_quit.load()) {
+            return;
+        }
+        if (!m_idle.load() && pop_task(index, task)) {
             task();
+            task = nullptr;
+            continue;
         }
-    });
+
+        // Raise the sleeping counter before checking the tasks again, so
+        // the adder either sees us or we see its tasks.
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleeping.fetch_add(1);
+        m_cv.wait(lock,
+            [this](){ return m_quit.load() || (m_pending.load() > 0 && !m_idle.load()); });
+        m_sleeping.fetch_sub(1);
+    }
 }
 
-template<typename F, typename... Args>
-std::future<typename std::result_of<F(Args...)>::type>
-ThreadPool::add_task(F&& f, Args&&... args) {
-    const auto lambda_except = [this]() -> void {
-        if (this->m_fork_threads.load() <= 0 || this->m_quit.load()) {
-            auto out = std::ostringstream{};
-            out << "Do not allow to add a task : ";
+inline void ThreadPool::check_adding() const {
+    if (m_fork_threads.load() <= 0 || m_quit.load()) {
+        auto out = std::ostringstream{};
+        out << "Do not allow to add a task : ";
 
-            if (this->m_quit.load()) {
-                out << "Thread pool had stopped";
-            }
-            else if (this->m_fork_threads.load() <= 0) {
-                out << "No threads";
-            }
+        if (m_quit.load()) {
+            out << "Thread pool had stopped";
+        }
+        else if (m_fork_threads.load() <= 0) {
+            out << "No threads";
+        }
+
+        throw std::runtime_error(out.str());
+    }
+}
+
+inline void ThreadPool::push_tasks(std::vector<std::function<void()>> &tasks) {
+    check_adding();
+
+    const auto &worker = current_worker();
+    const auto size = m_queues.size();
+    for (auto &task : tasks) {
+        // The worker keeps its tasks, the others are spread.
+        const auto index = worker.pool == this ?
+                               worker.index : m_next_queue.fetch_add(1) % size;
+        auto &queue = *m_queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.emplace_back(std::move(task));
+    }
+    m_pending.fetch_add(tasks.size());
 
-            throw std::runtime_error(out.str());
+    if (m_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (tasks.size() == 1) {
+            m_cv.notify_one();
+        } else {
+            m_cv.notify_all();
         }
-    };
+    }
+}
 
+template<typename F, typename... Args>
+std::future<typename std::result_of<F(Args...)>::type>
+ThreadPool::add_task(F&& f, Args&&... args) {
     using return_type = typename std::result_of<F(Args...)>::type;
 
     auto task = std::make_shared< std::packaged_task<return_type()> >(
         std::bind(std::forward<F>(f), std::forward<Args>(args)...)
     );
-        
+
     std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        lambda_except();
-        m_tasks.emplace([task](){ (*task)(); });
+    auto tasks = std::vector<std::function<void()>>{};
+    tasks.emplace_back([task](){ (*task)(); });
+    push_tasks(tasks);
+
+    return res;
+}
+
+template<typename F, typename... Args>
+std::vector<std::future<typename std::result_of<F(Args...)>::type>>
+ThreadPool::add_tasks(size_t count, F&& f, Args&&... args) {
+    using return_type = typename std::result_of<F(Args...)>::type;
+
+    const auto func = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
+
+    auto res = std::vector<std::future<return_type>>{};
+    auto tasks = std::vector<std::function<void()>>{};
+    for (size_t i = 0; i < count; ++i) {
+        auto task = std::make_shared< std::packaged_task<return_type()> >(func);
+        res.emplace_back(task->get_future());
+        tasks.emplace_back([task](){ (*task)(); });
     }
-    m_cv.notify_one();
+    push_tasks(tasks);
 
     return res;
 }
@@ -196,9 +381,10 @@ inline void ThreadPool::quit_all() {
         t.join();
     }
 
-    while(!m_tasks.empty()) {
-        m_tasks.pop();
+    for (auto &queue : m_queues) {
+        queue->tasks.clear();
     }
+    m_pending.store(0);
 }
 
 inline ThreadPool::~ThreadPool() {
@@ -224,17 +410,17 @@ public:
         const auto threads = m_pool.get_threads();
         t = t > threads ? t :
                 t < 0 ? 0 : t;
-        for (int i = 0; i < t; ++i) {
-            add_task(std::forward<F>(f), std::forward<Args>(args)...);
+        auto results = m_pool.add_tasks(t, std::forward<F>(f), std::forward<Args>(args)...);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto &result : results) {
+            m_taskresults.emplace_back(std::move(result));
         }
     }
 
     template<class F, class... Args>
     void fill_tasks(F&& f, Args&&... args) {
-        const auto threads = m_pool.get_threads();
-        for (int i = 0; i < threads; ++i) {
-            add_task(std::forward<F>(f), std::forward<Args>(args)...);
-        }
+        add_tasks(m_pool.get_threads(), std::forward<F>(f), std::forward<Args>(args)...);
     }
 
     void wait_all() {
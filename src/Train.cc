@@ -21,8 +21,18 @@
 #include "Decoder.h"
 #include "Utils.h"
 #include "PGNParser.h"
+#include "ChunkWriter.h"
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <sstream>
+#include <thread>
 
 template<typename T>
 void vector_stream(const std::vector<T> arr, std::ostream &out) {
@@ -129,6 +139,118 @@ void DataCollection::out_stream(std::ostream &out) {
     Utils::strip_stream(out, 1);
 }
 
+// Convert the float to IEEE half precision, rounding to the nearest.
+static std::uint16_t float_to_half(const float f) {
+    auto bits = std::uint32_t{0};
+    std::memcpy(&bits, &f, sizeof(bits));
+
+    const auto sign = static_cast<std::uint32_t>((bits >> 16) & 0x8000);
+    const auto exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+    auto mantissa = bits & 0x7fffff;
+
+    if (exponent >= 31) {
+        return sign | 0x7c00;
+    }
+    if (exponent <= 0) {
+        // The subnormal numbers.
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        const auto shift = 14 - exponent;
+        auto half = mantissa >> shift;
+        if ((mantissa >> (shift-1)) & 1) {
+            half++;
+        }
+        return sign | half;
+    }
+
+    // The carry of the rounding goes to the exponent, that is still right.
+    auto half = sign | (exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) {
+        half++;
+    }
+    return half;
+}
+
+template<typename T>
+void binary_write(const T value, std::ostream &out) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void DataCollection::out_binary(std::ostream &out) {
+/*
+ * The fixed part is 44 bytes, followed by the probabilities. The numbers
+ * are little-endian.
+ *
+ *  0 : uint8  Current player, 1 is red, 0 is black
+ *  1 : uint8  Which piece go to move
+ *  2 : int8   Result, 1 is win, 0 is draw, -1 is lose
+ *  3 : uint8  Repetitions
+ *  4 : uint16 Game plies
+ *  6 : uint16 Fifty-Rule ply left
+ *  8 : uint16 Moves left
+ * 10 : uint16 Number of probabilities, N
+ * 12 : int8   Current player pieces Index, 16 slots
+ * 28 : int8   Other player pieces Index, 16 slots
+ * 44 : N * (uint16 maps, float16 probability)
+ *
+ * The slots follow the order of the text format, 5 pawns, 2 cannons,
+ * 2 rooks, 2 horses, 2 elephants, 2 advisors and 1 king. The missing
+ * pieces are -1.
+ */
+    static constexpr std::array<size_t, 7> PIECES_NUMBER = {5, 2, 2, 2, 2, 2, 1};
+    assert(winner != Types::INVALID_COLOR);
+
+    const auto lambda_slots = [](const PositionPieces &pieces, const int color) {
+        const std::array<const std::vector<int> *, 7> types = {
+            &pieces.pawns[color], &pieces.cannons[color], &pieces.rooks[color],
+            &pieces.horses[color], &pieces.elephants[color], &pieces.advisors[color],
+            &pieces.kings[color]
+        };
+        auto slots = std::array<std::int8_t, 16>{};
+        slots.fill(-1);
+
+        auto start = size_t{0};
+        for (auto t = size_t{0}; t < types.size(); ++t) {
+            const auto &idx = *types[t];
+            assert(idx.size() <= PIECES_NUMBER[t]);
+            const auto cnt = std::min(idx.size(), PIECES_NUMBER[t]);
+            for (auto i = size_t{0}; i < cnt; ++i) {
+                slots[start + i] = static_cast<std::int8_t>(idx[i]);
+            }
+            start += PIECES_NUMBER[t];
+        }
+        return slots;
+    };
+
+    auto result = std::int8_t{0};
+    if (winner == to_move) {
+        result = 1;
+    } else if (winner != Types::EMPTY_COLOR) {
+        result = -1;
+    }
+
+    binary_write(static_cast<std::uint8_t>(to_move == Types::RED ? 1 : 0), out);
+    binary_write(static_cast<std::uint8_t>(piece), out);
+    binary_write(result, out);
+    binary_write(static_cast<std::uint8_t>(repetitions), out);
+    binary_write(static_cast<std::uint16_t>(gameply), out);
+    binary_write(static_cast<std::uint16_t>(rule50_remaining), out);
+    binary_write(static_cast<std::uint16_t>(moves_left), out);
+    binary_write(static_cast<std::uint16_t>(probabilities.size()), out);
+
+    const auto &current = pieces_history[0];
+    const auto current_slots = lambda_slots(current, to_move);
+    const auto other_slots = lambda_slots(current, Board::swap_color(to_move));
+    out.write(reinterpret_cast<const char *>(current_slots.data()), current_slots.size());
+    out.write(reinterpret_cast<const char *>(other_slots.data()), other_slots.size());
+
+    for (const auto &x : probabilities) {
+        binary_write(static_cast<std::uint16_t>(x.first), out);
+        binary_write(float_to_half(x.second), out);
+    }
+}
 
 Train::Train() {
     m_counter = 0;
@@ -151,8 +273,8 @@ void proccess_probabilities(UCTNode &node, DataCollection &data, int min_cutoff)
     auto buf = std::vector<std::pair<int, int>>{};
 
     for (const auto &child: children) {
-        const auto node = child->get();
-        const auto maps = node->get_maps();
+        const auto node = child.get();
+        const auto maps = child.data()->maps;
         const auto visits = node->get_visits();
         if (visits > min_cutoff) {
             buf.emplace_back(maps, visits);
@@ -160,8 +282,13 @@ void proccess_probabilities(UCTNode &node, DataCollection &data, int min_cutoff)
     }
 
     if (buf.empty()) {
+        if (min_cutoff == 0) {
+            // The root is solved without visiting any child, for example
+            // the forced checkmate. Give the best move all probability.
+            data.probabilities.emplace_back(node.get_best_move(), 1.0f);
+            return;
+        }
         // If we cut off all children, don't try to cut off next time.
-        assert(min_cutoff != 0);
         proccess_probabilities(node, data, 0);
         return;
     }
@@ -246,10 +373,11 @@ bool Train::handle() const {
         return false;
     }
 
-    if (!option<bool>("collect")) {
-        return false;
-    }
-    return true;
+    return collecting();
+}
+
+bool Train::collecting() const {
+    return m_supervised || option<bool>("collect");
 }
 
 void Train::gather_probabilities(UCTNode &node, Position &pos) {
@@ -286,7 +414,7 @@ void Train::gather_move(Move move, Position &pos) {
 }
 
 void Train::gather_winner(Types::Color color) {
-    if (!option<bool>("collect")) return;
+    if (!collecting() || m_buffer.empty()) return;
 
     const auto plies = m_buffer.back()->gameply;
     for (const auto &data: m_buffer) {
@@ -306,6 +434,12 @@ void Train::data_stream(std::ostream &out) {
     }
 }
 
+void Train::binary_stream(std::ostream &out) {
+    for (const auto &data: m_buffer) {
+        data->out_binary(out);
+    }
+}
+
 void Train::save_data(std::string filename, bool append) {
     auto out = std::ostringstream{};
     data_stream(out);
@@ -326,27 +460,146 @@ void Train::save_data(std::string filename, bool append) {
     }
 }
 
-void Train::supervised(std::string pgnfile, std::string datafile) {
-    auto pgns = std::vector<PGNRecorder>{};
-    auto parser = PGNParser{};
+size_t Train::replay_game(const PGNRecorder &pgn, Position &pos) {
+    auto fen = pgn.start_fen;
+    pos.init_game(0);
+    pos.fen(fen);
+
+    for (const auto &pair: pgn.moves) {
+        auto move = pair.second;
+        gather_move(move, pos);
+        pos.do_move_assume_legal(move);
+    }
+    gather_winner(pgn.result);
+    return pgn.moves.size();
+}
+
+std::string Train::supervised(std::string pgnfile, std::string datafile) {
+    PGNReader reader;
+    if (!reader.open(pgnfile)) {
+        return "Could not opne file : " + pgnfile + "!";
+    }
 
-    parser.gather_pgnlist(pgnfile, pgns);
-    auto pos = std::make_shared<Position>();
-    for (auto &pgn: pgns) {
-        if (pgn.result == Types::INVALID_COLOR) {
-            continue;
+    const auto workers = std::max(1, option<int>("threads"));
+    const auto binary = option<bool>("binary_data");
+    const auto max_queued = static_cast<size_t>(4 * workers);
+    static constexpr size_t BATCH_GAMES = 64;
+
+    auto queue = std::queue<std::vector<std::string>>{};
+    auto finished = false;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+    std::atomic<size_t> games{0};
+    std::atomic<size_t> positions{0};
+    std::atomic<size_t> skipped{0};
+
+    const auto worker = [&](const int w) {
+        auto train = Train{};
+        train.m_supervised = true;
+
+        // The workers need no optional property.
+        PGNReader parser;
+        parser.set_properties({});
+        auto pos = Position{};
+        auto pgn = PGNRecorder{};
+        auto shardname = datafile + "_" + std::to_string(w);
+
+        // Keep the shard open, instead of reopening it for every game.
+        auto chunk_writer = std::unique_ptr<ChunkWriter>{nullptr};
+        auto shard = std::ofstream{};
+        if (binary) {
+            chunk_writer = std::make_unique<ChunkWriter>(shardname, option<int>("chunk_games"));
+        } else {
+            shard.open(shardname, std::ios::out | std::ios::app);
         }
-        pos->init_game(0);
-        pos->fen(pgn.start_fen);
 
-        for (const auto &pair: pgn.moves) {
-            auto move = pair.second;
-            gather_move(move, *pos);
-            pos->do_move_assume_legal(move);
+        while (true) {
+            auto batch = std::vector<std::string>{};
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                not_empty.wait(lock, [&](){ return !queue.empty() || finished; });
+                if (queue.empty()) {
+                    break;
+                }
+                batch = std::move(queue.front());
+                queue.pop();
+            }
+            not_full.notify_one();
+
+            for (const auto &text : batch) {
+                if (!parser.parse(text, pgn) || pgn.result == Types::INVALID_COLOR) {
+                    skipped++;
+                    continue;
+                }
+                positions += train.replay_game(pgn, pos);
+                games++;
+
+                auto out = std::ostringstream{};
+                if (chunk_writer) {
+                    train.binary_stream(out);
+                    chunk_writer->push(out.str());
+                } else {
+                    train.data_stream(out);
+                    shard << out.str();
+                }
+                train.clear_buffer();
+            }
         }
-        gather_winner(pgn.result);
-        save_data(datafile, true);
+    };
+
+    auto threads = std::vector<std::thread>{};
+    for (int w = 0; w < workers; ++w) {
+        threads.emplace_back(worker, w);
     }
+
+    auto timer = Utils::Timer{};
+    auto report_timer = Utils::Timer{};
+    auto text = std::string{};
+    while (true) {
+        auto batch = std::vector<std::string>{};
+        while (batch.size() < BATCH_GAMES && reader.next_text(text)) {
+            batch.emplace_back(std::move(text));
+        }
+        if (batch.empty()) {
+            break;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock, [&](){ return queue.size() < max_queued; });
+            queue.emplace(std::move(batch));
+        }
+        not_empty.notify_one();
+
+        if (report_timer.get_duration() >= 5.0f) {
+            const auto elapsed = timer.get_duration();
+            Utils::printf<Utils::SYNC>("%.1f%%, %zu games, %zu positions, %.1f games/s, %.1f positions/s\n",
+                                           100.f * reader.get_offset() / reader.get_size(),
+                                           games.load(), positions.load(),
+                                           games.load() / elapsed, positions.load() / elapsed);
+            report_timer.clock();
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished = true;
+    }
+    not_empty.notify_all();
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    const auto elapsed = timer.get_duration();
+    auto out = std::ostringstream{};
+    out << games.load() << " games, "
+        << positions.load() << " positions in "
+        << elapsed << " second(s), "
+        << games.load() / std::max(elapsed, 1e-3f) << " games/s, "
+        << skipped.load() << " skipped, "
+        << workers << " shard(s)";
+    return out.str();
 }
 
 int Train::get_version() const {
@@ -25,6 +25,7 @@
 #include "UCTNode.h"
 #include "Types.h"
 #include "Position.h"
+#include "PGNParser.h"
 
 #include <iostream>
 #include <memory>
@@ -66,6 +67,10 @@ struct DataCollection {
     Types::Color winner{Types::INVALID_COLOR};
 
     void out_stream(std::ostream &out);
+
+    // The binary record. See out_binary() for the layout.
+    static constexpr int BINARY_VERSION = 1;
+    void out_binary(std::ostream &out);
 };
 
 class Train {
@@ -78,19 +83,32 @@ public:
     void gather_winner(Types::Color color);
     void save_data(std::string filename, bool append = true);
     void data_stream(std::ostream &out);
+    void binary_stream(std::ostream &out);
 
     void clear_buffer();
-    void supervised(std::string pgnfile, std::string datafile);
+
+    // Convert the PGN games to the training data. The file is read by
+    // batches of games, which are replayed by the worker threads. Every
+    // worker writes its own shard, <datafile>_<worker>, or the binary
+    // chunks if binary_data is set. Return the summary.
+    std::string supervised(std::string pgnfile, std::string datafile);
 
 private:
     bool handle() const;
     int get_version() const;
     void push_buffer(DataCollection &data);
+    bool collecting() const;
+
+    // Replay the game and gather the moves. Return the number of positions.
+    size_t replay_game(const PGNRecorder &pgn, Position &pos);
 
     using Step = std::shared_ptr<DataCollection>;
     std::list<Step> m_buffer;
     int m_counter;
     bool m_lock;
+
+    // Collect the data even if the collect option is off.
+    bool m_supervised{false};
 };
 
 #endif
@@ -35,23 +35,259 @@
 #include <iterator>
 #include <limits>
 #include <mutex>
+#include <new>
 #include <numeric>
+#include <type_traits>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
-UCTNode::UCTNode(std::shared_ptr<UCTNodeData> data) {
-    assert(data->parameters != nullptr);
-    m_data = data;
-    increment_nodes();
+// The arena never calls the destructors.
+static_assert(std::is_trivially_destructible<UCTNode>::value, "");
+static_assert(std::is_trivially_destructible<UCTNodePointer>::value, "");
+static_assert(sizeof(UCTNodeData) == 8, "");
+
+constexpr size_t UCTNodeArena::MAX_GENERATIONS;
+
+UCTNodeArena::UCTNodeArena(std::shared_ptr<SearchParameters> parameters,
+                           ForcedCheckmate::Table *mate_table) {
+    m_parameters = parameters;
+    m_mate_table = mate_table;
+    m_generations.emplace_back(std::make_unique<Generation>());
+    m_current = m_generations.back().get();
 }
 
-UCTNode::~UCTNode() {
-    assert(get_threads() == 0);
-    decrement_nodes();
-    release_all_children();
-    for (auto i = size_t{0}; i < m_children.size(); ++i) {
-        decrement_edges();
+UCTNode *UCTNodeArena::new_root() {
+    auto data = new (m_current->arena.allocate(sizeof(UCTNodeData))) UCTNodeData{};
+    return new_node(data);
+}
+
+UCTNode *UCTNodeArena::new_node(UCTNodeData *data) {
+    m_node_status.nodes.fetch_add(1);
+    m_current->status.nodes.fetch_add(1);
+    return new (m_current->arena.allocate(sizeof(UCTNode))) UCTNode(data, this);
+}
+
+void UCTNodeArena::new_edges(UCTNode *node, const size_t count) {
+    m_node_status.edges.fetch_add(count);
+    m_current->status.edges.fetch_add(count);
+    auto edges = static_cast<UCTNodePointer *>(m_current->arena.allocate(count * sizeof(UCTNodePointer)));
+    node->m_children = ArenaArray<UCTNodePointer>(edges, count);
+    node->m_edges_status = &m_current->status;
+}
+
+void UCTNodeArena::decrement_edges(UCTNodeStats *edges_status) {
+    m_node_status.edges.fetch_sub(1);
+    edges_status->edges.fetch_sub(1);
+}
+
+std::atomic<int> *UCTNodeArena::new_edge_visits(const size_t count) {
+    auto visits = static_cast<std::atomic<int> *>(m_current->arena.allocate(count * sizeof(std::atomic<int>)));
+    for (auto idx = size_t{0}; idx < count; ++idx) {
+        new (&visits[idx]) std::atomic<int>{0};
+    }
+    return visits;
+}
+
+UCTNode *UCTNodeArena::find_or_new_node(const std::uint64_t hash,
+                                        UCTNodeData *data, bool &created) {
+    auto &shard = m_table[hash % TABLE_SHARDS];
+    created = false;
+    {
+        LockGuard<lock_t::S_LOCK> lock(shard.mutex);
+        auto it = shard.nodes.find(hash);
+        if (it != std::end(shard.nodes)) {
+            return it->second;
+        }
+    }
+
+    LockGuard<lock_t::X_LOCK> lock(shard.mutex);
+    // The other thread may build it after we left the read lock.
+    auto it = shard.nodes.find(hash);
+    if (it != std::end(shard.nodes)) {
+        return it->second;
+    }
+
+    auto node = new_node(data);
+    node->m_hash = hash;
+    shard.nodes.emplace(hash, node);
+    created = true;
+    return node;
+}
+
+void UCTNodeArena::insert_node(UCTNode *node) {
+    auto &shard = m_table[node->m_hash % TABLE_SHARDS];
+    LockGuard<lock_t::X_LOCK> lock(shard.mutex);
+
+    // Keep the node if the search built one for the position again.
+    shard.nodes.emplace(node->m_hash, node);
+}
+
+void UCTNodeArena::new_generation() {
+    // Swapping the maps is cheap, release() frees the entries.
+    for (auto &shard : m_table) {
+        LockGuard<lock_t::X_LOCK> lock(shard.mutex);
+        m_released_tables.emplace_back();
+        m_released_tables.back().swap(shard.nodes);
     }
+
+    std::lock_guard<std::mutex> lock(m_generations_mutex);
+    m_generations.emplace_back(std::make_unique<Generation>());
+    m_current = m_generations.back().get();
+}
+
+void UCTNodeArena::release(UCTNode *root) {
+    m_released_tables.clear();
+
+    // Only this thread removes the generations, we read them without
+    // the lock.
+    const auto old_generations = m_generations.size() - 1;
+    if (old_generations == 0) {
+        return;
+    }
+
+    struct SlabRange {
+        std::uintptr_t begin;
+        std::uintptr_t end;
+        size_t generation;
+    };
+
+    auto ranges = std::vector<SlabRange>{};
+    for (auto idx = size_t{0}; idx < old_generations; ++idx) {
+        for (const auto &r : m_generations[idx]->arena.get_slab_ranges()) {
+            ranges.push_back({reinterpret_cast<std::uintptr_t>(r.first),
+                              reinterpret_cast<std::uintptr_t>(r.second), idx});
+        }
+    }
+    std::sort(std::begin(ranges), std::end(ranges),
+                  [](const SlabRange &a, const SlabRange &b) { return a.begin < b.begin; });
+
+    // The pointers in none of the old slabs are in the current generation.
+    auto reached = std::vector<bool>(old_generations, false);
+    const auto reach = [&](const void *ptr) {
+        const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+        auto it = std::upper_bound(std::begin(ranges), std::end(ranges), address,
+                                       [](const std::uintptr_t a, const SlabRange &r) { return a < r.begin; });
+        if (it != std::begin(ranges) && address < (--it)->end) {
+            reached[it->generation] = true;
+        }
+    };
+
+    // The children are read only after the node is expanded, the
+    // search never changes them after that. The new links lead to the
+    // new nodes or to the nodes in the table, which we put back there
+    // after we reach them.
+    auto visited = std::unordered_set<const UCTNode *>{};
+    auto stack = std::vector<UCTNode *>{root};
+    while (!stack.empty()) {
+        const auto node = stack.back();
+        stack.pop_back();
+
+        reach(node);
+        reach(node->m_data);
+        if (!node->is_expended()) {
+            continue;
+        }
+        reach(node->m_children.begin());
+        reach(node->m_edge_visits);
+
+        for (const auto &child : node->m_children) {
+            const auto next = child.get();
+            if (!next) {
+                continue;
+            }
+            if (next->m_hash != 0) {
+                // The shared node may have many parents.
+                if (!visited.insert(next).second) {
+                    continue;
+                }
+                insert_node(next);
+            }
+            stack.emplace_back(next);
+        }
+    }
+
+    auto released = std::vector<std::unique_ptr<Generation>>{};
+    {
+        std::lock_guard<std::mutex> lock(m_generations_mutex);
+        auto generations = std::vector<std::unique_ptr<Generation>>{};
+        for (auto idx = size_t{0}; idx < m_generations.size(); ++idx) {
+            if (idx < old_generations && !reached[idx]) {
+                released.emplace_back(std::move(m_generations[idx]));
+            } else {
+                generations.emplace_back(std::move(m_generations[idx]));
+            }
+        }
+        m_generations = std::move(generations);
+    }
+
+    // No one reaches the released nodes, so their counts are final.
+    for (const auto &generation : released) {
+        m_node_status.nodes.fetch_sub(generation->status.nodes.load());
+        m_node_status.edges.fetch_sub(generation->status.edges.load());
+    }
+
+    // Free the slabs out of the lock.
+    released.clear();
+}
+
+size_t UCTNodeArena::get_generations() const {
+    std::lock_guard<std::mutex> lock(m_generations_mutex);
+    return m_generations.size();
+}
+
+void UCTNodeArena::clear() {
+    for (auto &shard : m_table) {
+        LockGuard<lock_t::X_LOCK> lock(shard.mutex);
+        shard.nodes.clear();
+        shard.mutex.clear_stats();
+    }
+    m_released_tables.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_generations_mutex);
+        m_generations.resize(1);
+        m_generations[0]->arena.reset();
+        m_generations[0]->status.nodes.store(0);
+        m_generations[0]->status.edges.store(0);
+        m_current = m_generations[0].get();
+    }
+    m_node_status.nodes.store(0);
+    m_node_status.edges.store(0);
+}
+
+SearchParameters *UCTNodeArena::parameters() const {
+    return m_parameters.get();
+}
+
+ForcedCheckmate::Table *UCTNodeArena::mate_table() const {
+    return m_mate_table;
+}
+
+UCTNodeStats *UCTNodeArena::node_status() {
+    return &m_node_status;
+}
+
+size_t UCTNodeArena::get_memory_used() const {
+    std::lock_guard<std::mutex> lock(m_generations_mutex);
+    auto memory = size_t{0};
+    for (const auto &generation : m_generations) {
+        memory += generation->arena.get_memory_used();
+    }
+    return memory;
+}
+
+SharedMutex::Stats UCTNodeArena::get_table_lock_stats() const {
+    auto stats = SharedMutex::Stats{};
+    for (const auto &shard : m_table) {
+        stats += shard.mutex.get_stats();
+    }
+    return stats;
+}
+
+UCTNode::UCTNode(UCTNodeData *data, UCTNodeArena *arena) {
+    assert(arena->parameters() != nullptr);
+    m_data = data;
+    m_arena = arena;
 }
 
 bool UCTNode::expend_children(Network &network,
@@ -65,6 +301,20 @@ bool UCTNode::expend_children(Network &network,
     }
 
     const auto raw_netlist = network.get_output(&pos);
+    expend_children(raw_netlist, pos, min_psa_ratio, is_root);
+
+    return true;
+}
+
+bool UCTNode::begin_expanding() {
+    return acquire_expanding();
+}
+
+void UCTNode::expend_children(const Network::Netresult &raw_netlist,
+                              Position &pos,
+                              const float min_psa_ratio,
+                              const bool is_root) {
+    assert(m_expand_state.load() == ExpandState::EXPANDING);
 
     m_color = pos.get_to_move();
     link_nn_output(raw_netlist, m_color);
@@ -78,7 +328,7 @@ bool UCTNode::expend_children(Network &network,
     const auto kings = pos.get_kings();
 
     // Probe forced checkmate sequences.
-    auto forced = ForcedCheckmate(pos);
+    auto forced = ForcedCheckmate(pos, m_arena->mate_table());
     auto ch_move = forced.find_checkmate(movelist);
     if (ch_move.valid()) {
         nodelist.emplace_back(1.0f, Decoder::move2maps(ch_move));
@@ -91,9 +341,15 @@ bool UCTNode::expend_children(Network &network,
         const auto maps = Decoder::move2maps(move);
         const auto policy = raw_netlist.policy[maps];
         if (is_root) {
-            auto fork_pos = std::make_shared<Position>(pos);
-            fork_pos->do_move_assume_legal(move);
-            auto rep = Repetition(*fork_pos);
+            // Remove the moves which let our king be captured. It is tested
+            // on the bitboards, so we don't copy the position for them.
+            if (!pos.board.is_safe_move(move)) {
+                continue;
+            }
+
+            auto fork_pos = pos;
+            fork_pos.do_move_assume_legal(move);
+            auto rep = Repetition(fork_pos, m_arena->mate_table());
             auto res = rep.judge();
             if (res == Repetition::UNKNOWN) {
                 // It is unknown result. we don't need to consider it if we have
@@ -108,10 +364,6 @@ bool UCTNode::expend_children(Network &network,
             } else if (res == Repetition::DRAW) {
                 // Do nothing.
             }
-
-            if (fork_pos->is_check(Board::swap_color(m_color))) {
-                continue;
-            }
         }
 
         if (move.get_to() == kings[Board::swap_color(m_color)]) {
@@ -152,29 +404,33 @@ bool UCTNode::expend_children(Network &network,
 
     link_nodelist(nodelist, min_psa_ratio);
     expand_done();
-    
-    return true;
 }
 
 void UCTNode::link_nodelist(std::vector<Network::PolicyMapsPair> &nodelist, float min_psa_ratio) {
     std::stable_sort(std::rbegin(nodelist), std::rend(nodelist));
 
     const float min_psa = nodelist[0].first * min_psa_ratio;
+    auto count = size_t{0};
     for (const auto &node : nodelist) {
         if (node.first < min_psa) {
             break;
-        } else {
-            auto data = std::make_shared<UCTNodeData>();
-            data->maps = node.second;
-            data->policy = node.first;
-            data->parameters = parameters();
-            data->node_status = node_status();
-            data->parent = get();
-            m_children.emplace_back(std::make_shared<UCTNodePointer>(data));
-            increment_edges();
         }
+        count++;
+    }
+
+    // All the edges of this node are placed in one contiguous array.
+    m_arena->new_edges(this, count);
+    for (auto idx = size_t{0}; idx < count; ++idx) {
+        auto data = UCTNodeData{};
+        data.maps = nodelist[idx].second;
+        data.policy = nodelist[idx].first;
+        new (&m_children[idx]) UCTNodePointer(data);
     }
     assert(!m_children.empty());
+
+    if (parameters()->transposition) {
+        m_edge_visits = m_arena->new_edge_visits(count);
+    }
 }
 
 void UCTNode::link_nn_output(const Network::Netresult &raw_netlist,
@@ -212,7 +468,7 @@ void UCTNode::set_result(Types::Color color) {
     }
 }
 
-const std::vector<std::shared_ptr<UCTNode::UCTNodePointer>> &UCTNode::get_children() const {
+const ArenaArray<UCTNodePointer> &UCTNode::get_children() const {
     return m_children;
 }
 
@@ -280,6 +536,113 @@ UCTNode *UCTNode::get() {
     return this;
 }
 
+UCTNode *UCTNode::find_child(const int maps) const {
+    if (!is_expended()) {
+        return nullptr;
+    }
+    for (const auto &child : m_children) {
+        if (child.data()->maps == maps) {
+            return child.get();
+        }
+    }
+    return nullptr;
+}
+
+void UCTNode::copy_subtree(UCTNode *node) const {
+    assert(get_threads() == 0);
+    assert(node->expandable());
+
+    node->m_red_stmeval = m_red_stmeval;
+    node->m_red_winloss = m_red_winloss;
+    node->m_draw = m_draw;
+    node->m_color = m_color;
+
+    node->m_visits.store(m_visits.load());
+    node->m_squared_eval_diff.store(m_squared_eval_diff.load());
+    node->m_accumulated_red_stmevals.store(m_accumulated_red_stmevals.load());
+    node->m_accumulated_red_wls.store(m_accumulated_red_wls.load());
+    node->m_accumulated_draws.store(m_accumulated_draws.load());
+    node->m_status.store(m_status.load());
+
+    if (!is_expended()) {
+        return;
+    }
+
+    auto arena = node->m_arena;
+    arena->new_edges(node, m_children.size());
+    if (m_edge_visits) {
+        node->m_edge_visits = arena->new_edge_visits(m_children.size());
+    }
+
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        auto &child = node->m_children[idx];
+        new (&child) UCTNodePointer(*m_children[idx].data());
+        if (m_edge_visits) {
+            node->m_edge_visits[idx].store(m_edge_visits[idx].load());
+        }
+
+        const auto old_child = m_children[idx].get();
+        if (old_child) {
+            // The shared node is copied once, the other parents
+            // find the copy in the table.
+            auto created = true;
+            auto new_child = old_child->m_hash == 0 ?
+                                 arena->new_node(child.data()) :
+                                 arena->find_or_new_node(old_child->m_hash, child.data(), created);
+            if (created) {
+                old_child->copy_subtree(new_child);
+            }
+            child.assign(new_child);
+            node->decrement_edges();
+        }
+    }
+    node->m_expand_state.store(ExpandState::EXPANDED);
+}
+
+int UCTNode::promote_children(UCTNode *subtree) {
+    assert(is_expended());
+
+    auto reused_visits = 0;
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        auto &child = m_children[idx];
+        const auto old_node = subtree->find_child(child.data()->maps);
+        if (old_node) {
+            // The data of the old node is in the edge of the old parent.
+            // Our edge has the same move and the root policy.
+            old_node->m_data = child.data();
+            child.replace(old_node);
+            reused_visits += reuse_edge_visits(idx);
+        }
+    }
+    return reused_visits;
+}
+
+int UCTNode::copy_children(UCTNode *subtree) {
+    assert(is_expended());
+
+    auto reused_visits = 0;
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const auto node = m_children[idx].get();
+        const auto old_node = subtree->find_child(m_children[idx].data()->maps);
+        if (old_node) {
+            old_node->copy_subtree(node);
+            reused_visits += reuse_edge_visits(idx);
+        }
+    }
+    return reused_visits;
+}
+
+int UCTNode::reuse_edge_visits(const size_t idx) {
+    // The new edge has no visits. Give it the visits of the reused
+    // child, or the child looks like a transposition searched from the
+    // other parents, and we would only borrow its evaluation.
+    const auto visits = m_children[idx].get()->get_visits();
+    if (m_edge_visits) {
+        m_edge_visits[idx].store(visits);
+    }
+    return visits;
+}
+
 float UCTNode::get_eval_variance(const float default_var, const int visits) const {
     return visits > 1 ? m_squared_eval_diff.load() / (visits - 1) : default_var;
 }
@@ -373,18 +736,18 @@ UCTNode *UCTNode::get_child(const int maps) {
     wait_expanded();
     assert(has_children());
 
-    std::shared_ptr<UCTNodePointer> res = nullptr;
+    UCTNodePointer *res = nullptr;
 
-    for (const auto &child : m_children) { 
-        const int child_maps = child->data()->maps;
+    for (auto &child : m_children) { 
+        const int child_maps = child.data()->maps;
         if (maps == child_maps) {
-            res = child;
+            res = &child;
             break;
         }
     }
 
     assert(res != nullptr);
-    inflate(res);
+    inflate(*res);
     return res->get();
 }
 
@@ -397,9 +760,10 @@ std::vector<std::pair<float, int>> UCTNode::get_lcb_list(const Types::Color colo
     inflate_all_children();
 
     for (const auto & child : m_children) {
-        const auto node = child->get();
+        const auto node = child.get();
+        assert(node != nullptr);
         const auto visits = node->get_visits();
-        const auto maps = node->get_maps();
+        const auto maps = child.data()->maps;
         const auto lcb = node->get_eval_lcb(color);
         if (visits > 0) {
             list.emplace_back(lcb, maps);
@@ -419,9 +783,9 @@ std::vector<std::pair<float, int>> UCTNode::get_winrate_list(const Types::Color
     inflate_all_children();
 
     for (const auto &child : m_children) {
-        const auto node = child->get();
+        const auto node = child.get();
         const auto visits = node->get_visits();
-        const auto maps = node->get_maps();
+        const auto maps = child.data()->maps;
         const auto winrate = node->get_meaneval(color, false);
         if (visits > 0) {
             list.emplace_back(winrate, maps);
@@ -432,23 +796,24 @@ std::vector<std::pair<float, int>> UCTNode::get_winrate_list(const Types::Color
     return list;
 }
 
-UCTNode *UCTNode::uct_select_child(const Types::Color color,
-                                   const bool is_root) {
+UCTNodePointer &UCTNode::uct_select_child(const Types::Color color,
+                                          const bool is_root) {
     wait_expanded();
     assert(has_children());
 
     int parentvisits = 0;
     float total_visited_policy = 0.0f;
-    for (const auto &child : m_children) {
-        const auto node = child->get();
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        const auto &child = m_children[idx];
+        const auto node = child.get();
         if (!node) {
             continue;
         }    
         if (node->is_valid()) {
-            const auto visits = node->get_visits();
+            const auto visits = get_edge_visits(idx, node);
             parentvisits += visits;
             if (visits > 0) {
-                total_visited_policy += node->get_policy();
+                total_visited_policy += child.data()->policy;
             }
         }
     }
@@ -463,13 +828,15 @@ UCTNode *UCTNode::uct_select_child(const Types::Color color,
     const float fpu_reduction = fpu_reduction_factor * std::sqrt(total_visited_policy);
     const float fpu_value = get_nn_meaneval(color) - fpu_reduction;
 
-    std::shared_ptr<UCTNodePointer> best_node = nullptr;
+    UCTNodePointer *best_node = nullptr;
     float best_value = std::numeric_limits<float>::lowest();
 
-    for (const auto &child : m_children) {
+    for (auto idx = size_t{0}; idx < m_children.size(); ++idx) {
+        auto &child = m_children[idx];
+
         // Check the node is pointer or not.
         // If not, we can not get most data from child.
-        const auto node = child->get();
+        const auto node = child.get();
         const bool is_pointer = node == nullptr ? false : true;
 
         // If the node was pruned. Skip this time,
@@ -490,22 +857,80 @@ UCTNode *UCTNode::uct_select_child(const Types::Color color,
 
         float denom = 1.0f;
         if (is_pointer) {
-            denom += node->get_visits();
+            denom += get_edge_visits(idx, node);
         }
 
-        const float psa = child->data()->policy;
+        const float psa = child.data()->policy;
         const float puct = cpuct * psa * (numerator / denom);
         const float value = q_value + puct;
         assert(value > std::numeric_limits<float>::lowest());
 
         if (value > best_value) {
             best_value = value;
-            best_node = child;
+            best_node = &child;
+        }
+    }
+
+    assert(best_node != nullptr);
+    return *best_node;
+}
+
+UCTNode *UCTNode::inflate_child(UCTNodePointer &child, Position &position) {
+    // The repeated positions and the positions close to the fifty moves
+    // rule depend on the history, we never share them.
+    constexpr auto RULE50_MARGIN = 10;
+    if (!parameters()->transposition ||
+            position.get_repetitions() != 0 ||
+            position.get_rule50_ply_left() <= RULE50_MARGIN) {
+        inflate(child);
+        return child.get();
+    }
+
+    // The NodePointer calls new_node() of the allocator while it holds
+    // the edge, so only one thread looks up the table for this edge.
+    struct TableAllocator {
+        UCTNodeArena *arena;
+        std::uint64_t hash;
+        bool created;
+        UCTNode *new_node(UCTNodeData *data) {
+            return arena->find_or_new_node(hash, data, created);
         }
+    };
+
+    // If no new node is built, the memory of this edge is still
+    // counted as an edge.
+    auto allocator = TableAllocator{m_arena, position.get_hash(), false};
+    if (child.inflate(allocator) && allocator.created) {
+        decrement_edges();
     }
+    return child.get();
+}
 
-    inflate(best_node);
-    return best_node->get();
+bool UCTNode::can_borrow_evals(const UCTNodePointer &child) const {
+    if (!m_edge_visits) {
+        return false;
+    }
+    const auto node = child.get();
+    const auto idx = static_cast<size_t>(&child - m_children.begin());
+    return node && node->get_visits() > m_edge_visits[idx].load();
+}
+
+UCTNodeEvals UCTNode::get_mean_evals() const {
+    const auto visits = static_cast<float>(get_visits());
+    assert(visits > 0.0f);
+
+    auto evals = UCTNodeEvals{};
+    evals.red_stmeval = get_accumulated_evals() / visits;
+    evals.red_winloss = get_accumulated_wls() / visits;
+    evals.draw = get_accumulated_draws() / visits;
+    return evals;
+}
+
+int UCTNode::get_edge_visits(const size_t idx, const UCTNode *node) const {
+    if (m_edge_visits) {
+        return m_edge_visits[idx].load();
+    }
+    return node->get_visits();
 }
 
 void UCTNode::apply_evals(std::shared_ptr<UCTNodeEvals> evals) {
@@ -533,6 +958,13 @@ void UCTNode::update(std::shared_ptr<UCTNodeEvals> evals) {
     Utils::atomic_add(m_accumulated_draws, evals->draw);
 }
 
+void UCTNode::update_edge(const UCTNodePointer &child) {
+    if (m_edge_visits) {
+        const auto idx = static_cast<size_t>(&child - m_children.begin());
+        m_edge_visits[idx].fetch_add(1);
+    }
+}
+
 std::vector<float> UCTNode::apply_dirichlet_noise(const float epsilon, const float alpha) {
     auto child_cnt = m_children.size();
     auto dirichlet_buffer = std::vector<float>(child_cnt);
@@ -559,7 +991,7 @@ std::vector<float> UCTNode::apply_dirichlet_noise(const float epsilon, const flo
     // Be Sure all node are expended.
     inflate_all_children();
     for (const auto &child : m_children) {
-        auto node = child->get();
+        auto node = child.get();
         auto policy = node->get_policy();
         auto eta_a = dirichlet_buffer[child_cnt++];
         policy = policy * (1 - epsilon) + epsilon * eta_a;
@@ -611,7 +1043,7 @@ int UCTNode::get_best_move() {
     }
 
     if (lcblist.empty() && has_children()) {
-        best_move = m_children[0]->get()->get_maps();
+        best_move = m_children[0].data()->maps;
     }
 
     assert(best_move != -1);
@@ -624,9 +1056,9 @@ int UCTNode::randomize_first_proportionally(float random_temp) {
     auto accum_vector = std::vector<std::pair<float, int>>{};
 
     for (const auto &child : m_children) {
-        auto node = child->get();
+        auto node = child.get();
         const auto visits = node->get_visits();
-        const auto maps = node->get_maps();
+        const auto maps = child.data()->maps;
         if (visits > parameters()->random_min_visits) {
            accum += std::pow((float)visits, (1.0 / random_temp));
            accum_vector.emplace_back(std::pair<float, int>(accum, maps));
@@ -655,20 +1087,8 @@ void UCTNode::decrement_threads() {
     m_loading_threads.fetch_sub(1);
 }
 
-void UCTNode::increment_nodes() {
-    node_status()->nodes.fetch_add(1);
-}
-
-void UCTNode::decrement_nodes() {
-    node_status()->nodes.fetch_sub(1); 
-}
-
-void UCTNode::increment_edges() {
-    node_status()->edges.fetch_add(1); 
-}
-
 void UCTNode::decrement_edges() {
-    node_status()->edges.fetch_sub(1); 
+    m_arena->decrement_edges(m_edges_status);
 }
 
 
@@ -712,12 +1132,16 @@ bool UCTNode::is_valid() const {
     return m_status.load() != INVALID;
 }
 
-std::shared_ptr<SearchParameters> UCTNode::parameters() const {
-    return m_data->parameters;
+SearchParameters *UCTNode::parameters() const {
+    return m_arena->parameters();
 }
 
-std::shared_ptr<UCTNodeStats> UCTNode::node_status() const {
-    return m_data->node_status;
+UCTNodeStats *UCTNode::node_status() const {
+    return m_arena->node_status();
+}
+
+SharedMutex::Stats UCTNode::get_table_lock_stats() const {
+    return m_arena->get_table_lock_stats();
 }
 
 void UCTNode::set_policy(const float p) {
@@ -725,30 +1149,16 @@ void UCTNode::set_policy(const float p) {
 }
 
 void UCTNode::inflate_all_children() {
-    for (const auto &child : m_children) {
+    for (auto &child : m_children) {
         inflate(child);
     }
 }
 
-void UCTNode::release_all_children() {
-    for (const auto &child : m_children) {
-         release(child);
-    }
-}
-
-void UCTNode::inflate(std::shared_ptr<UCTNodePointer> child) {
-    auto success = child->inflate();
+void UCTNode::inflate(UCTNodePointer &child) {
+    // The arena counts the new node.
+    auto success = child.inflate(*m_arena);
     if (success) {
         decrement_edges();
-        increment_nodes();
-    }
-}
-
-void UCTNode::release(std::shared_ptr<UCTNodePointer> child) {
-    auto success = child->release();
-    if (success) {
-        decrement_nodes();
-        increment_edges();
     }
 }
 
@@ -781,8 +1191,8 @@ size_t UCT_Information::get_memory_used(UCTNode *node) {
     const auto status = node->node_status();
     const auto nodes = status->nodes.load();
     const auto edges = status->edges.load();
-    const auto node_mem = sizeof(UCTNode) + sizeof(NodePointer<UCTNode, UCTNodeData>);
-    const auto edge_mem = sizeof(NodePointer<UCTNode, UCTNodeData>);
+    const auto node_mem = sizeof(UCTNode) + sizeof(UCTNodePointer);
+    const auto edge_mem = sizeof(UCTNodePointer);
     return nodes * node_mem + edges * edge_mem;
 }
 
@@ -794,6 +1204,16 @@ void UCT_Information::dump_tree_stats(UCTNode *node) {
 
     Utils::printf<Utils::STATIC>("Tree Status: \n");
     Utils::printf<Utils::STATIC>("  nodes: %d, edges: %d, tree memory used: %.2f MiB\n", nodes, edges, mem);
+
+    const auto lock_stats = node->get_table_lock_stats();
+    if (lock_stats.exclusive_locks > 0) {
+        Utils::printf<Utils::STATIC>("  table locks: writes: %llu, contended writes: %llu (%.2f ms), contended reads: %llu (%.2f ms)\n",
+                                         static_cast<unsigned long long>(lock_stats.exclusive_locks),
+                                         static_cast<unsigned long long>(lock_stats.exclusive_contentions),
+                                         lock_stats.exclusive_wait_microseconds / 1000.0,
+                                         static_cast<unsigned long long>(lock_stats.shared_contentions),
+                                         lock_stats.shared_wait_microseconds / 1000.0);
+    }
 }
 
 void UCT_Information::dump_stats(UCTNode *node, Position &position, int cut_off) {
@@ -26,10 +26,16 @@
 #include "Position.h"
 #include "NodePointer.h"
 #include "Board.h"
+#include "Arena.h"
+#include "SharedMutex.h"
+#include "ForcedCheckmate.h"
 
+#include <array>
 #include <atomic>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 class UCTNode;
@@ -39,12 +45,106 @@ struct UCTNodeStats {
     std::atomic<int> edges{0};
 };
 
+// The edge data. Keep it small, most of the edges are never inflated.
 struct UCTNodeData {
     float policy{0.0f};
-    int maps{-1};
-    std::shared_ptr<SearchParameters> parameters{nullptr};
-    std::shared_ptr<UCTNodeStats> node_status{nullptr};
-    UCTNode *parent{nullptr};
+    std::int32_t maps{-1};
+};
+
+using UCTNodePointer = NodePointer<UCTNode, UCTNodeData>;
+
+// All the nodes and edges of one search tree are allocated from this
+// arena. They are never deleted one by one, clear() drops the whole tree
+// at once.
+//
+// The arena also keeps the transposition table. With it, the positions
+// reached by different move orders share one node, and the tree becomes
+// a directed acyclic graph.
+//
+// Each search starts a new generation. The subtree reused from the last
+// search stays in the old generations, and release() drops the ones the
+// new tree does not reach any more.
+class UCTNodeArena {
+public:
+    // Past it, the reused subtree should be copied into one generation.
+    static constexpr size_t MAX_GENERATIONS = 3;
+
+    UCTNodeArena(std::shared_ptr<SearchParameters> parameters,
+                 ForcedCheckmate::Table *mate_table);
+
+    UCTNode *new_root();
+    UCTNode *new_node(UCTNodeData *data);
+
+    // Allocate the children of the node. The edges are counted in the
+    // current generation, until the node inflates them.
+    void new_edges(UCTNode *node, const size_t count);
+    void decrement_edges(UCTNodeStats *edges_status);
+    std::atomic<int> *new_edge_visits(const size_t count);
+
+    // Return the node of the position hash in the transposition table.
+    // If there is none, build a new node and set the created flag.
+    UCTNode *find_or_new_node(const std::uint64_t hash,
+                              UCTNodeData *data, bool &created);
+
+    // Allocate the new nodes in the new generation and empty the table,
+    // so the table never leads to a node which may be released. Not
+    // thread-safe, the last release() must be done and no one may
+    // touch the tree.
+    void new_generation();
+
+    // Walk the tree from the root, put its shared nodes back into the
+    // table and release the old generations it does not reach. It may
+    // run while the tree is searched.
+    void release(UCTNode *root);
+
+    // The number of generations which are holding the nodes.
+    size_t get_generations() const;
+
+    // Release all nodes and edges. Not thread-safe, no one may touch
+    // the tree while clearing it.
+    void clear();
+
+    SearchParameters *parameters() const;
+    ForcedCheckmate::Table *mate_table() const;
+    UCTNodeStats *node_status();
+
+    size_t get_memory_used() const;
+
+    // The lock statistics of all table shards.
+    SharedMutex::Stats get_table_lock_stats() const;
+
+private:
+    static constexpr size_t TABLE_SHARDS = 64;
+
+    using NodeTable = std::unordered_map<std::uint64_t, UCTNode *>;
+
+    // Most probes find the node, so the readers share the shard.
+    struct TableShard {
+        SharedMutex mutex;
+        NodeTable nodes;
+    };
+
+    // The counts are what the generation holds. release() takes the
+    // released ones out of the totals.
+    struct Generation {
+        Arena arena;
+        UCTNodeStats status;
+    };
+
+    void insert_node(UCTNode *node);
+
+    std::shared_ptr<SearchParameters> m_parameters;
+    ForcedCheckmate::Table *m_mate_table;
+    UCTNodeStats m_node_status;
+    std::array<TableShard, TABLE_SHARDS> m_table;
+
+    // The tables emptied by new_generation(), release() frees them.
+    std::vector<NodeTable> m_released_tables;
+
+    // The last one is the current generation.
+    mutable std::mutex m_generations_mutex;
+    std::vector<std::unique_ptr<Generation>> m_generations;
+    Generation *m_current{nullptr};
 };
 
 struct UCTNodeEvals {
@@ -55,9 +155,8 @@ struct UCTNodeEvals {
 
 class UCTNode {
 public:
-    using UCTNodePointer = NodePointer<UCTNode, UCTNodeData>;
-    UCTNode(std::shared_ptr<UCTNodeData> data);
-    ~UCTNode();
+    using UCTNodePointer = ::UCTNodePointer;
+    UCTNode(UCTNodeData *data, UCTNodeArena *arena);
 
     UCTNodeEvals prepare_root_node(Network &network,
                                    Position &position,
@@ -67,6 +166,18 @@ public:
                          const float min_psa_ratio,
                          const bool is_root = false);
 
+    // Own the expansion of this node. Return false if the other thread
+    // is expanding it or it is already expanded. The batched search
+    // takes the node first and evaluates it later with the others.
+    bool begin_expanding();
+
+    // Finish the expansion taken by begin_expanding() with the network
+    // output of the position.
+    void expend_children(const Network::Netresult &raw_netlist,
+                         Position &position,
+                         const float min_psa_ratio,
+                         const bool is_root = false);
+
     UCTNodeEvals get_node_evals() const;
     int get_maps() const;
     float get_policy() const;
@@ -80,7 +191,7 @@ public:
     int get_best_move();
     int randomize_first_proportionally(float random_temp);
 
-    const std::vector<std::shared_ptr<UCTNodePointer>> &get_children() const;
+    const ArenaArray<UCTNodePointer> &get_children() const;
     float get_stmeval(const Types::Color color,
                       const bool use_virtual_loss) const;
     float get_winloss(const Types::Color color,
@@ -91,11 +202,42 @@ public:
     UCTNode *get_child(const int maps);
     UCTNode *get();
 
-    UCTNode *uct_select_child(const Types::Color color,
-                              const bool is_root);
+    // Return the child if it was inflated, otherwise return nullptr.
+    UCTNode *find_child(const int maps) const;
+
+    // Copy the statistics and the whole subtree into the other node.
+    // The node may be in the other generation. Don't search while
+    // copying.
+    void copy_subtree(UCTNode *node) const;
+
+    // Take over the children of the same moves from the subtree of the
+    // last search. The nodes are not copied, they stay in their old
+    // generations. Return the visits we reused. Don't search while
+    // taking them.
+    int promote_children(UCTNode *subtree);
+
+    // Like promote_children(), but copy the subtrees of the children
+    // into our generation.
+    int copy_children(UCTNode *subtree);
+
+    UCTNodePointer &uct_select_child(const Types::Color color,
+                                     const bool is_root);
+
+    // Inflate the selected child. The position is the one after the
+    // child move. If the transposition is enabled, the child may be the
+    // node which is already in the table.
+    UCTNode *inflate_child(UCTNodePointer &child, Position &position);
+
+    // The child was reached from the other parents more times than from
+    // us. We can back up its evaluation without searching it again.
+    bool can_borrow_evals(const UCTNodePointer &child) const;
+
+    // The average of all evaluations backed up through this node.
+    UCTNodeEvals get_mean_evals() const;
 
     void apply_evals(std::shared_ptr<UCTNodeEvals> evals);
     void update(std::shared_ptr<UCTNodeEvals> evals);
+    void update_edge(const UCTNodePointer &child);
 
     void increment_threads();
     void decrement_threads();
@@ -111,9 +253,12 @@ public:
     bool is_active() const;
     bool is_valid() const;
 
-    std::shared_ptr<UCTNodeStats> node_status() const;
+    UCTNodeStats *node_status() const;
+    SharedMutex::Stats get_table_lock_stats() const;
 
 private:
+    friend class UCTNodeArena;
+
     float m_red_stmeval{0.0f};
     float m_red_winloss{0.0f};
     float m_draw{0.0f};
@@ -128,16 +273,31 @@ private:
     std::atomic<float> m_accumulated_red_wls{0.0f};
     std::atomic<float> m_accumulated_draws{0.0f};
 
-    std::shared_ptr<UCTNodeData> m_data{nullptr};
+    // The data lives in the edge of the parent node. A node in the
+    // transposition table has many parents, so the callers should read
+    // the move and policy from the edge, not from the node.
+    UCTNodeData *m_data{nullptr};
+    UCTNodeArena *m_arena{nullptr};
+
+    // The key in the transposition table, zero if it is not there.
+    std::uint64_t m_hash{0};
+
+    ArenaArray<UCTNodePointer> m_children;
 
-    std::vector<std::shared_ptr<UCTNodePointer>> m_children;
-    std::shared_ptr<SearchParameters> parameters() const;
+    // The counts of the generation the children are in.
+    UCTNodeStats *m_edges_status{nullptr};
+
+    // The visits through each edge. Only with the transposition, the
+    // child visits include the visits from the other parents.
+    std::atomic<int> *m_edge_visits{nullptr};
+    int get_edge_visits(const size_t idx, const UCTNode *node) const;
+    int reuse_edge_visits(const size_t idx);
+    SearchParameters *parameters() const;
     
     void link_nodelist(std::vector<Network::PolicyMapsPair> &nodelist, float min_psa_ratio);
     void link_nn_output(const Network::Netresult &raw_netlist,
                         const Types::Color color);
     void inflate_all_children();
-    void release_all_children();
     std::vector<float> apply_dirichlet_noise(const float epsilon, const float alpha);
     void set_policy(const float p);
 
@@ -152,14 +312,9 @@ private:
     float get_accumulated_wls() const;
     float get_accumulated_draws() const;
 
-    void increment_nodes();
-    void decrement_nodes();
-
-    void increment_edges();
     void decrement_edges();
 
-    void inflate(std::shared_ptr<UCTNodePointer> child);
-    void release(std::shared_ptr<UCTNodePointer> child);
+    void inflate(UCTNodePointer &child);
 
     void set_result(Types::Color color);
 
@@ -34,9 +34,9 @@ for (auto i = size_t{0}; i < 64; ++i) {     \
 
 template<>
 void Uint128_t::outStream<Uint128_t::Stream_t::BIN>(std::ostream &out) const {
-    BIN_SCAN(UPPER);
+    BIN_SCAN(get_upper());
     out << " | ";
-    BIN_SCAN(LOWER);
+    BIN_SCAN(get_lower());
 }
 
 #undef BIN_SCAN
@@ -44,9 +44,9 @@ void Uint128_t::outStream<Uint128_t::Stream_t::BIN>(std::ostream &out) const {
 template<>
 void Uint128_t::outStream<Uint128_t::Stream_t::HEX>(std::ostream &out) const {
     out << std::setfill('0') << std::hex;
-    out << std::setw(16) << UPPER;
+    out << std::setw(16) << get_upper();
     out << " | ";
-    out << std::setw(16) << LOWER;
+    out << std::setw(16) << get_lower();
     out << std::setfill(' ') << std::dec;
 }
 
@@ -64,5 +64,5 @@ void Uint128_t::dump_status() const {
 }
 
 void Uint128_t::swap() {
-    std::swap(UPPER, LOWER);
+    *this = Uint128_t(get_lower(), get_upper());
 }
@@ -22,10 +22,30 @@
 #include <iostream>
 #include <utility>
 
+/*
+ * The native backend keeps the value in one unsigned __int128, so the
+ * compiler emits the paired 64-bit instructions for us. Define
+ * USE_PORTABLE_UINT128 to force the two uint64_t backend, it is also
+ * used if the compiler has no 128-bit integer.
+ */
+#if defined(__SIZEOF_INT128__) && !defined(USE_PORTABLE_UINT128)
+#define UINT128_NATIVE
+#endif
+
 class Uint128_t {
 private:
+#ifdef UINT128_NATIVE
+    using Native = unsigned __int128;
+
+    Native VALUE;
+
+    struct NativeTag {};
+    constexpr Uint128_t(Native value, NativeTag)
+                  : VALUE(value) {}
+#else
     std::uint64_t UPPER;
     std::uint64_t LOWER;
+#endif
 
 public:
     enum class Stream_t {
@@ -33,32 +53,37 @@ public:
         HEX
     };
 
+#ifdef UINT128_NATIVE
     constexpr Uint128_t()
-                  : UPPER(0ULL), LOWER(0ULL) {}
+                  : VALUE(0) {}
 
-    constexpr Uint128_t(const Uint128_t &rhs)
-                  : UPPER(rhs.UPPER), LOWER(rhs.LOWER) {}
+    constexpr Uint128_t(std::uint64_t upper, std::uint64_t lower)
+                  : VALUE((static_cast<Native>(upper) << 64) | lower) {}
 
-    constexpr Uint128_t(const Uint128_t &&rhs)
-                  : UPPER(std::move(rhs.UPPER)), LOWER(std::move(rhs.LOWER)) {}
+    constexpr Uint128_t(std::uint64_t lower)
+                  : VALUE(lower) {}
+#else
+    constexpr Uint128_t()
+                  : UPPER(0ULL), LOWER(0ULL) {}
 
     constexpr Uint128_t(std::uint64_t upper, std::uint64_t lower)
                   : UPPER(upper), LOWER(lower) {}
 
     constexpr Uint128_t(std::uint64_t lower)
                   : UPPER(0ULL), LOWER(lower) {}
+#endif
+
+    constexpr Uint128_t(const Uint128_t &rhs) = default;
+    constexpr Uint128_t(Uint128_t &&rhs) = default;
+    Uint128_t &operator=(const Uint128_t &rhs) = default;
+    Uint128_t &operator=(Uint128_t &&rhs) = default;
 
     inline constexpr int width() const {
         return 128;
     }
 
-    inline std::uint64_t get_upper() const {
-        return UPPER;
-    }
-
-    inline std::uint64_t get_lower() const {
-        return LOWER;
-    }
+    inline constexpr std::uint64_t get_upper() const;
+    inline constexpr std::uint64_t get_lower() const;
 
     void swap();
 
@@ -67,10 +92,10 @@ public:
 
     void dump_status() const;
 
-    operator bool() const;
+    constexpr operator bool() const;
 
 #define OPERATOR_TYPE(TYPE) \
-operator TYPE() const
+constexpr operator TYPE() const
 
     OPERATOR_TYPE(std::uint8_t);
     OPERATOR_TYPE(std::uint16_t);
@@ -84,13 +109,10 @@ operator TYPE() const
     OPERATOR_TYPE(long long);
 
 #undef OPERATOR_TYPE
-  
-    Uint128_t &operator=(const Uint128_t &rhs);
-    Uint128_t &operator=(Uint128_t &&rhs);
-  
-#define OPERATOR_BITWISE(BITWISE)                       \
-Uint128_t operator BITWISE(const Uint128_t &rhs) const; \
-Uint128_t &operator BITWISE##=(const Uint128_t & rhs);
+
+#define OPERATOR_BITWISE(BITWISE)                                 \
+constexpr Uint128_t operator BITWISE(const Uint128_t &rhs) const; \
+constexpr Uint128_t &operator BITWISE##=(const Uint128_t & rhs);
 
     OPERATOR_BITWISE(&);
     OPERATOR_BITWISE(|);
@@ -98,33 +120,34 @@ Uint128_t &operator BITWISE##=(const Uint128_t & rhs);
    
 #undef OPERATOR_BITWISE
 
-    Uint128_t operator~() const;
+    constexpr Uint128_t operator~() const;
 
-    Uint128_t operator+() const;
-    Uint128_t operator-() const;
-   
-    Uint128_t operator<<(const int shift) const;
-    Uint128_t &operator<<=(const int shift);
-    Uint128_t operator>>(const int shift) const;
-    Uint128_t &operator>>=(const int shift);
+    constexpr Uint128_t operator+() const;
+    constexpr Uint128_t operator-() const;
+
+    // Shifting by a negative number or by more than 127 bits gives zero.
+    constexpr Uint128_t operator<<(const int shift) const;
+    constexpr Uint128_t &operator<<=(const int shift);
+    constexpr Uint128_t operator>>(const int shift) const;
+    constexpr Uint128_t &operator>>=(const int shift);
     
-    bool operator!() const;
-    bool operator&&(const Uint128_t &rhs) const;
-    bool operator||(const Uint128_t &rhs) const;
-    bool operator==(const Uint128_t &rhs) const;
-    bool operator!=(const Uint128_t &rhs) const;
-    bool operator>(const Uint128_t &rhs) const;
-    bool operator<(const Uint128_t &rhs) const;
-    bool operator>=(const Uint128_t &rhs) const;
-    bool operator<=(const Uint128_t &rhs) const;
-
-    Uint128_t operator+(const Uint128_t &rhs) const;
-    Uint128_t operator+(const int i) const;
-    Uint128_t &operator+=(const Uint128_t &rhs);
+    constexpr bool operator!() const;
+    constexpr bool operator&&(const Uint128_t &rhs) const;
+    constexpr bool operator||(const Uint128_t &rhs) const;
+    constexpr bool operator==(const Uint128_t &rhs) const;
+    constexpr bool operator!=(const Uint128_t &rhs) const;
+    constexpr bool operator>(const Uint128_t &rhs) const;
+    constexpr bool operator<(const Uint128_t &rhs) const;
+    constexpr bool operator>=(const Uint128_t &rhs) const;
+    constexpr bool operator<=(const Uint128_t &rhs) const;
+
+    constexpr Uint128_t operator+(const Uint128_t &rhs) const;
+    constexpr Uint128_t operator+(const int i) const;
+    constexpr Uint128_t &operator+=(const Uint128_t &rhs);
     
-    Uint128_t operator-(const Uint128_t &rhs) const;
-    Uint128_t operator-(const int i) const;
-    Uint128_t &operator-=(const Uint128_t &rhs);
+    constexpr Uint128_t operator-(const Uint128_t &rhs) const;
+    constexpr Uint128_t operator-(const int i) const;
+    constexpr Uint128_t &operator-=(const Uint128_t &rhs);
 };
 
 static constexpr Uint128_t tie(std::uint64_t upper, std::uint64_t lower) {
@@ -139,13 +162,23 @@ static constexpr Uint128_t tie(std::uint64_t upper, std::uint64_t lower) {
 static constexpr Uint128_t uint128_0(0ULL);
 static constexpr Uint128_t uint128_1(1ULL);
 
-inline Uint128_t::operator bool() const {
-    return static_cast<bool>(UPPER | LOWER);
+#ifdef UINT128_NATIVE
+
+inline constexpr std::uint64_t Uint128_t::get_upper() const {
+    return static_cast<std::uint64_t>(VALUE >> 64);
+}
+
+inline constexpr std::uint64_t Uint128_t::get_lower() const {
+    return static_cast<std::uint64_t>(VALUE);
 }
 
-#define OPERATOR_TYPE(TYPE)                 \
-inline Uint128_t::operator TYPE() const {   \
-  return static_cast<TYPE>(LOWER);          \
+inline constexpr Uint128_t::operator bool() const {
+    return VALUE != 0;
+}
+
+#define OPERATOR_TYPE(TYPE)                           \
+inline constexpr Uint128_t::operator TYPE() const {   \
+  return static_cast<TYPE>(VALUE);                    \
 }
 
     OPERATOR_TYPE(std::uint8_t);
@@ -161,34 +194,103 @@ inline Uint128_t::operator TYPE() const {   \
 
 #undef OPERATOR_TYPE
 
+#define OPERATOR_BITWISE(BITWISE)                           \
+inline constexpr Uint128_t Uint128_t::operator BITWISE(     \
+              const Uint128_t &rhs) const {                 \
+    return Uint128_t(VALUE BITWISE rhs.VALUE, NativeTag{}); \
+}                                                           \
+inline constexpr Uint128_t &Uint128_t::operator BITWISE##=( \
+               const Uint128_t &rhs){                       \
+    VALUE BITWISE##= rhs.VALUE;                             \
+    return *this;                                           \
+}
 
-inline Uint128_t &Uint128_t::operator=(const Uint128_t &rhs) {
-    UPPER = rhs.UPPER;
-    LOWER = rhs.LOWER;
-    return *this;
+    OPERATOR_BITWISE(&);
+    OPERATOR_BITWISE(|);
+    OPERATOR_BITWISE(^);
+
+#undef OPERATOR_BITWISE
+
+inline constexpr Uint128_t Uint128_t::operator~() const {
+    return Uint128_t(~VALUE, NativeTag{});
 }
 
-inline Uint128_t &Uint128_t::operator=(Uint128_t &&rhs) {
-    if (this != &rhs) {
-        UPPER = std::move(rhs.UPPER);
-        LOWER = std::move(rhs.LOWER);
-        rhs.UPPER = 0ULL;
-        rhs.LOWER = 0ULL;
-    }
+inline constexpr Uint128_t Uint128_t::operator+() const {
     return *this;
 }
 
-#define OPERATOR_BITWISE(BITWISE)                 \
-inline Uint128_t Uint128_t::operator BITWISE(     \
-              const Uint128_t &rhs) const {       \
-    return Uint128_t(UPPER BITWISE rhs.UPPER,     \
-                    LOWER BITWISE rhs.LOWER);     \
-}                                                 \
-inline Uint128_t &Uint128_t::operator BITWISE##=( \
-               const Uint128_t &rhs){             \
-    UPPER BITWISE##= rhs.UPPER;                   \
-    LOWER BITWISE##= rhs.LOWER;                   \
-    return *this;                                 \
+inline constexpr Uint128_t Uint128_t::operator-() const {
+    return Uint128_t(-VALUE, NativeTag{});
+}
+
+// The range check becomes a conditional move, not a branch.
+inline constexpr Uint128_t Uint128_t::operator<<(const int shift) const {
+    return Uint128_t(static_cast<unsigned>(shift) < 128 ? VALUE << shift : 0, NativeTag{});
+}
+
+inline constexpr Uint128_t Uint128_t::operator>>(const int shift) const {
+    return Uint128_t(static_cast<unsigned>(shift) < 128 ? VALUE >> shift : 0, NativeTag{});
+}
+
+inline constexpr bool Uint128_t::operator==(const Uint128_t &rhs) const {
+    return VALUE == rhs.VALUE;
+}
+
+inline constexpr bool Uint128_t::operator>(const Uint128_t &rhs) const {
+    return VALUE > rhs.VALUE;
+}
+
+inline constexpr Uint128_t Uint128_t::operator+(const Uint128_t &rhs) const {
+    return Uint128_t(VALUE + rhs.VALUE, NativeTag{});
+}
+
+inline constexpr Uint128_t Uint128_t::operator-(const Uint128_t &rhs) const {
+    return Uint128_t(VALUE - rhs.VALUE, NativeTag{});
+}
+
+#else
+
+inline constexpr std::uint64_t Uint128_t::get_upper() const {
+    return UPPER;
+}
+
+inline constexpr std::uint64_t Uint128_t::get_lower() const {
+    return LOWER;
+}
+
+inline constexpr Uint128_t::operator bool() const {
+    return static_cast<bool>(UPPER | LOWER);
+}
+
+#define OPERATOR_TYPE(TYPE)                           \
+inline constexpr Uint128_t::operator TYPE() const {   \
+  return static_cast<TYPE>(LOWER);                    \
+}
+
+    OPERATOR_TYPE(std::uint8_t);
+    OPERATOR_TYPE(std::uint16_t);
+    OPERATOR_TYPE(std::uint32_t);
+    OPERATOR_TYPE(std::uint64_t);
+  
+    OPERATOR_TYPE(char);
+    OPERATOR_TYPE(short);
+    OPERATOR_TYPE(int);
+    OPERATOR_TYPE(long);
+    OPERATOR_TYPE(long long);
+
+#undef OPERATOR_TYPE
+
+#define OPERATOR_BITWISE(BITWISE)                           \
+inline constexpr Uint128_t Uint128_t::operator BITWISE(     \
+              const Uint128_t &rhs) const {                 \
+    return Uint128_t(UPPER BITWISE rhs.UPPER,               \
+                    LOWER BITWISE rhs.LOWER);               \
+}                                                           \
+inline constexpr Uint128_t &Uint128_t::operator BITWISE##=( \
+               const Uint128_t &rhs){                       \
+    UPPER BITWISE##= rhs.UPPER;                             \
+    LOWER BITWISE##= rhs.LOWER;                             \
+    return *this;                                           \
 }
 
     OPERATOR_BITWISE(&);
@@ -197,21 +299,19 @@ inline Uint128_t &Uint128_t::operator BITWISE##=( \
 
 #undef OPERATOR_BITWISE
 
-inline Uint128_t Uint128_t::operator ~() const {
+inline constexpr Uint128_t Uint128_t::operator~() const {
     return Uint128_t(~UPPER, ~LOWER);
 }
 
-inline Uint128_t Uint128_t::operator+() const{
+inline constexpr Uint128_t Uint128_t::operator+() const {
     return *this;
 }
 
-inline Uint128_t Uint128_t::operator-() const{
+inline constexpr Uint128_t Uint128_t::operator-() const {
     return ~*this + uint128_1;
 }
 
-
-inline Uint128_t Uint128_t::operator<<(const int shift) const {
-
+inline constexpr Uint128_t Uint128_t::operator<<(const int shift) const {
     if (shift == 0) {
         return *this;
     }
@@ -225,18 +325,10 @@ inline Uint128_t Uint128_t::operator<<(const int shift) const {
     else if (shift > 64 && shift < 128) {
         return Uint128_t(LOWER << (shift-64), 0ULL);
     }
-    else {
-        return uint128_0;
-    }
+    return uint128_0;
 }
 
-inline Uint128_t &Uint128_t::operator<<=(const int shift) {
-    *this = *this << shift;
-    return *this;
-}
-
-inline Uint128_t Uint128_t::operator>>(const int shift) const {
-
+inline constexpr Uint128_t Uint128_t::operator>>(const int shift) const {
     if (shift == 0) {
         return *this;
     }
@@ -250,91 +342,91 @@ inline Uint128_t Uint128_t::operator>>(const int shift) const {
     else if (shift > 64 && shift < 128) {
         return Uint128_t(0ULL, UPPER >> (shift-64));
     }
-    else {
-        return uint128_0;
-    }
+    return uint128_0;
 }
 
-inline Uint128_t &Uint128_t::operator>>=(const int shift) {
-    *this = *this >> shift;
-    return *this;
+inline constexpr bool Uint128_t::operator==(const Uint128_t &rhs) const {
+    return (UPPER == rhs.UPPER) && (LOWER == rhs.LOWER);
 }
 
-inline bool Uint128_t::operator!() const {
-    return !static_cast<bool>(UPPER | LOWER);
+inline constexpr bool Uint128_t::operator>(const Uint128_t &rhs) const {
+    return (UPPER > rhs.UPPER) ||
+               ((LOWER > rhs.LOWER) && (UPPER == rhs.UPPER));
 }
 
-inline bool Uint128_t::operator&&(const Uint128_t &rhs) const {
-    return (static_cast<bool>(*this) && rhs);
+inline constexpr Uint128_t Uint128_t::operator+(const Uint128_t &rhs) const {
+    const auto new_lower = LOWER + rhs.LOWER;
+    const auto carry = static_cast<std::uint64_t>(new_lower < LOWER);
+    return Uint128_t(UPPER + rhs.UPPER + carry, new_lower);
 }
 
-inline bool Uint128_t::operator||(const Uint128_t &rhs) const {
-    return (static_cast<bool>(*this) || rhs);
+inline constexpr Uint128_t Uint128_t::operator-(const Uint128_t &rhs) const {
+    const auto new_lower = LOWER - rhs.LOWER;
+    const auto borrow = static_cast<std::uint64_t>(new_lower > LOWER);
+    return Uint128_t(UPPER - rhs.UPPER - borrow, new_lower);
 }
 
-inline bool Uint128_t::operator==(const Uint128_t &rhs) const {
-    return ((UPPER == rhs.UPPER) && (LOWER == rhs.LOWER));
+#endif
+
+/*
+ * The operators below are built on the backend ones.
+ */
+
+inline constexpr Uint128_t &Uint128_t::operator<<=(const int shift) {
+    *this = *this << shift;
+    return *this;
+}
+
+inline constexpr Uint128_t &Uint128_t::operator>>=(const int shift) {
+    *this = *this >> shift;
+    return *this;
 }
 
-inline bool Uint128_t::operator!=(const Uint128_t &rhs) const {
-    return ((UPPER != rhs.UPPER) | (LOWER != rhs.LOWER));
+inline constexpr bool Uint128_t::operator!() const {
+    return !static_cast<bool>(*this);
 }
 
-inline bool Uint128_t::operator>(const Uint128_t &rhs) const {
-    return (UPPER > rhs.UPPER) ||
-               ((LOWER > rhs.LOWER) && (UPPER == rhs.UPPER));
+inline constexpr bool Uint128_t::operator&&(const Uint128_t &rhs) const {
+    return static_cast<bool>(*this) && static_cast<bool>(rhs);
 }
 
-inline bool Uint128_t::operator<(const Uint128_t &rhs) const {
-    return (UPPER < rhs.UPPER) ||
-               ((LOWER < rhs.LOWER) && (UPPER == rhs.UPPER));
+inline constexpr bool Uint128_t::operator||(const Uint128_t &rhs) const {
+    return static_cast<bool>(*this) || static_cast<bool>(rhs);
 }
 
-inline bool Uint128_t::operator>=(const Uint128_t &rhs) const {
-    return (UPPER < rhs.UPPER) ||
-               ((LOWER <= rhs.LOWER) && (UPPER == rhs.UPPER));
+inline constexpr bool Uint128_t::operator!=(const Uint128_t &rhs) const {
+    return !(*this == rhs);
 }
 
-inline bool Uint128_t::operator<=(const Uint128_t &rhs) const {
-    return (UPPER < rhs.UPPER) ||
-               ((LOWER >= rhs.LOWER) && (UPPER == rhs.UPPER));
+inline constexpr bool Uint128_t::operator<(const Uint128_t &rhs) const {
+    return rhs > *this;
 }
 
-inline Uint128_t Uint128_t::operator+(const Uint128_t &rhs) const {
-    std::uint64_t new_lower = LOWER + rhs.LOWER;
-    std::uint64_t carry = static_cast<std::uint64_t>(new_lower < LOWER);
-    return Uint128_t(UPPER + rhs.UPPER + carry, new_lower);
+inline constexpr bool Uint128_t::operator>=(const Uint128_t &rhs) const {
+    return !(rhs > *this);
 }
 
-inline Uint128_t Uint128_t::operator+(const int i) const {
-    std::uint64_t new_lower = LOWER + i;
-    std::uint64_t carry = static_cast<std::uint64_t>(new_lower < LOWER);
-    return Uint128_t(UPPER + carry, new_lower);
+inline constexpr bool Uint128_t::operator<=(const Uint128_t &rhs) const {
+    return !(*this > rhs);
 }
 
-inline Uint128_t Uint128_t::operator-(const Uint128_t &rhs) const {
-    std::uint64_t new_lower = LOWER - rhs.LOWER;
-    std::uint64_t carry = static_cast<std::uint64_t>(new_lower > LOWER);
-    return Uint128_t(UPPER - rhs.UPPER - carry, new_lower);
+inline constexpr Uint128_t Uint128_t::operator+(const int i) const {
+    return i >= 0 ? *this + Uint128_t(static_cast<std::uint64_t>(i)) :
+                        *this - Uint128_t(static_cast<std::uint64_t>(-static_cast<long long>(i)));
 }
 
-inline Uint128_t Uint128_t::operator-(const int i) const {
-    std::uint64_t new_lower = LOWER - i;
-    std::uint64_t carry = static_cast<std::uint64_t>(new_lower > LOWER);
-    return Uint128_t(UPPER - carry, new_lower);
+inline constexpr Uint128_t Uint128_t::operator-(const int i) const {
+    return i >= 0 ? *this - Uint128_t(static_cast<std::uint64_t>(i)) :
+                        *this + Uint128_t(static_cast<std::uint64_t>(-static_cast<long long>(i)));
 }
 
-inline Uint128_t &Uint128_t::operator+=(const Uint128_t &rhs) {
-    std::uint64_t new_lower = LOWER + rhs.LOWER;
-    UPPER += rhs.UPPER + static_cast<std::uint64_t>(new_lower < LOWER);
-    LOWER += new_lower;
+inline constexpr Uint128_t &Uint128_t::operator+=(const Uint128_t &rhs) {
+    *this = *this + rhs;
     return *this;
 }
 
-inline Uint128_t &Uint128_t::operator-=(const Uint128_t &rhs) {
-    std::uint64_t new_lower = LOWER - rhs.LOWER;
-    UPPER -= rhs.UPPER - static_cast<std::uint64_t>(new_lower < LOWER);
-    LOWER -= new_lower;
+inline constexpr Uint128_t &Uint128_t::operator-=(const Uint128_t &rhs) {
+    *this = *this - rhs;
     return *this;
 }
 #endif
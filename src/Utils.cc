@@ -27,6 +27,13 @@
 #include "Utils.h"
 #include "config.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace Utils {
 
 static constexpr auto z_entries = 1000;
@@ -603,6 +610,74 @@ const std::vector<float>& Utils::Timer::get_record() const {
     return m_record;
 }
 
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string &filename) {
+    close();
+#ifdef _WIN32
+    // No mapping on Windows, read the whole file instead.
+    auto file = std::ifstream(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    m_buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0, std::ios::beg);
+    if (!file.read(m_buffer.data(), m_buffer.size())) {
+        m_buffer.clear();
+        return false;
+    }
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    return true;
+#else
+    const auto fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    const auto size = static_cast<size_t>(st.st_size);
+    auto ptr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+
+    // The mapping keeps the file, we don't need the descriptor.
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const char *>(ptr);
+    m_size = size;
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    m_buffer.clear();
+    m_buffer.shrink_to_fit();
+#else
+    if (m_data) {
+        munmap(const_cast<char *>(m_data), m_size);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+const char *MappedFile::data() const {
+    return m_data;
+}
+
+size_t MappedFile::size() const {
+    return m_size;
+}
+
 BitIterator::BitIterator(const size_t s) {
     if (s < 64) {
         m_size = s;
@@ -255,6 +255,30 @@ private:
     size_t record_count;
 };
 
+// A read-only mapping of the whole file. The processes which map the
+// same file share its pages in the page cache.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string &filename);
+    void close();
+
+    const char *data() const;
+    size_t size() const;
+
+private:
+    const char *m_data{nullptr};
+    size_t m_size{0};
+#ifdef _WIN32
+    std::vector<char> m_buffer;
+#endif
+};
+
 class BitIterator {
 public :
     BitIterator() = delete;
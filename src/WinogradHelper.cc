@@ -19,7 +19,61 @@
 #include "WinogradHelper.h"
 #include "Blas.h"
 
-std::vector<float> Winograd::transform_f(const std::vector<float> &f,
+#include <cassert>
+#include <cstring>
+
+// The kernels are written with the GCC vector extension. The compiler
+// generates one version for each instruction set, the best one is
+// selected when the program starts.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define WINOGRAD_DISPATCH __attribute__((target_clones("arch=skylake-avx512", "arch=haswell", "default")))
+#else
+#define WINOGRAD_DISPATCH
+#endif
+
+#define WINOGRAD_INLINE inline __attribute__((always_inline))
+
+// The vectors are never passed or returned by value. Their ABI differs
+// between the AVX512 clone and the others, and GCC warns about it.
+static constexpr auto VEC_WIDTH = 16;
+typedef float WinogradVec __attribute__((vector_size(VEC_WIDTH * sizeof(float))));
+
+template <typename T>
+WINOGRAD_INLINE void load_vec(T &v, const float *ptr) {
+    std::memcpy(&v, ptr, sizeof(T));
+}
+
+template <typename T>
+WINOGRAD_INLINE void store_vec(float *ptr, const T &v) {
+    std::memcpy(ptr, &v, sizeof(T));
+}
+
+template <typename T>
+WINOGRAD_INLINE float get_lane(const T &v, const int lane) {
+    return v[lane];
+}
+
+template <>
+WINOGRAD_INLINE float get_lane<float>(const float &v, const int) {
+    return v;
+}
+
+template <typename T>
+WINOGRAD_INLINE void add_lane(T &v, const int lane, const float val) {
+    v[lane] += val;
+}
+
+template <>
+WINOGRAD_INLINE void add_lane<float>(float &v, const int, const float val) {
+    v += val;
+}
+
+template <typename T>
+WINOGRAD_INLINE void relu(T &v) {
+    v = v > T{} ? v : T{};
+}
+
+std::vector<float> Winograd::transform_f(const FloatWeights &f,
                                          const int outputs,
                                          const int channels) {
     // F(4x4, 3x3) Winograd filter transformation
@@ -86,227 +140,384 @@ std::vector<float> Winograd::transform_f(const std::vector<float> &f,
     return U;
 }
 
-void Winograd::transform_in(const std::vector<float> &in,
-                            std::vector<float> &V, const int C) {
-
-    static constexpr auto Wpad_X = 2 + WINOGRAD_M * WTILES_X;
-    static constexpr auto Wpad_Y = 2 + WINOGRAD_M * WTILES_Y;
-    static constexpr auto buffersize = 32;
-
-    std::array<std::array<float, Wpad_Y>, Wpad_X> in_pad{0.0f};
-    std::array<float, buffersize * WINOGRAD_ALPHA * WINOGRAD_ALPHA> buffer;
-    int buffer_offset = 0;
-    int buffer_entries = 0;
-
-    // multiple vector [i0..i5] by Bt and produce [o0..o5]
-    // const auto Bt = std::array<float, WINOGRAD_TILE>
-    //           {1.0f,  0.0f,     -5.0f/2.0f,  0.0f,      1.0f, 0.0f,
-    //            0.0f, -SQ2,      -2.0f,       SQ2/2.0f,  1.0f, 0.0f,
-    //            0.0f,  SQ2,      -2.0f,      -SQ2/2.0f,  1.0f, 0.0f,
-    //            0.0f, -SQ2/2.0f, -1.0f/2.0f,  SQ2,       1.0f, 0.0f,
-    //            0.0f,  SQ2/2.0f, -1.0f/2.0f, -SQ2,       1.0f, 0.0f,
-    //            0.0f,  1.0f,      0.0f,      -5.0f/2.0f, 0.0f, 1.0f};
-    const auto multiply_bt = [](float &o0, float &o1, float &o2, float &o3, float &o4,
-                                float &o5, float i0, float i1, float i2, float i3,
-                                float i4, float i5) {
-        auto i3m1 = i1 * -SQ2 + i3 * (SQ2 / 2.0f);
-        auto i4m2 = i2 * -2.0f + i4 * 1.0f;
-
-        o0 = i0 + i2 * (-5.0f / 2.0f) + i4;
-        o1 = i3m1 + i4m2;
-        o2 = -i3m1 + i4m2;
-
-        auto i3m1_2 = i3 * (SQ2) + i1 * (-SQ2 / 2.0f);
-        auto i4m2_2 = i2 * (-1.0f / 2.0f) + i4;
-
-        o3 = i3m1_2 + i4m2_2;
-        o4 = -i3m1_2 + i4m2_2;
-
-        o5 = i1 + i3 * (-5.0f / 2.0f) + i5;
-    };
-
-    for (auto ch = 0; ch < C; ch++) {
-        for (auto yin = 0; yin < H; yin++) {
-            for (auto xin = 0; xin < W; xin++) {
-                in_pad[yin + 1][xin + 1] = in[ch * (W * H) + yin * W + xin];
-            }
+// multiple vector [i0..i5] by Bt and produce [o0..o5]
+// const auto Bt = std::array<float, WINOGRAD_TILE>
+//           {1.0f,  0.0f,     -5.0f/2.0f,  0.0f,      1.0f, 0.0f,
+//            0.0f, -SQ2,      -2.0f,       SQ2/2.0f,  1.0f, 0.0f,
+//            0.0f,  SQ2,      -2.0f,      -SQ2/2.0f,  1.0f, 0.0f,
+//            0.0f, -SQ2/2.0f, -1.0f/2.0f,  SQ2,       1.0f, 0.0f,
+//            0.0f,  SQ2/2.0f, -1.0f/2.0f, -SQ2,       1.0f, 0.0f,
+//            0.0f,  1.0f,      0.0f,      -5.0f/2.0f, 0.0f, 1.0f};
+template <typename T>
+WINOGRAD_INLINE void multiply_bt(T &o0, T &o1, T &o2, T &o3, T &o4, T &o5,
+                                 const T &i0, const T &i1, const T &i2,
+                                 const T &i3, const T &i4, const T &i5) {
+    const T i3m1 = i1 * -SQ2 + i3 * (SQ2 / 2.0f);
+    const T i4m2 = i2 * -2.0f + i4;
+
+    o0 = i0 + i2 * (-5.0f / 2.0f) + i4;
+    o1 = i3m1 + i4m2;
+    o2 = -i3m1 + i4m2;
+
+    const T i3m1_2 = i3 * (SQ2) + i1 * (-SQ2 / 2.0f);
+    const T i4m2_2 = i2 * (-1.0f / 2.0f) + i4;
+
+    o3 = i3m1_2 + i4m2_2;
+    o4 = -i3m1_2 + i4m2_2;
+
+    o5 = i1 + i3 * (-5.0f / 2.0f) + i5;
+}
+
+// multiple vector [i0..i5] by At and produce [o0..o3]
+// const auto At = std::array<float, WINOGRAD_ALPHA * WINOGRAD_M>
+//       {1.0f, 1.0f,      1.0f,       1.0f,      1.0f,     0.0f,
+//        0.0f, SQ2/2.0f, -SQ2/2.0f,   SQ2,      -SQ2,      0.0f,
+//        0.0f, 1.0f/2.0f, 1.0f/2.0f,  2.0f,      2.0f,     0.0f,
+//        0.0f, SQ2/4.0f, -SQ2/4.0f,   2.0f*SQ2, -2.0f*SQ2, 1.0f};
+template <typename T>
+WINOGRAD_INLINE void multiply_at(T &o0, T &o1, T &o2, T &o3,
+                                 const T &i0, const T &i1, const T &i2,
+                                 const T &i3, const T &i4, const T &i5) {
+    const T t1p2 = (i1 + i2) * (1.0f / 2.0f);
+    const T t1m2 = (i1 - i2) * (SQ2 / 4.0f);
+    const T t3p4 = i3 + i4;
+    const T t3m4 = (i3 - i4) * (SQ2);
+
+    o0 = i0 + t1p2 + t1p2 + t3p4;
+    o1 = t1m2 + t1m2 + t3m4;
+    o2 = t1p2 + t3p4 + t3p4;
+    o3 = t1m2 + t3m4 + t3m4 + i5;
+}
+
+// Calculates transpose(B).d.B of one tile. The T is the vector of
+// channels or one float for the remaining channels.
+template <typename T>
+WINOGRAD_INLINE void transform_in_tile(const float *src,
+                                       const int pixel_stride,
+                                       const int row_stride,
+                                       float *dst,
+                                       const int tile_stride) {
+    T d[WINOGRAD_ALPHA][WINOGRAD_ALPHA];
+    T t1[WINOGRAD_ALPHA][WINOGRAD_ALPHA];
+
+    for (int i = 0; i < WINOGRAD_ALPHA; ++i) {
+        for (int j = 0; j < WINOGRAD_ALPHA; ++j) {
+            load_vec(d[i][j], src + i * row_stride + j * pixel_stride);
         }
-        for (auto block_y = 0; block_y < WTILES_Y; block_y++) {
-            // Tiles overlap by 2
-            const auto yin = WINOGRAD_M * block_y;
-            for (auto block_x = 0; block_x < WTILES_X; block_x++) {
-                const auto xin = WINOGRAD_M * block_x;
-#define DECL_T1(XX)                                                            \
-  float T1_##XX##_0, T1_##XX##_1, T1_##XX##_2, T1_##XX##_3, T1_##XX##_4,       \
-      T1_##XX##_5;
-                DECL_T1(0)
-                DECL_T1(1)
-                DECL_T1(2)
-                DECL_T1(3)
-                DECL_T1(4)
-                DECL_T1(5)
-
-              // Calculates transpose(B).x.B
-#define MULTIPLY_BT(XX)                                                        \
-  multiply_bt(T1_0_##XX, T1_1_##XX, T1_2_##XX, T1_3_##XX, T1_4_##XX,           \
-              T1_5_##XX, in_pad[yin + 0][xin + XX], in_pad[yin + 1][xin + XX], \
-              in_pad[yin + 2][xin + XX], in_pad[yin + 3][xin + XX],            \
-              in_pad[yin + 4][xin + XX], in_pad[yin + 5][xin + XX]);
-                MULTIPLY_BT(0)
-                MULTIPLY_BT(1)
-                MULTIPLY_BT(2)
-                MULTIPLY_BT(3)
-                MULTIPLY_BT(4)
-                MULTIPLY_BT(5)
-
-#define MULTIPLY_B(XX)                                                         \
-  multiply_bt(buffer[buffersize * (XX * WINOGRAD_ALPHA + 0) + buffer_entries], \
-              buffer[buffersize * (XX * WINOGRAD_ALPHA + 1) + buffer_entries], \
-              buffer[buffersize * (XX * WINOGRAD_ALPHA + 2) + buffer_entries], \
-              buffer[buffersize * (XX * WINOGRAD_ALPHA + 3) + buffer_entries], \
-              buffer[buffersize * (XX * WINOGRAD_ALPHA + 4) + buffer_entries], \
-              buffer[buffersize * (XX * WINOGRAD_ALPHA + 5) + buffer_entries], \
-              T1_##XX##_0, T1_##XX##_1, T1_##XX##_2, T1_##XX##_3, T1_##XX##_4, \
-              T1_##XX##_5);
-                MULTIPLY_B(0)
-                MULTIPLY_B(1)
-                MULTIPLY_B(2)
-                MULTIPLY_B(3)
-                MULTIPLY_B(4)
-                MULTIPLY_B(5)
-
-                if (buffer_entries == 0) {
-                    buffer_offset = ch * P + block_y * WTILES_X + block_x;
-                }
-                buffer_entries++;
+    }
+    for (int j = 0; j < WINOGRAD_ALPHA; ++j) {
+        multiply_bt(t1[0][j], t1[1][j], t1[2][j], t1[3][j], t1[4][j], t1[5][j],
+                    d[0][j], d[1][j], d[2][j], d[3][j], d[4][j], d[5][j]);
+    }
+    for (int i = 0; i < WINOGRAD_ALPHA; ++i) {
+        multiply_bt(d[i][0], d[i][1], d[i][2], d[i][3], d[i][4], d[i][5],
+                    t1[i][0], t1[i][1], t1[i][2], t1[i][3], t1[i][4], t1[i][5]);
+    }
+    for (int i = 0; i < WINOGRAD_ALPHA; ++i) {
+        for (int j = 0; j < WINOGRAD_ALPHA; ++j) {
+            store_vec<T>(dst + (i * WINOGRAD_ALPHA + j) * tile_stride, d[i][j]);
+        }
+    }
+}
 
-                if (buffer_entries >= buffersize ||
-                    (ch == C - 1 && block_x == WTILES_X - 1 && block_y == WTILES_Y - 1)) {
+// Calculates transpose(A).m.A of one tile.
+template <typename T>
+WINOGRAD_INLINE void transform_out_tile(const float *src,
+                                        const int tile_stride,
+                                        T (&o)[WINOGRAD_M][WINOGRAD_M]) {
+    T m[WINOGRAD_ALPHA][WINOGRAD_ALPHA];
+    T temp[WINOGRAD_M][WINOGRAD_ALPHA];
+
+    for (int i = 0; i < WINOGRAD_ALPHA; ++i) {
+        for (int j = 0; j < WINOGRAD_ALPHA; ++j) {
+            load_vec(m[i][j], src + (i * WINOGRAD_ALPHA + j) * tile_stride);
+        }
+    }
+    for (int j = 0; j < WINOGRAD_ALPHA; ++j) {
+        multiply_at(temp[0][j], temp[1][j], temp[2][j], temp[3][j],
+                    m[0][j], m[1][j], m[2][j], m[3][j], m[4][j], m[5][j]);
+    }
+    for (int i = 0; i < WINOGRAD_M; ++i) {
+        multiply_at(o[i][0], o[i][1], o[i][2], o[i][3],
+                    temp[i][0], temp[i][1], temp[i][2], temp[i][3], temp[i][4], temp[i][5]);
+    }
+}
 
-                    for (auto i = 0; i < WINOGRAD_ALPHA * WINOGRAD_ALPHA; i++) {
-                        for (auto entry = 0; entry < buffer_entries; entry++) {
-                            V[i * C * P + buffer_offset + entry] =
-                                buffer[i * buffersize + entry];
-                        }
-                    }
-                    buffer_entries = 0;
-                }
+// Compute R rows and NV vectors of columns of M = V.U.
+template <int R, int NV>
+WINOGRAD_INLINE void sgemm_tile(const int C, const int K,
+                                const float *V, const float *U, float *M) {
+    WinogradVec acc[R][NV];
+    for (int r = 0; r < R; ++r) {
+        for (int n = 0; n < NV; ++n) {
+            acc[r][n] = WinogradVec{};
+        }
+    }
+    for (int c = 0; c < C; ++c) {
+        WinogradVec u[NV];
+        for (int n = 0; n < NV; ++n) {
+            load_vec(u[n], U + c * K + n * VEC_WIDTH);
+        }
+        for (int r = 0; r < R; ++r) {
+            const auto v = V[r * C + c];
+            for (int n = 0; n < NV; ++n) {
+                acc[r][n] += v * u[n];
             }
         }
     }
+    for (int r = 0; r < R; ++r) {
+        for (int n = 0; n < NV; ++n) {
+            store_vec<WinogradVec>(M + r * K + n * VEC_WIDTH, acc[r][n]);
+        }
+    }
 }
 
-void Winograd::sgemm(const std::vector<float> &U,
-                     const std::vector<float> &V,
-                     std::vector<float> &M, const int C,
-                     const int K) {
+template <int R>
+WINOGRAD_INLINE void sgemm_rows(const int C, const int K,
+                                const float *V, const float *U, float *M) {
+    auto k = 0;
+    for (; k + 2 * VEC_WIDTH <= K; k += 2 * VEC_WIDTH) {
+        sgemm_tile<R, 2>(C, K, V, U + k, M + k);
+    }
+    for (; k + VEC_WIDTH <= K; k += VEC_WIDTH) {
+        sgemm_tile<R, 1>(C, K, V, U + k, M + k);
+    }
+    for (; k < K; ++k) {
+        for (int r = 0; r < R; ++r) {
+            auto acc = 0.0f;
+            for (int c = 0; c < C; ++c) {
+                acc += V[r * C + c] * U[c * K + k];
+            }
+            M[r * K + k] = acc;
+        }
+    }
+}
 
-    for (int b = 0; b < WINOGRAD_TILE; b++) {
-        const auto u_offset = b * K * C;
-        const auto v_offset = b * C * P;
-        const auto m_offset = b * K * P;
-
-        Blas::winograd_gemm(u_offset,
-                            v_offset,
-                            m_offset,
-                            K,
-                            P,
-                            C,
-                            1.0f,
-                            U.data(),
-                            K,
-                            V.data(),
-                            P,
-                            0.0f,
-                            M.data(),
-                            P);
+WINOGRAD_DISPATCH
+static void winograd_transform_in(const int tiles,
+                                  const int C,
+                                  const int row_stride,
+                                  const int *offsets,
+                                  const float *pad,
+                                  float *V) {
+    const auto pixel_stride = C;
+    const auto tile_stride = tiles * C;
+    for (int t = 0; t < tiles; ++t) {
+        const auto src = pad + offsets[t];
+        auto c = 0;
+        for (; c + VEC_WIDTH <= C; c += VEC_WIDTH) {
+            transform_in_tile<WinogradVec>(src + c, pixel_stride, row_stride,
+                                           V + t * C + c, tile_stride);
+        }
+        for (; c < C; ++c) {
+            transform_in_tile<float>(src + c, pixel_stride, row_stride,
+                                     V + t * C + c, tile_stride);
+        }
     }
 }
 
-void Winograd::transform_out(const std::vector<float> &M,
-                             std::vector<float> &Y, const int K) {
-
-    // multiple vector [i0..i5] by At and produce [o0..o3]
-    // const auto At = std::array<float, WINOGRAD_ALPHA * WINOGRAD_M>
-    //       {1.0f, 1.0f,      1.0f,       1.0f,      1.0f,     0.0f,
-    //        0.0f, SQ2/2.0f, -SQ2/2.0f,   SQ2,      -SQ2,      0.0f,
-    //        0.0f, 1.0f/2.0f, 1.0f/2.0f,  2.0f,      2.0f,     0.0f,
-    //        0.0f, SQ2/4.0f, -SQ2/4.0f,   2.0f*SQ2, -2.0f*SQ2, 1.0f};
-    const auto multiply_at = [](float &o0, float &o1, float &o2, float &o3, float i0,
-                                float i1, float i2, float i3, float i4, float i5) {
-        auto t1p2 = (i1 + i2) * (1.0f / 2.0f);
-        auto t1m2 = (i1 - i2) * (SQ2 / 4.0f);
-        auto t3p4 = i3 + i4;
-        auto t3m4 = (i3 - i4) * (SQ2);
-
-        o0 = i0 + t1p2 + t1p2 + t3p4;
-        o1 = t1m2 + t1m2 + t3m4;
-        o2 = t1p2 + t3p4 + t3p4;
-        o3 = t1m2 + t3m4 + t3m4 + i5;
-    };
-
-    for (auto k = 0; k < K; k++) {
-        for (auto block_x = 0; block_x < WTILES_X; block_x++) {
-            const auto x = WINOGRAD_M * block_x;
-            for (auto block_y = 0; block_y < WTILES_Y; block_y++) {
-                const auto y = WINOGRAD_M * block_y;
+WINOGRAD_DISPATCH
+static void winograd_sgemm(const int tiles,
+                           const int C,
+                           const int K,
+                           const float *U,
+                           const float *V,
+                           float *M) {
+    constexpr int R = 4;
+    for (int b = 0; b < WINOGRAD_TILE; ++b) {
+        const auto u = U + b * C * K;
+        const auto v = V + b * tiles * C;
+        const auto m = M + b * tiles * K;
+        auto t = 0;
+        for (; t + R <= tiles; t += R) {
+            sgemm_rows<R>(C, K, v + t * C, u, m + t * K);
+        }
+        for (; t < tiles; ++t) {
+            sgemm_rows<1>(C, K, v + t * C, u, m + t * K);
+        }
+    }
+}
 
-                const auto b = block_y * WTILES_X + block_x;
-                using WinogradTile =
-                    std::array<std::array<float, WINOGRAD_ALPHA>, WINOGRAD_ALPHA>;
+template <typename T>
+WINOGRAD_INLINE void write_out_tile(const T (&o)[WINOGRAD_M][WINOGRAD_M],
+                                    const int lanes,
+                                    const int x, const int y,
+                                    const float *biases,
+                                    const float *eltwise,
+                                    const bool ReLU,
+                                    float *Y) {
+    constexpr auto spatial = Board::WIDTH * Board::HEIGHT;
+    T bias;
+    load_vec(bias, biases);
+    for (int i = 0; i < WINOGRAD_M && y + i < Board::HEIGHT; ++i) {
+        for (int j = 0; j < WINOGRAD_M && x + j < Board::WIDTH; ++j) {
+            const auto offset = (y + i) * Board::WIDTH + x + j;
+            auto v = o[i][j] + bias;
+            if (eltwise) {
+                for (int l = 0; l < lanes; ++l) {
+                    add_lane(v, l, eltwise[l * spatial + offset]);
+                }
+            }
+            if (ReLU) {
+                relu(v);
+            }
+            for (int l = 0; l < lanes; ++l) {
+                Y[l * spatial + offset] = get_lane(v, l);
+            }
+        }
+    }
+}
 
-                auto temp_m = WinogradTile{};
-                for (auto xi = 0; xi < WINOGRAD_ALPHA; xi++) {
-                    for (auto nu = 0; nu < WINOGRAD_ALPHA; nu++) {
-                        temp_m[xi][nu] = M[(xi * WINOGRAD_ALPHA + nu) * K * P + k * P + b];
-                    }
+WINOGRAD_DISPATCH
+static void winograd_transform_out(const int batch_size,
+                                   const int K,
+                                   const float *M,
+                                   const float *biases,
+                                   const float *eltwise,
+                                   const bool ReLU,
+                                   float *Y) {
+    constexpr auto wtiles_x = (Board::WIDTH + WINOGRAD_M - 1) / WINOGRAD_M;
+    constexpr auto wtiles_y = (Board::HEIGHT + WINOGRAD_M - 1) / WINOGRAD_M;
+    constexpr auto spatial = Board::WIDTH * Board::HEIGHT;
+    const auto tiles = batch_size * wtiles_x * wtiles_y;
+    const auto tile_stride = tiles * K;
+
+    for (int b = 0; b < batch_size; ++b) {
+        for (int block_y = 0; block_y < wtiles_y; ++block_y) {
+            for (int block_x = 0; block_x < wtiles_x; ++block_x) {
+                const auto t = (b * wtiles_y + block_y) * wtiles_x + block_x;
+                const auto x = WINOGRAD_M * block_x;
+                const auto y = WINOGRAD_M * block_y;
+                auto k = 0;
+                for (; k + VEC_WIDTH <= K; k += VEC_WIDTH) {
+                    const auto offset = (b * K + k) * spatial;
+                    WinogradVec o[WINOGRAD_M][WINOGRAD_M];
+                    transform_out_tile<WinogradVec>(M + t * K + k, tile_stride, o);
+                    write_out_tile(o, VEC_WIDTH, x, y, biases + k,
+                                   eltwise ? eltwise + offset : nullptr, ReLU, Y + offset);
                 }
-                auto temp = std::array<std::array<float, WINOGRAD_ALPHA>, WINOGRAD_M>{};
-                auto o = std::array<std::array<float, WINOGRAD_M>, WINOGRAD_M>{};
-
-                // Calculates transpose(A).temp_m.A
-                for (auto j = 0; j < WINOGRAD_ALPHA; j++) {
-                    multiply_at(temp[0][j], temp[1][j], temp[2][j], temp[3][j],
-                                temp_m[0][j], temp_m[1][j], temp_m[2][j], temp_m[3][j],
-                                temp_m[4][j], temp_m[5][j]);
+                for (; k < K; ++k) {
+                    const auto offset = (b * K + k) * spatial;
+                    float o[WINOGRAD_M][WINOGRAD_M];
+                    transform_out_tile<float>(M + t * K + k, tile_stride, o);
+                    write_out_tile(o, 1, x, y, biases + k,
+                                   eltwise ? eltwise + offset : nullptr, ReLU, Y + offset);
                 }
+            }
+        }
+    }
+}
 
-                for (auto i = 0; i < WINOGRAD_M; i++) {
-                    multiply_at(o[i][0], o[i][1], o[i][2], o[i][3], temp[i][0],
-                                temp[i][1], temp[i][2], temp[i][3], temp[i][4],
-                                temp[i][5]);
+void Winograd::transform_in(const int batch_size,
+                            const int C,
+                            const float *in,
+                            float *pad,
+                            float *V) {
+    constexpr auto spatial = W * H;
+    const auto tiles = batch_size * P;
+
+    // The padded inputs are [batch][WPAD_Y][WPAD_X][C]. The border
+    // and the area out of the board are zero.
+    std::fill(pad, pad + batch_size * WPAD_Y * WPAD_X * C, 0.0f);
+    for (int b = 0; b < batch_size; ++b) {
+        for (int ch = 0; ch < C; ++ch) {
+            const float *in_ptr = in + (b * C + ch) * spatial;
+            for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                    pad[((b * WPAD_Y + y + 1) * WPAD_X + x + 1) * C + ch] = in_ptr[y * W + x];
                 }
+            }
+        }
+    }
 
-                const auto y_ind = k * H * W + y * W + x;
-                for (auto i = 0; i < WINOGRAD_M; i++) {
-                    for (auto j = 0; j < WINOGRAD_M; j++) {
-                        if (y + i < H && x + j < W) {
-                            Y[y_ind + i * W + j] = o[i][j];
-                        }
-                    }
-                }
+    // Tiles overlap by 2.
+    auto offsets = std::vector<int>(tiles);
+    for (int b = 0; b < batch_size; ++b) {
+        for (int block_y = 0; block_y < WTILES_Y; ++block_y) {
+            for (int block_x = 0; block_x < WTILES_X; ++block_x) {
+                const auto yin = WINOGRAD_M * block_y;
+                const auto xin = WINOGRAD_M * block_x;
+                offsets[b * P + block_y * WTILES_X + block_x] =
+                    ((b * WPAD_Y + yin) * WPAD_X + xin) * C;
             }
         }
     }
+    winograd_transform_in(tiles, C, WPAD_X * C, offsets.data(), pad, V);
+}
+
+void Winograd::sgemm(const int tiles,
+                     const int C,
+                     const int K,
+                     const float *U,
+                     const float *V,
+                     float *M) {
+#ifdef USE_BLAS
+    for (int b = 0; b < WINOGRAD_TILE; b++) {
+        Blas::fixed_gemm(tiles, K, C,
+                         1.0f,
+                         V + b * tiles * C, C,
+                         U + b * C * K, K,
+                         0.0f,
+                         M + b * tiles * K, K);
+    }
+#else
+    winograd_sgemm(tiles, C, K, U, V, M);
+#endif
 }
 
-void Winograd::Forward(const size_t input_channels,
+void Winograd::transform_out(const int batch_size,
+                             const int K,
+                             const float *M,
+                             const float *biases,
+                             const float *eltwise,
+                             const bool ReLU,
+                             float *Y) {
+    winograd_transform_out(batch_size, K, M, biases, eltwise, ReLU, Y);
+}
+
+void Winograd::Forward(const int batch_size,
+                       const size_t input_channels,
                        const size_t output_channels,
                        const std::vector<float> &input,
-                       const std::vector<float> &U,
-                       std::vector<float> &V,
-                       std::vector<float> &M,
-                       std::vector<float> &output) {
-
-    transform_in(input, V, input_channels);
-    sgemm(U, V, M, input_channels, output_channels);
-    transform_out(M, output, output_channels);
+                       const FloatWeights &U,
+                       const FloatWeights &biases,
+                       std::vector<float> &workspace,
+                       std::vector<float> &output,
+                       const float *const eltwise,
+                       const bool ReLU) {
+    const auto tiles = batch_size * P;
+    assert(get_workspace_size(batch_size, input_channels, output_channels) <= workspace.size());
+    assert(U.size() == WINOGRAD_TILE * input_channels * output_channels);
+    assert(batch_size * output_channels * W * H <= output.size());
+
+    float *pad = workspace.data();
+    float *V = pad + batch_size * WPAD_Y * WPAD_X * input_channels;
+    float *M = V + WINOGRAD_TILE * tiles * input_channels;
+
+    transform_in(batch_size, input_channels, input.data(), pad, V);
+    sgemm(tiles, input_channels, output_channels, U.data(), V, M);
+    transform_out(batch_size, output_channels, M, biases.data(), eltwise, ReLU, output.data());
 }
 
-std::pair<size_t, size_t> Winograd::get_workspace_size(const size_t input_channels,
-                                                       const size_t output_channels) {
+size_t Winograd::get_workspace_size(const int batch_size,
+                                    const size_t input_channels,
+                                    const size_t output_channels) {
+    const auto tiles = batch_size * P;
+    const auto pad_size = batch_size * WPAD_Y * WPAD_X * input_channels;
+    const auto V_size = WINOGRAD_TILE * tiles * input_channels;
+    const auto M_size = WINOGRAD_TILE * tiles * output_channels;
+    return pad_size + V_size + M_size;
+}
 
-    auto winograd_V_size = WINOGRAD_TILE * input_channels * P;
-    auto winograd_M_size = WINOGRAD_TILE * output_channels * P;
-    return std::make_pair(winograd_V_size, winograd_M_size);
+const char *Winograd::get_isa_name() {
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return "AVX-512";
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return "AVX2";
+    }
+#endif
+    return "generic";
 }
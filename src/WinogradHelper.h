@@ -22,6 +22,7 @@
 #include <array>
 #include "config.h"
 #include "Board.h"
+#include "Blas.h"
 
 static constexpr auto WINOGRAD_M = 4;
 static constexpr auto WINOGRAD_ALPHA = WINOGRAD_M + 3 - 1; // 6
@@ -30,34 +31,56 @@ static constexpr auto SQ2 = 1.4142135623730951f; // Square root of 2
 
 class Winograd {
 public:
-    static std::vector<float> transform_f(const std::vector<float> &f,
+    static std::vector<float> transform_f(const FloatWeights &f,
                                           const int outputs,
                                           const int channels);
 
-    static std::pair<size_t, size_t> get_workspace_size(const size_t input_channels,
-                                                        const size_t output_channels);
-
-
-    void transform_in(const std::vector<float> &in,
-                      std::vector<float> &V, const int C);
-
-    void sgemm(const std::vector<float> &U,
-               const std::vector<float> &V,
-               std::vector<float> &M, const int C,
-               const int K);
-
-    void transform_out(const std::vector<float> &M,
-                       std::vector<float> &Y, const int K);
-
-    void Forward(const size_t input_channels,
-                 const size_t output_channels,
-                 const std::vector<float> &input,
-                 const std::vector<float> &U,
-                 std::vector<float> &V,
-                 std::vector<float> &M,
-                 std::vector<float> &output);
+    static size_t get_workspace_size(const int batch_size,
+                                     const size_t input_channels,
+                                     const size_t output_channels);
+
+    // The 3x3 convolution of the whole batch. The U is from transform_f().
+    static void Forward(const int batch_size,
+                        const size_t input_channels,
+                        const size_t output_channels,
+                        const std::vector<float> &input,
+                        const FloatWeights &U,
+                        const FloatWeights &biases,
+                        std::vector<float> &workspace,
+                        std::vector<float> &output,
+                        const float *const eltwise = nullptr,
+                        const bool ReLU = true);
+
+    // The instruction set selected at runtime.
+    static const char *get_isa_name();
 
 private:
+    // The layouts are, input [batch][C][H][W], V [36][tiles][C],
+    // M [36][tiles][K] and output [batch][K][H][W]. The channels are
+    // the innermost dimension of V and M, so the transforms work on
+    // 16 channels at once.
+    static void transform_in(const int batch_size,
+                             const int C,
+                             const float *in,
+                             float *pad,
+                             float *V);
+
+    static void sgemm(const int tiles,
+                      const int C,
+                      const int K,
+                      const float *U,
+                      const float *V,
+                      float *M);
+
+    // The epilogue of the convolution is fused in the output transform.
+    static void transform_out(const int batch_size,
+                              const int K,
+                              const float *M,
+                              const float *biases,
+                              const float *eltwise,
+                              const bool ReLU,
+                              float *Y);
+
     static constexpr auto KERNEL_SIZE = 3;
     static constexpr auto FILTER_LEN = KERNEL_SIZE * KERNEL_SIZE;
     static constexpr auto W = Board::WIDTH;
@@ -65,6 +88,10 @@ private:
     static constexpr auto WTILES_X = (W / WINOGRAD_M + (W % WINOGRAD_M != 0));
     static constexpr auto WTILES_Y = (H / WINOGRAD_M + (H % WINOGRAD_M != 0));
     static constexpr auto P = WTILES_X * WTILES_Y;
+
+    // The padded board which covers all tiles.
+    static constexpr auto WPAD_X = 2 + WINOGRAD_M * WTILES_X;
+    static constexpr auto WPAD_Y = 2 + WINOGRAD_M * WTILES_Y;
 };
 
 
@@ -16,60 +16,74 @@
     along with ElephantArt.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <algorithm>
-#include <cassert>
-
-#include "Random.h"
 #include "Zobrist.h"
-#include "config.h"
 
 constexpr Zobrist::KEY Zobrist::zobrist_seed;
 constexpr Zobrist::KEY Zobrist::zobrist_empty;
 constexpr Zobrist::KEY Zobrist::zobrist_redtomove;
 
-std::array<std::array<Zobrist::KEY, Zobrist::ZOBRIST_SIZE>, 18> Zobrist::zobrist;
-std::array<Zobrist::KEY, 200> Zobrist::zobrist_positions;
+namespace {
 
-template<typename T>
-bool collision(std::vector<T> &array) {
-    const auto s = array.size();
-    if (s <= 1) {
-        return false;
+// The same xoroshiro128+ generator, seeded by splitmix64, as
+// Random<random_t::XoroShiro128Plus>. The keys are the same as the
+// ones it gave at startup.
+class ConstexprRng {
+public:
+    constexpr ConstexprRng(std::uint64_t seed) {
+        for (auto i = 0; i < 2; ++i) {
+            seed = splitmix64(seed);
+            m_seeds[i] = seed;
+        }
     }
 
-    for (auto i = size_t{0}; i < (s-1); ++i) {
-        auto begin = std::cbegin(array);
-        auto element = std::next(begin, i);
-        auto start = std::next(element, 1);
-        auto end = std::cend(array);
-        auto res = std::find(start, end, *element);
-        if (res != end) {
-            return true;
-        }
+    constexpr std::uint64_t randuint64() {
+        const auto s0 = m_seeds[0];
+        auto s1 = m_seeds[1];
+        const auto result = s0 + s1;
+
+        s1 ^= s0;
+        m_seeds[0] = rotl(s0, 55) ^ s1 ^ (s1 << 14);
+        m_seeds[1] = rotl(s1, 36);
+        return result;
     }
-    return false;
-}
 
-void Zobrist::init_zobrist() {
-    Random<random_t::XoroShiro128Plus> rng(zobrist_seed);
-    while (true) {
-        auto buf = std::vector<KEY>{};
+private:
+    static constexpr std::uint64_t splitmix64(std::uint64_t z) {
+        z += 0x9e3779b97f4a7c15;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
 
-        for (int i = 0; i < 18; ++i) {
-            for (int j = 0; j < ZOBRIST_SIZE; ++j) {
-                zobrist[i][j] = rng.randuint64();
-                buf.emplace_back(zobrist[i][j]);
-            }
-        }
+    static constexpr std::uint64_t rotl(const std::uint64_t x, const int k) {
+        return (x << k) | (x >> (64 - k));
+    }
 
-        for (int i = 0; i < 200; ++i) {
-            zobrist_positions[i] = rng.randuint64();
-            buf.emplace_back(zobrist_positions[i]);
-        }
+    std::uint64_t m_seeds[2]{0, 0};
+};
+
+struct ZobristKeys {
+    Zobrist::ZobristTable zobrist;
+    Zobrist::PositionsTable positions;
+};
 
-        assert(buf.size() == 100 * 18 + 200);
-        if (!collision(buf)) {
-            break;
+// 2000 random 64 bits keys collide with the chance about 1e-13, we
+// don't check it.
+constexpr ZobristKeys generate_keys(std::uint64_t seed) {
+    auto keys = ZobristKeys{};
+    auto rng = ConstexprRng(seed);
+    for (auto i = size_t{0}; i < keys.zobrist.size(); ++i) {
+        for (auto j = size_t{0}; j < keys.zobrist[i].size(); ++j) {
+            keys.zobrist[i][j] = rng.randuint64();
         }
     }
+    for (auto i = size_t{0}; i < keys.positions.size(); ++i) {
+        keys.positions[i] = rng.randuint64();
+    }
+    return keys;
 }
+
+} // namespace
+
+constexpr Zobrist::ZobristTable Zobrist::zobrist = generate_keys(zobrist_seed).zobrist;
+constexpr Zobrist::PositionsTable Zobrist::zobrist_positions = generate_keys(zobrist_seed).positions;
@@ -19,11 +19,8 @@
 #ifndef ZOBRIST_H_INCLUDE
 #define ZOBRIST_H_INCLUDE
 
-#include <array>
-#include <random>
-#include <vector>
-
 #include "BitBoard.h"
+#include "StaticArray.h"
 
 class Zobrist {
 private:
@@ -36,10 +33,12 @@ public:
     static constexpr KEY zobrist_empty = 0x1234567887654321;
     static constexpr KEY zobrist_redtomove = 0xabcdabcdabcdabcd;
 
-    static std::array<std::array<KEY, ZOBRIST_SIZE>, 18> zobrist;
-    static std::array<KEY, 200> zobrist_positions;
+    using ZobristTable = StaticArray<StaticArray<KEY, ZOBRIST_SIZE>, 18>;
+    using PositionsTable = StaticArray<KEY, 200>;
 
-    static void init_zobrist();
+    // Both tables are generated at compile time.
+    static const ZobristTable zobrist;
+    static const PositionsTable zobrist_positions;
 };
 
 #endif
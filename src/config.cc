@@ -17,9 +17,7 @@
 */
 
 #include "config.h"
-#include "Zobrist.h"
 #include "Board.h"
-#include "Decoder.h"
 #include "Utils.h"
 #include "Search.h"
 
@@ -73,6 +71,7 @@ void init_options_map() {
     options_map["gpu"] << Utils::Option::setoption(0);
     options_map["batchsize"] << Utils::Option::setoption(1, 256, 1);
     options_map["threads"] << Utils::Option::setoption(1, 256, 1);
+    options_map["thread_affinity"] << Utils::Option::setoption(false);
 
     options_map["quiet_verbose"] << Utils::Option::setoption(false);
     options_map["stats_verbose"] << Utils::Option::setoption(false);
@@ -87,12 +86,16 @@ void init_options_map() {
     options_map["cache_moves"] << Utils::Option::setoption(20);
     options_map["weights_file"] << Utils::Option::setoption(NO_WEIGHT_FILE_NAME);
     options_map["float_precision"] << Utils::Option::setoption(5);
-    options_map["winograd"] << Utils::Option::setoption(false);
+    options_map["winograd"] << Utils::Option::setoption(true);
+    options_map["int8"] << Utils::Option::setoption(false);
     options_map["min_cutoff"] << Utils::Option::setoption(1);
 
     options_map["ponder"] << Utils::Option::setoption(false);
+    options_map["reuse_tree"] << Utils::Option::setoption(true);
+    options_map["transposition"] << Utils::Option::setoption(false);
     options_map["playouts"] << Utils::Option::setoption(Search::MAX_PLAYOUTS);
     options_map["visits"] << Utils::Option::setoption(Search::MAX_PLAYOUTS);
+    options_map["leaf_batch"] << Utils::Option::setoption(1, 256, 1);
     options_map["fpu_root_reduction"] << Utils::Option::setoption(0.25f);
     options_map["fpu_reduction"] << Utils::Option::setoption(0.25f);
     options_map["cpuct_init"] << Utils::Option::setoption(2.5f);
@@ -107,6 +110,14 @@ void init_options_map() {
     options_map["random_min_visits"] << Utils::Option::setoption(1);
     options_map["random_move_cnt"] << Utils::Option::setoption(0);
 
+    options_map["selfplay_games"] << Utils::Option::setoption(1);
+    options_map["selfplay_file"] << Utils::Option::setoption("NO_FILE_NAME");
+    options_map["binary_data"] << Utils::Option::setoption(false);
+    options_map["chunk_games"] << Utils::Option::setoption(64);
+    options_map["resign_threshold"] << Utils::Option::setoption(0.0f);
+    options_map["reduced_playouts"] << Utils::Option::setoption(0);
+    options_map["reduced_playouts_prob"] << Utils::Option::setoption(0.75f);
+
     options_map["dirichlet_noise"] << Utils::Option::setoption(false);
     options_map["dirichlet_epsilon"] << Utils::Option::setoption(0.25f);
     options_map["dirichlet_init"] << Utils::Option::setoption(0.3f);
@@ -150,8 +161,8 @@ void init_options_map() {
 }
 
 void init_basic_parameters() {
-    Zobrist::init_zobrist();
-    Decoder::initialize();
+    // The zobrist keys, the decoder maps and the leaper tables are built
+    // at compile time. Only the slider tables are left.
     Board::pre_initialize();
 }
 
@@ -219,6 +230,31 @@ ArgsParser::ArgsParser(int argc, char** argv) {
         parser.remove_command(res->idx);
     }
 
+    if (const auto res = parser.find("--noreuse")) {
+        set_option("reuse_tree", false);
+        parser.remove_command(res->idx);
+    }
+
+    if (const auto res = parser.find("--transposition")) {
+        set_option("transposition", true);
+        parser.remove_command(res->idx);
+    }
+
+    if (const auto res = parser.find("--affinity")) {
+        set_option("thread_affinity", true);
+        parser.remove_command(res->idx);
+    }
+
+    if (const auto res = parser.find("--nowinograd")) {
+        set_option("winograd", false);
+        parser.remove_command(res->idx);
+    }
+
+    if (const auto res = parser.find("--int8")) {
+        set_option("int8", true);
+        parser.remove_command(res->idx);
+    }
+
     if (const auto res = parser.find("--collect")) {
         set_option("collect", true);
         parser.remove_command(res->idx);
@@ -235,7 +271,9 @@ ArgsParser::ArgsParser(int argc, char** argv) {
         if (is_parameter(res->str)) {
             if (res->str == "ascii"
                     || res->str == "ucci"
-                    || res->str == "selfplay") {
+                    || res->str == "selfplay"
+                    || res->str == "perft"
+                    || res->str == "nnbench") {
                 set_option("mode", res->get<std::string>());
                 parser.remove_slice(res->idx-1, res->idx+1);
             }
@@ -270,6 +308,74 @@ ArgsParser::ArgsParser(int argc, char** argv) {
         }
     }
 
+    if (const auto res = parser.find_next("--leaf_batch")) {
+        if (is_parameter(res->str)) {
+            set_option("leaf_batch", res->get<int>());
+            parser.remove_slice(res->idx-1, res->idx+1);
+        }
+    }
+
+    if (const auto res = parser.find_next("--num_games")) {
+        if (is_parameter(res->str)) {
+            set_option("num_games", res->get<int>());
+            parser.remove_slice(res->idx-1, res->idx+1);
+        }
+    }
+
+    if (const auto res = parser.find_next("--selfplay_games")) {
+        if (is_parameter(res->str)) {
+            set_option("selfplay_games", res->get<int>());
+            parser.remove_slice(res->idx-1, res->idx+1);
+        }
+    }
+
+    if (const auto res = parser.find_next("--datafile")) {
+        if (is_parameter(res->str)) {
+            set_option("selfplay_file", res->get<std::string>());
+            parser.remove_slice(res->idx-1, res->idx+1);
+        }
+    }
+
+    if (const auto res = parser.find("--binary_data")) {
+        set_option("binary_data", true);
+        parser.remove_command(res->idx);
+    }
+
+    if (const auto res = parser.find_next("--chunk_games")) {
+        if (is_parameter(res->str)) {
+            set_option("chunk_games", res->get<int>());
+            parser.remove_slice(res->idx-1, res->idx+1);
+        }
+    }
+
+    if (const auto res = parser.find_next("--resign_threshold")) {
+        if (is_parameter(res->str)) {
+            set_option("resign_threshold", res->get<float>());
+            parser.remove_slice(res->idx-1, res->idx+1);
+        }
+    }
+
+    if (const auto res = parser.find_next("--reduced_playouts")) {
+        if (is_parameter(res->str)) {
+            set_option("reduced_playouts", res->get<int>());
+            parser.remove_slice(res->idx-1, res->idx+1);
+        }
+    }
+
+    if (const auto res = parser.find_next("--reduced_playouts_prob")) {
+        if (is_parameter(res->str)) {
+            set_option("reduced_playouts_prob", res->get<float>());
+            parser.remove_slice(res->idx-1, res->idx+1);
+        }
+    }
+
+    if (const auto res = parser.find_next("--random_moves")) {
+        if (is_parameter(res->str)) {
+            set_option("random_move_cnt", res->get<int>());
+            parser.remove_slice(res->idx-1, res->idx+1);
+        }
+    }
+
     if (const auto res = parser.find_next("--floatprecision")) {
         if (is_parameter(res->str)) {
             set_option("float_precision", res->get<int>());
@@ -391,6 +497,9 @@ ArgsParser::ArgsParser(int argc, char** argv) {
     
 #ifdef USE_CUDA
     set_option("use_gpu", true);
+
+    // The CUDA backend uses the original weights.
+    set_option("winograd", false);
 #endif
     
     if (error_commands(parser)) {
@@ -399,13 +508,19 @@ ArgsParser::ArgsParser(int argc, char** argv) {
     if (option<std::string>("mode") == "ucci") {
         set_option("quiet_verbose", true);
     }
+    if (option<std::string>("mode") == "selfplay") {
+        set_option("ucci_response", false);
+        if (option<std::string>("selfplay_file") != "NO_FILE_NAME") {
+            set_option("collect", true);
+        }
+    }
 }
 
 void ArgsParser::help() const {
     Utils::printf<Utils::SYNC>("Arguments:\n");
     Utils::printf<Utils::SYNC>("  --help, -h\n");
     Utils::printf<Utils::SYNC>("  --chinese, -ch\n");
-    Utils::printf<Utils::SYNC>("  --mode, -m [ascii/ucci]\n");
+    Utils::printf<Utils::SYNC>("  --mode, -m [ascii/ucci/selfplay]\n");
     Utils::printf<Utils::SYNC>("  --playouts, -p <integer>\n");
     Utils::printf<Utils::SYNC>("  --threads, -t <integer>\n");
     Utils::printf<Utils::SYNC>("  --weights, -w <weight file name>\n");
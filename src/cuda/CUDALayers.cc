@@ -54,8 +54,8 @@ void Batchnorm::Forward(const int batch,
 }
 
 
-void Batchnorm::LoadingWeight(const std::vector<float> &means,
-                              const std::vector<float> &stddevs) {
+void Batchnorm::LoadingWeight(const FloatWeights &means,
+                              const FloatWeights &stddevs) {
     if (is_loaded) {
         return;
     }
@@ -174,7 +174,7 @@ void Convolve::Forward(const int batch, float *input, float *output,
 #endif
 }
 
-void Convolve::LoadingWeight(const std::vector<float> &weights,
+void Convolve::LoadingWeight(const FloatWeights &weights,
                              size_t &scratch_size, CudaHandel *handel) {
     if (is_loaded) {
         return;
@@ -247,8 +247,8 @@ void Convolve::LoadingWeight(const std::vector<float> &weights,
 }
 
 
-void Convolve::LoadingWeight(const std::vector<float> &weights,
-                             const std::vector<float> &biases,
+void Convolve::LoadingWeight(const FloatWeights &weights,
+                             const FloatWeights &biases,
                              size_t &scratch_size, CudaHandel *handel) {
     if (is_loaded) {
         return;
@@ -287,8 +287,8 @@ FullyConnect::~FullyConnect() {
     }
 }
 
-void FullyConnect::LoadingWeight(const std::vector<float> &weights,
-                                 const std::vector<float> &biases) {
+void FullyConnect::LoadingWeight(const FloatWeights &weights,
+                                 const FloatWeights &biases) {
     if (is_loaded) { 
         return;
     }
@@ -349,10 +349,10 @@ SEUnit::SEUnit(const int max_batch, const size_t channels, const size_t se_size)
     is_loaded = false;
 }
 
-void SEUnit::LoadingWeight(const std::vector<float> &weights_w1,
-                           const std::vector<float> &weights_b1,
-                           const std::vector<float> &weights_w2,
-                           const std::vector<float> &weights_b2) {
+void SEUnit::LoadingWeight(const FloatWeights &weights_w1,
+                           const FloatWeights &weights_b1,
+                           const FloatWeights &weights_w2,
+                           const FloatWeights &weights_b2) {
     if (is_loaded) { 
         return;
     }
@@ -461,10 +461,10 @@ InputPool::InputPool(const int max_batch, const size_t input_size,
 }
 
 
-void InputPool::LoadingWeight(const std::vector<float> &weights_w1,
-                              const std::vector<float> &weights_b1,
-                              const std::vector<float> &weights_w2,
-                              const std::vector<float> &weights_b2) {
+void InputPool::LoadingWeight(const FloatWeights &weights_w1,
+                              const FloatWeights &weights_b1,
+                              const FloatWeights &weights_w2,
+                              const FloatWeights &weights_b2) {
     if (is_loaded) { 
         return;
     }
@@ -21,6 +21,7 @@
 #ifdef USE_CUDA
 #include "cuda/CUDACommon.h"
 #include "Board.h"
+#include "Blas.h"
 
 #include <vector>
 #include <array>
@@ -39,8 +40,8 @@ public:
     void Forward(const int batch, float *data,
                  const float *const eltwise = nullptr);
 
-    void LoadingWeight(const std::vector<float> &means,
-                       const std::vector<float> &stddevs);
+    void LoadingWeight(const FloatWeights &means,
+                       const FloatWeights &stddevs);
 private:
     static constexpr auto width = CONV_WIDTH;
     static constexpr auto height = CONV_HEIGHT;
@@ -65,11 +66,11 @@ public:
     void Forward(const int batch, float *input, float *output,
                  void *scratch, size_t scratch_size, CudaHandel *handel);
 
-    void LoadingWeight(const std::vector<float> &weights,
+    void LoadingWeight(const FloatWeights &weights,
                        size_t &scratch_size, CudaHandel *handel);
 
-    void LoadingWeight(const std::vector<float> &weights,
-                       const std::vector<float> &biases,
+    void LoadingWeight(const FloatWeights &weights,
+                       const FloatWeights &biases,
                        size_t &scratch_size, CudaHandel *handel);
 
 private:
@@ -113,8 +114,8 @@ public:
                  float *output,
                  CudaHandel *handel);
 
-    void LoadingWeight(const std::vector<float> &weights,
-                       const std::vector<float> &biases);
+    void LoadingWeight(const FloatWeights &weights,
+                       const FloatWeights &biases);
 private:
     bool m_ReLU;
     int m_maxbatch;
@@ -149,10 +150,10 @@ public:
     SEUnit(const int batch, const size_t channels, const size_t se_size);
     ~SEUnit();
 
-    void LoadingWeight(const std::vector<float> &weights_w1,
-                       const std::vector<float> &weights_b1,
-                       const std::vector<float> &weights_w2,
-                       const std::vector<float> &weights_b2);
+    void LoadingWeight(const FloatWeights &weights_w1,
+                       const FloatWeights &weights_b1,
+                       const FloatWeights &weights_w2,
+                       const FloatWeights &weights_b2);
 
     void Forward(const int batch, float *input, float *output, CudaHandel *handel);
  
@@ -181,10 +182,10 @@ public:
               const size_t squeeze, const size_t channels);
     ~InputPool();
 
-     void LoadingWeight(const std::vector<float> &weights_w1,
-                        const std::vector<float> &weights_b1,
-                        const std::vector<float> &weights_w2,
-                        const std::vector<float> &weights_b2); 
+     void LoadingWeight(const FloatWeights &weights_w1,
+                        const FloatWeights &weights_b1,
+                        const FloatWeights &weights_w2,
+                        const FloatWeights &weights_b2); 
 
     void Forward(const int batch, float *input, float *output, CudaHandel *handel);
     void set_convsize(const size_t conv_size);
@@ -1,4 +1,5 @@
 import glob
+import gzip
 import struct
 
 # Now the version is zero. This is experiment version. We don't
@@ -25,6 +26,14 @@ FIXED_DATA_VERSION = 0
 
 '''
 
+# The binary chunk, see DataCollection::out_binary() of the engine. Every
+# chunk begins with the magic and the 32 bits record version. The record
+# is the 44 bytes fixed part and N sparse probabilities.
+BINARY_MAGIC = b"ELEPHTRN"
+BINARY_DATA_VERSION = 1
+BINARY_FIXED_FORMAT = "<BBbBHHHH16b16b"
+BINARY_FIXED_SIZE = struct.calcsize(BINARY_FIXED_FORMAT)
+
 class PiecesIndex:
     def __init__(self):
         # According to ElephantArt Engine, the pieces sequence follow
@@ -86,7 +95,7 @@ class Data(PiecesIndex):
     def fill_v1(self, linecnt, readline):
         if linecnt == 0:
             v = int(readline)
-            assert v == 1, "The data is not correct version."
+            assert v == FIXED_DATA_VERSION, "The data is not correct version."
         elif linecnt >= 1 and linecnt <= 7:
             p = readline.split()
             start = self.ACCUMULATE[linecnt-1]
@@ -120,6 +129,15 @@ class Data(PiecesIndex):
         elif linecnt == 22:
             self.result = int(readline)
 
+    def fill_binary(self, fixed, probs):
+        self.tomove, self.move, self.result, self.repetitions, \
+            self.plies, self.rule50_remaining, self.moves_left, probsize = fixed[0:8]
+        self.current_pieces = list(fixed[8:24])
+        self.other_pieces = list(fixed[24:40])
+
+        self.policyindex = list(probs[0::2])
+        self.probabilities = [float(p) for p in probs[1::2]]
+
     @staticmethod
     def get_datalines(version):
         if version == 0:
@@ -149,6 +167,29 @@ class ChunkParser:
 
         return True
 
+    def binaryparser(self, filestream):
+        header = filestream.read(len(BINARY_MAGIC) + 4)
+        assert header[0:len(BINARY_MAGIC)] == BINARY_MAGIC, "The chunk is not correct format."
+        version = struct.unpack("<I", header[len(BINARY_MAGIC):])[0]
+        assert version == BINARY_DATA_VERSION, "The chunk is not correct version."
+
+        while True:
+            fixed_buf = filestream.read(BINARY_FIXED_SIZE)
+            if len(fixed_buf) == 0:
+                break
+            assert len(fixed_buf) == BINARY_FIXED_SIZE, "The data is incomplete."
+            fixed = struct.unpack(BINARY_FIXED_FORMAT, fixed_buf)
+
+            probsize = fixed[7]
+            probs_buf = filestream.read(4 * probsize)
+            assert len(probs_buf) == 4 * probsize, "The data is incomplete."
+            probs = struct.unpack("<" + "He" * probsize, probs_buf)
+
+            data = Data()
+            data.fill_binary(fixed, probs)
+            buf, size = self.pack_v1(data)
+            self.buffer.append((buf, size))
+
     def pack_v1(self, data):
         int_symbol = "i"
 
@@ -230,7 +271,16 @@ class ChunkParser:
             if self.cfg.debugVerbose:
                 print(name)
 
-            with open(name, 'r') as f:
+            opener = gzip.open if name.endswith(".gz") else open
+            with opener(name, 'rb') as f:
+                binary = f.read(len(BINARY_MAGIC)) == BINARY_MAGIC
+
+            if binary:
+                with opener(name, 'rb') as f:
+                    self.binaryparser(f)
+                continue
+
+            with opener(name, 'rt') as f:
                 while True:
                     if self.linesparser(datalines, f) == False:
                         break